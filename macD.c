@@ -11,6 +11,7 @@
  *     is displayed.
  */
 
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
@@ -19,23 +20,206 @@
 #include <limits.h>
 #include <string.h>
 #include <signal.h>
+#include <pthread.h>
+#include <spawn.h>
+#include <fcntl.h>
 #include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
 #include <sys/wait.h>
+#include <sys/resource.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <sys/uio.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netdb.h>
+#include <getopt.h>
+#include <sys/syscall.h>
+#include <sched.h>
+#include <linux/mempolicy.h>
+#include <linux/netlink.h>
+#include <linux/genetlink.h>
+#include <linux/taskstats.h>
+#include <linux/connector.h>
+#include <linux/cn_proc.h>
 #include <time.h>
+#include <poll.h>
+#include <sys/prctl.h>
 #include "macD.h"
 
-int MAX_ARG_LENGTH = 1000;
+//large enough for all of /proc/[pid]/stat
+#define PROC_BUFFER_SIZE 2048
+//size of each chunk of the output buffer
+#define OUT_CHUNK_SIZE (1 << 16)
+//room reserved for a single out_printf before it is formatted
+#define OUT_LINE_SIZE 256
+//initial buffer size for a process list that cannot be mapped
+//large enough for /proc/[pid]/status and smaps_rollup
+#define MEM_BUFFER_SIZE 4096
+#define CONTROL_BUFFER_SIZE 256
+#define MAX_ALERTS 4
+#define TASKSTATS_BATCH 64
+#define TASKSTATS_REPLY_SIZE 1024
+#define LOG_PIPE_SIZE (1024*1024)
+#define AGGREGATE_BUFFER_SIZE (256*1024)
+#define AGGREGATE_EVENTS 64
+//more lines than any process list has, bounds the fleet a peer can make the aggregator allocate
+#define FLEET_MAX_LINES (1 << 20)
+//above PID_MAX_LIMIT, so a virtual pid is never that of a real process
+#define REPLAY_PID_BASE (4*1024*1024 + 1)
+#define LOAD_BLOCK_SIZE (1 << 16)
+
 int MAX_PROCESSES = 10;
-int MAX_SEGMENT_LENGTH = 100;
+int LAUNCH_BATCH = 64;
+int SPAWN_BACKEND = SPAWN_FORK;
+int LAUNCH_LATENCY = -1;
+int SAMPLE_STRIPES = 1;
+int CACHED_SLOTS = INT_MAX;
+int FD_RESERVE = 64;
+int FDS_PER_SLOT = 3;
+int BENCH_PASSES = 20;
+char *BENCH_SIZES = "10,100,1000,10000";
+int SAMPLER_THREADS = 1;
+struct sampler_pool *SAMPLER_POOL;
+int OUTPUT_FORMAT = OUTPUT_TEXT;
+struct report_buffer REPORT;
+double REPORT_TIME;
 double TARGET_TIME = -1;
 int KILL_STATE = -1;
 double START_TIME = -1;
+int EPOLL_FD = -1;
+int SIGNAL_FD = -1;
+int REPORT_TIMER_FD = -1;
+double REPORT_INTERVAL = 5;
+double NEXT_REPORT;
+long CLOCK_TICKS;
+int ADAPTIVE_MAX_SKIP;
+int MEM_METRIC = MEM_RSS;
+int SMAPS_INTERVAL = 4;
+long PAGE_SIZE;
+char *MEM_NAMES[] = {"rss", "pss", "uss", "hwm"};
+char *MEM_FILES[] = {"statm", "smaps_rollup", "smaps_rollup", "status"};
+int GROUP_MODE = GROUP_NONE;
+char *GROUP_ROOT;
+int CGROUP_MEMORY;
+int GROUP_REMOVE_TRIES = 100;
+double GRACE_PERIOD = 2;
+int SHUTTING_DOWN;
+int RESTART_TIMER_FD = -1;
+double NEXT_RESTART;
+double LAST_RESTART_TIME;
+double RESTART_TOKENS = 10;
+int RESTART_RATE = 10;
+double RESTART_BACKOFF_MIN = 1;
+double RESTART_BACKOFF_MAX = 60;
+double RESTART_BACKOFF_RESET = 30;
+int RESTART_BURST = 5;
+double RESTART_WINDOW = 60;
+long SAVED_READS;
+int DEADLINE_TIMER_FD = -1;
+int SELF_OVERHEAD = -1;
+long SAMPLER_SYSCALLS;
+long SAMPLER_OPENS;
+struct self_usage SELF_USAGE;
+int HISTORY_LEN = 0;
+char *HISTORY_PATH = NULL;
+char *LIST_PATH = NULL;
+char *CONTROL_PATH = NULL;
+int CONTROL_FD = -1;
+double CONTROL_TIMEOUT = 0.1;
+int MAX_STARTING = 0;
+double SPAWN_RATE = 0;
+double READY_TIMEOUT = 30;
+double READY_POLL = 0.05;
+int READY_NOTIFY_FD = 3;
+double LAUNCH_TOKENS = 1;
+double LAST_LAUNCH_TIME;
+double LAUNCH_START;
+int LAUNCH_TIMER_FD = -1;
+double NEXT_LAUNCH;
+int ALERTS_USED = 0;
+int COLLECT_BACKEND = COLLECT_PROC;
+int TASKSTATS_FD = -1;
+int TASKSTATS_FAMILY = -1;
+unsigned int TASKSTATS_SEQ;
+int PROC_EVENTS_FD = -1;
+long LOG_SIZE = 10*1024*1024;
+struct list_line **LOG_LINES = NULL;
+int LOG_LINES_LEN = 0;
+int SHARD_INDEX = 0;
+int SHARD_COUNT = 1;
+char SHARD_NAME[HOST_NAME_MAX + 1];
+int OUTPUT_FD = STDOUT_FILENO;
+struct clock_snapshot NOW;
+struct history_header *REPLAY_HEADER = NULL;
+size_t REPLAY_SIZE;
+struct history_slot **REPLAY_TRACES = NULL;
+int REPLAY_LEN = 0;
+double REPLAY_SPEED = 1;
+double REPLAY_EPOCH;
+int REPLAY_NEXT_PID = REPLAY_PID_BASE;
+char *CHECKPOINT_PATH = NULL;
+int RESUME = 0;
+struct checkpoint_entry *RESUME_ENTRIES = NULL;
+int RESUME_LEN = 0;
+double RESUME_START = -1;
+int RESUME_EXEC = 0;
+struct pollfd *ADOPTED = NULL;
+int *ADOPTED_PIDS = NULL;
+int ADOPTED_LEN = 0;
+char **SAVED_ARGV = NULL;
+int AGGREGATOR_FD = -1;
+char *AGGREGATOR_BACKLOG = NULL;
+size_t AGGREGATOR_BACKLOG_LEN = 0;
+size_t AGGREGATOR_BACKLOG_SENT = 0;
+int AGGREGATOR_DROPPED = 0;
+struct shard_peer *PEERS = NULL;
+int PEERS_LEN = 0;
+int PEERS_OPEN = 0;
+struct fleet_line *FLEET = NULL;
+int FLEET_LEN = 0;
+int FLEET_TICK = -1;
 
 /*
  * main
  * description:
  *     called when the program is executed.
  *     checks for the -i flag and opens the following file.
+ *     -s selects the spawn backend: fork, vfork or spawn.
+ *     -l displays how long each process took to spawn.
+ *     -S splits the reports into the given number of stripes.
+ *     -B runs the self benchmark with the given number of processes.
+ *     --bench runs the benchmark for each size in BENCH_SIZES, or in
+ *     the given list, and displays the results as CSV.
+ *     -t samples with the given number of threads, 0 for one per cpu.
+ *     -o selects the output format: text, json or binary.
+ *     -r sets the time between reports in milliseconds.
+ *     -a samples stable processes at most every given number of reports.
+ *     -m selects the memory metric: rss, pss, uss or hwm.
+ *     -g starts each line in its own process group or cgroup.
+ *     -k sets the grace period between SIGTERM and SIGKILL in milliseconds.
+ *     -O displays the overhead of macD itself after each report.
+ *     -H keeps the given number of samples of every process and
+ *        displays a summary of them when macD stops.
+ *     -M keeps the samples of -H in the given file.
+ *     -c serves status and reload requests on a unix socket at the given path.
+ *     -C selects how processes are sampled: proc or netlink.
+ *     -x runs only the lines of the given shard, as index/count.
+ *     -n sets the name host= directives are matched with, the host
+ *        name by default.
+ *     -A streams binary records to the aggregator at the given host:port.
+ *     --aggregate listens at the given [host:]port for the instances
+ *     of -A and displays one report of all of them per tick.
+ *     --replay runs virtual processes replaying the samples of a -M file,
+ *     --speed sets how many times faster than real time, and --virtual
+ *     how many processes to run without -i.
+ *     --checkpoint writes the process table to the given file after
+ *     every report, and --resume adopts the processes it lists that
+ *     are still running instead of starting their lines again.
  * parameters:
  *     argc: number of command line arguments
  *     argv: array of strings containing the command line arguments
@@ -43,153 +227,843 @@ double START_TIME = -1;
 int main(int argc, char *argv[])
 {
 	int opt;
+	char *file_path = NULL;
+	int bench_processes = -1;
+	int bench_suite = 0;
+	char *aggregator = NULL;
+	char *aggregate = NULL;
+	char *replay = NULL;
+	int virtual_processes = 0;
+	struct option long_options[] = {
+		{"bench", optional_argument, NULL, 'b'},
+		{"aggregate", required_argument, NULL, 'G'},
+		{"replay", required_argument, NULL, 'R'},
+		{"speed", required_argument, NULL, 'X'},
+		{"virtual", required_argument, NULL, 'V'},
+		{"checkpoint", required_argument, NULL, 'P'},
+		{"resume", no_argument, NULL, 'U'},
+		{NULL, 0, NULL, 0}
+	};
 
 	START_TIME = 0;
-	while ((opt = getopt(argc, argv, "i:")) != -1) {
+	SAVED_ARGV = argv;
+	tzset();
+	if (gethostname(SHARD_NAME, sizeof(SHARD_NAME)) == -1)
+		SHARD_NAME[0] = '\0';
+	while ((opt = getopt_long(argc, argv, "i:s:lS:B:t:o:r:a:m:g:k:OH:M:c:C:x:n:A:", long_options, NULL)) != -1) {
 		if (opt == 'i') {
-			if (optarg == NULL) {
-				printf("option requires an argument --i");
-			} else {
-				int *pids = read_file(optarg);
-
-				if (pids == NULL)
-					return 1;
-				START_TIME = time(NULL);
-				register_handler();
-				periodic_reports(pids);
+			file_path = optarg;
+		} else if (opt == 's') {
+			SPAWN_BACKEND = parse_spawn_backend(optarg);
+			if (SPAWN_BACKEND == -1) {
+				fprintf(stderr, "macD: unknown spawn backend %s\n", optarg);
+				return 1;
+			}
+		} else if (opt == 'l') {
+			LAUNCH_LATENCY = 1;
+		} else if (opt == 'S') {
+			SAMPLE_STRIPES = convert_str_to_int(optarg);
+			if (SAMPLE_STRIPES < 1) {
+				fprintf(stderr, "macD: -S requires a positive integer\n");
+				return 1;
+			}
+		} else if (opt == 't') {
+			SAMPLER_THREADS = convert_str_to_int(optarg);
+			if (SAMPLER_THREADS == 0)
+				SAMPLER_THREADS = sysconf(_SC_NPROCESSORS_ONLN);
+			if (SAMPLER_THREADS < 1) {
+				fprintf(stderr, "macD: -t requires a non negative integer\n");
+				return 1;
+			}
+		} else if (opt == 'o') {
+			OUTPUT_FORMAT = parse_output_format(optarg);
+			if (OUTPUT_FORMAT == -1) {
+				fprintf(stderr, "macD: unknown output format %s\n", optarg);
+				return 1;
+			}
+		} else if (opt == 'r') {
+			int interval = convert_str_to_int(optarg);
+
+			if (interval < 1) {
+				fprintf(stderr, "macD: -r requires a positive number of milliseconds\n");
+				return 1;
+			}
+			REPORT_INTERVAL = interval/1000.0;
+		} else if (opt == 'a') {
+			ADAPTIVE_MAX_SKIP = convert_str_to_int(optarg);
+			if (ADAPTIVE_MAX_SKIP < 1) {
+				fprintf(stderr, "macD: -a requires a positive integer\n");
+				return 1;
+			}
+		} else if (opt == 'm') {
+			MEM_METRIC = parse_mem_metric(optarg);
+			if (MEM_METRIC == -1) {
+				fprintf(stderr, "macD: unknown memory metric %s\n", optarg);
+				return 1;
+			}
+		} else if (opt == 'g') {
+			GROUP_MODE = parse_group_mode(optarg);
+			if (GROUP_MODE == -1) {
+				fprintf(stderr, "macD: unknown group mode %s\n", optarg);
+				return 1;
+			}
+		} else if (opt == 'k') {
+			int grace = convert_str_to_int(optarg);
+
+			if (grace < 0) {
+				fprintf(stderr, "macD: -k requires a number of milliseconds\n");
+				return 1;
+			}
+			GRACE_PERIOD = grace/1000.0;
+		} else if (opt == 'H') {
+			HISTORY_LEN = convert_str_to_int(optarg);
+			if (HISTORY_LEN < 1) {
+				fprintf(stderr, "macD: -H requires a positive integer\n");
+				return 1;
+			}
+		} else if (opt == 'M') {
+			HISTORY_PATH = optarg;
+		} else if (opt == 'c') {
+			CONTROL_PATH = optarg;
+		} else if (opt == 'x') {
+			if (parse_shard(optarg) == -1) {
+				fprintf(stderr, "macD: -x requires an index/count, e.g. 0/4\n");
+				return 1;
+			}
+		} else if (opt == 'n') {
+			snprintf(SHARD_NAME, sizeof(SHARD_NAME), "%s", optarg);
+		} else if (opt == 'A') {
+			aggregator = optarg;
+		} else if (opt == 'G') {
+			aggregate = optarg;
+		} else if (opt == 'R') {
+			replay = optarg;
+		} else if (opt == 'X') {
+			char *end;
+
+			REPLAY_SPEED = strtod(optarg, &end);
+			if (end == optarg || *end != '\0' || REPLAY_SPEED <= 0) {
+				fprintf(stderr, "macD: --speed requires a positive number\n");
+				return 1;
+			}
+		} else if (opt == 'P') {
+			CHECKPOINT_PATH = optarg;
+		} else if (opt == 'U') {
+			RESUME = 1;
+		} else if (opt == 'V') {
+			virtual_processes = convert_str_to_int(optarg);
+			if (virtual_processes < 1) {
+				fprintf(stderr, "macD: --virtual requires a positive integer\n");
+				return 1;
 			}
+		} else if (opt == 'C') {
+			COLLECT_BACKEND = parse_collector(optarg);
+			if (COLLECT_BACKEND == -1) {
+				fprintf(stderr, "macD: unknown collector %s\n", optarg);
+				return 1;
+			}
+		} else if (opt == 'O') {
+			SELF_OVERHEAD = 1;
+		} else if (opt == 'b') {
+			bench_suite = 1;
+			if (optarg != NULL)
+				BENCH_SIZES = optarg;
+		} else if (opt == 'B') {
+			bench_processes = convert_str_to_int(optarg);
+			if (bench_processes < 1) {
+				fprintf(stderr, "macD: -B requires a positive integer\n");
+				return 1;
+			}
+		} else {
+			return 1;
 		}
 	}
+	if (HISTORY_PATH != NULL && HISTORY_LEN == 0) {
+		fprintf(stderr, "macD: -M requires -H\n");
+		return 1;
+	}
+	if (RESUME == 1 && (CHECKPOINT_PATH == NULL || file_path == NULL)) {
+		fprintf(stderr, "macD: --resume requires --checkpoint and -i\n");
+		return 1;
+	}
+	CLOCK_TICKS = sysconf(_SC_CLK_TCK);
+	PAGE_SIZE = sysconf(_SC_PAGESIZE);
+	if (replay != NULL && open_replay(replay) == -1)
+		return 1;
+	init_fd_budget();
+	//before init_groups, which reuses GROUP_ROOT after an upgrade
+	if (RESUME == 1)
+		load_checkpoint(CHECKPOINT_PATH);
+	if (GROUP_MODE == GROUP_CGROUP)
+		init_groups();
+	register_handler();
+	if (COLLECT_BACKEND == COLLECT_NETLINK && init_netlink_collector() == -1)
+		COLLECT_BACKEND = COLLECT_PROC;
+	if (SAMPLER_THREADS > 1)
+		SAMPLER_POOL = create_sampler_pool(SAMPLER_THREADS);
+	if (aggregate != NULL)
+		return run_aggregator(aggregate);
+	if (bench_suite == 1)
+		return run_bench_suite(BENCH_SIZES);
+	if (bench_processes != -1)
+		return run_benchmark(bench_processes);
+	if (SELF_OVERHEAD == 1)
+		init_self_usage();
+	if (file_path == NULL && replay == NULL)
+		return 0;
+	if (CONTROL_PATH != NULL && open_control(CONTROL_PATH) == -1)
+		return 1;
+	if (CHECKPOINT_PATH != NULL && prctl(PR_SET_CHILD_SUBREAPER, 1) == -1)
+		warn("could not become a subreaper");
+	if (aggregator != NULL && connect_aggregator(aggregator) == -1)
+		return 1;
+	if (file_path == NULL) {
+		struct proc_table *table = start_list(create_replay_list(virtual_processes));
+
+		update_clock();
+		START_TIME = NOW.realtime;
+		periodic_reports(table);
+	} else {
+		struct proc_table *table;
+
+		LIST_PATH = file_path;
+		table = read_file(file_path);
+
+		if (table == NULL)
+			return 1;
+		update_clock();
+		START_TIME = RESUME_START != -1 ? RESUME_START : NOW.realtime;
+		periodic_reports(table);
+	}
 }
 
 /*
- * get_num_args
+ * parse_spawn_backend
  * description:
- *     counts the number of arguments in a given line of text
- *     assuming this line is from the process list file.
- *     counts the number of spaces in the line and uses this
- *     to determin the number of args.
+ *     converts the name of a spawn backend given with -s
+ *     to its SPAWN_* value.
  * parameters:
- *     line: a string of the command to count the args of
- * pre-condition:
- *    line is initialized.
+ *     name: "fork", "vfork" or "spawn".
  * returns:
- *     number of args in line.
+ *     the SPAWN_* value of name.
+ *     -1 if name is not a spawn backend.
  */
-int get_num_args(char *line)
+int parse_spawn_backend(char *name)
 {
-	int len = strlen(line);
-	int count = 0;
+	if (strcmp(name, "fork") == 0)
+		return SPAWN_FORK;
+	if (strcmp(name, "vfork") == 0)
+		return SPAWN_VFORK;
+	if (strcmp(name, "spawn") == 0)
+		return SPAWN_POSIX;
+	return -1;
+}
 
-	for (int i = 0; i < len; i++) {
-		if (line[i] == ' ')
-			count++;
+/*
+ * load_file
+ * description:
+ *     maps the whole file into memory. if the file cannot be mapped,
+ *     for example because it is a pipe, it is read in large blocks
+ *     into a buffer instead.
+ * parameters:
+ *     file_path: string of the path to the file to load.
+ *     out_size: set to the size of the file.
+ *     out_mapped: set to 1 if the file was mapped, 0 if it was read.
+ * returns:
+ *     the contents of the file, to be released with unload_file.
+ *     NULL if the file could not be opened.
+ */
+char *load_file(char *file_path, size_t *out_size, int *out_mapped)
+{
+	int fd = open(file_path, O_RDONLY | O_CLOEXEC);
+	struct stat info;
+
+	if (fd == -1)
+		return NULL;
+	*out_size = 0;
+	*out_mapped = 0;
+	if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode)) {
+		if (info.st_size == 0) {
+			close(fd);
+			return calloc(1, 1);
+		}
+		char *data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+		if (data != MAP_FAILED) {
+			close(fd);
+			*out_size = info.st_size;
+			*out_mapped = 1;
+			return data;
+		}
 	}
-	return count+1;
+	size_t capacity = LOAD_BLOCK_SIZE;
+	char *data = malloc(capacity);
+	ssize_t got = read(fd, data, capacity);
+
+	while (got > 0 || (got == -1 && errno == EINTR)) {
+		if (got > 0)
+			*out_size += got;
+		if (*out_size == capacity) {
+			capacity *= 2;
+			data = realloc(data, capacity);
+		}
+		got = read(fd, data + *out_size, capacity - *out_size);
+	}
+	close(fd);
+	return data;
 }
 
 /*
- * get_args
+ * unload_file
  * description:
- *     creates a list of strings containing the arguments
- *     of the given line, which represents a process from the process list file.
+ *     releases the contents of a file loaded by load_file.
  * parameters:
- *     line: a string of the command to get the args of
- * pre-condition:
- *     line is initialized.
+ *     data: the contents returned by load_file.
+ *     size: the size set by load_file.
+ *     mapped: the value of out_mapped set by load_file.
+ */
+void unload_file(char *data, size_t size, int mapped)
+{
+	if (mapped == 1)
+		munmap(data, size);
+	else
+		free(data);
+}
+
+/*
+ * parse_process_list
+ * description:
+ *     reads the process list file and splits every line into its
+ *     arguments, see parse_process_buffer.
+ * parameters:
+ *     file_path: string of the path to the file to read.
  * returns:
- *     list of strings each element is an argument.
+ *     the parsed process list, to be freed with free_process_list.
+ *     NULL if the file could not be opened.
  */
-char **get_args(char *line)
+struct process_list *parse_process_list(char *file_path)
 {
-	int args = get_num_args(line);
-	char **return_array = malloc(sizeof(char *)*args);
-	char *token = strtok(line, " ");
-	int index = 0;
+	size_t size;
+	int mapped;
+	char *data = load_file(file_path, &size, &mapped);
 
-	while (token != NULL) {
-		return_array[index] = token;
-		token = strtok(NULL, " ");
-		index++;
+	if (data == NULL)
+		return NULL;
+	struct process_list *list = parse_process_buffer(data, size);
+
+	unload_file(data, size, mapped);
+	return list;
+}
+
+/*
+ * parse_process_buffer
+ * description:
+ *     splits buffer into lines and every line into its arguments in a
+ *     single pass. arguments are separated by any amount of spaces or
+ *     tabs, and can be quoted with '' or "" to contain whitespace.
+ *     outside of '' a backslash makes the next character literal.
+ *     the text and the arguments of every line are copied into one
+ *     arena, so the whole list is freed at once.
+ * parameters:
+ *     buffer: the contents of a process list file.
+ *     size: the length of buffer.
+ * returns:
+ *     the parsed process list, to be freed with free_process_list.
+ */
+struct process_list *parse_process_buffer(const char *buffer, size_t size)
+{
+	struct process_list *list = calloc(1, sizeof(struct process_list));
+	//every line is copied once as text and once as arguments,
+	//neither copy is longer than the line plus one NUL per argument.
+	char *cursor = malloc(size*3 + 2);
+	int lines_capacity = MAX_PROCESSES;
+	int args_capacity = MAX_PROCESSES*4;
+	int num_args = 0;
+	size_t start = 0;
+
+	list->arena = cursor;
+	list->lines = malloc(sizeof(struct list_line)*lines_capacity);
+	list->args = malloc(sizeof(char *)*args_capacity);
+	while (start < size) {
+		const char *text = buffer + start;
+		const char *newline = memchr(text, '\n', size - start);
+		size_t len = newline == NULL ? size - start : (size_t)(newline - text);
+
+		start += len + 1;
+		if (len > 0 && text[len - 1] == '\r')
+			len--;
+		if (list->len == lines_capacity) {
+			lines_capacity *= 2;
+			list->lines = realloc(list->lines, sizeof(struct list_line)*lines_capacity);
+		}
+		struct list_line *line = &list->lines[list->len];
+
+		line->line_number = list->len;
+		line->text = cursor;
+		memcpy(cursor, text, len);
+		cursor[len] = '\0';
+		cursor += len + 1;
+		//argv pointers are stored as offsets until args stops moving
+		line->argv = (char **)(intptr_t)num_args;
+		line->argc = 0;
+		line->restart = RESTART_NEVER;
+		line->limits = 0;
+		line->cpus = NULL;
+		line->numa = NULL;
+		line->nice = NICE_UNSET;
+		line->rlimit_as = -1;
+		line->priority = 0;
+		line->after = -1;
+		line->ready = READY_EXEC;
+		line->invalid = 0;
+		line->launch = LAUNCH_NONE;
+		line->slot = -1;
+		line->launch_time = 0;
+		line->ready_fd = -1;
+		line->notify_fd = -1;
+		line->alerts = NULL;
+		line->num_alerts = 0;
+		line->log_path = NULL;
+		line->host = NULL;
+		line->log_size = LOG_SIZE;
+		line->log_read = -1;
+		line->log_write = -1;
+		line->log_fd = -1;
+		line->log_written = 0;
+		line->removed = 0;
+		size_t i = 0;
+
+		while (i < len) {
+			while (i < len && (text[i] == ' ' || text[i] == '\t'))
+				i++;
+			if (i == len)
+				break;
+			if (num_args + 2 > args_capacity) {
+				args_capacity *= 2;
+				list->args = realloc(list->args, sizeof(char *)*args_capacity);
+			}
+			list->args[num_args++] = cursor;
+			line->argc++;
+			i = copy_argument(text, len, i, &cursor);
+		}
+		list->args[num_args++] = NULL;
+		list->len++;
+	}
+	for (int i = 0; i < list->len; i++)
+		list->lines[i].argv = list->args + (intptr_t)list->lines[i].argv;
+	return list;
+}
+
+/*
+ * copy_argument
+ * description:
+ *     copies the argument starting at text[i] to *cursor, removing
+ *     its quotes and escapes, and NUL terminates it.
+ * parameters:
+ *     text: the line the argument is in.
+ *     len: the length of text.
+ *     i: the index of the first character of the argument.
+ *     cursor: where to copy the argument to, moved past its NUL.
+ * returns:
+ *     the index in text just after the argument.
+ */
+size_t copy_argument(const char *text, size_t len, size_t i, char **cursor)
+{
+	char *out = *cursor;
+	char quote = '\0';
+
+	while (i < len) {
+		char c = text[i];
+
+		if (quote == '\0' && (c == ' ' || c == '\t'))
+			break;
+		i++;
+		if (quote == '\0' && (c == '"' || c == '\'')) {
+			quote = c;
+		} else if (quote != '\0' && c == quote) {
+			quote = '\0';
+		} else if (c == '\\' && quote != '\'' && i < len) {
+			*out++ = text[i++];
+		} else {
+			*out++ = c;
+		}
+	}
+	*out++ = '\0';
+	*cursor = out;
+	return i;
+}
+
+/*
+ * free_process_list
+ * description:
+ *     frees a process list created by parse_process_buffer.
+ * parameters:
+ *     list: the process list to free.
+ */
+void free_process_list(struct process_list *list)
+{
+	for (int i = 0; i < list->len; i++) {
+		free(list->lines[i].cpus);
+		free(list->lines[i].numa);
+		free(list->lines[i].alerts);
+		if (list->lines[i].ready_fd != -1)
+			close(list->lines[i].ready_fd);
+		close_log(&list->lines[i]);
 	}
-	return return_array;
+	free(list->arena);
+	free(list->args);
+	free(list->lines);
+	free(list);
 }
 
 /*
  * create_process
  * description:
- *     creates a new process using the fork function.
- *     changes the process to the process indicated by process_path.
- *     terminates any failed forks.
+ *     creates a new process running args using the SPAWN_BACKEND
+ *     selected on the command line.
+ *     for the fork and vfork backends the child is given the write end
+ *     of a close-on-exec pipe, it writes errno to the pipe only if the
+ *     exec fails. the fork backend does not wait for the exec,
+ *     see wait_for_exec.
+ *     the spawn backend reports a failed exec directly. posix_spawnp
+ *     cannot apply the limits of a line, see apply_limits, or pass
+ *     the pipes of ready=fd and log=, so such lines use the vfork
+ *     backend instead.
+ *     with a log directive the output of the process goes to the log
+ *     pipe of its line, opened by open_log the first time it starts.
+ *     with --replay nothing is created, the process is virtual.
  * parameters:
- *     process_path: string containing path to the process to create.
+ *     line: the line of the process list to run.
+ *     group_fd: the cgroup.procs file of the cgroup of the process, or -1.
+ *     out_fd: set to the read end of the pipe for wait_for_exec
+ *             or -1 if there is nothing to wait for.
  * pre-conditions:
- *     process_path is initialized.
+ *     line is initialized.
+ * returns:
+ *     the pid of the new process.
+ *     -1 if the process could not be created or its log not opened.
  */
-void create_process(char *process_line, int *out_pid)
+int create_process(struct list_line *line, int group_fd, int *out_fd)
 {
-	int pid = fork();
+	char **args = line->argv;
+	int backend = SPAWN_BACKEND;
 
+	*out_fd = -1;
+	if (args[0] == NULL)
+		return -1;
+	if (REPLAY_TRACES != NULL)
+		return REPLAY_NEXT_PID++; //a virtual process, see replay_sample
+	if (line->log_path != NULL && line->log_write == -1 && open_log(line, -1, -1) == -1)
+		return -1;
+	if (backend == SPAWN_POSIX &&
+	    (line->limits == 1 || line->notify_fd != -1 || line->log_write != -1))
+		backend = SPAWN_VFORK;
+	if (backend == SPAWN_POSIX)
+		return spawn_posix(args, group_fd);
+	int fds[2];
+
+	if (pipe2(fds, O_CLOEXEC) == -1)
+		err(1, "pipe error");
+	fflush(stdout);
+	int pid;
+
+	if (backend == SPAWN_VFORK)
+		pid = vfork();
+	else
+		pid = fork();
 	if (pid == -1)
-		exit(1);
+		err(1, "fork error");
+	//also in the parent, so a killpg right after the launch cannot come before the child's
+	if (pid > 0 && GROUP_MODE == GROUP_PGID)
+		setpgid(pid, pid);
 	if (pid == 0) {
-		char **args = get_args(process_line);
+		int error;
 
-		if (args[0] == NULL)
-			exit(1);
-		execvp(args[0], args);
-		*out_pid = -1;
-		exit(errno);
-	} else {
-		usleep(100000);
-		int result = waitpid(pid, NULL, WNOHANG);
+		reset_child_signals();
+		join_group(group_fd);
+		//before the notify fd, which would replace the log pipe if that is fd 3
+		if (line->log_write != -1) {
+			dup2(line->log_write, STDOUT_FILENO);
+			dup2(line->log_write, STDERR_FILENO);
+		}
+		if (line->notify_fd != -1)
+			pass_notify_fd(line->notify_fd);
+		if (apply_limits(line) == 0)
+			execvp(args[0], args);
+		error = errno;
+		if (write(fds[1], &error, sizeof(error)) == -1)
+			_exit(1);
+		_exit(1);
+	}
+	close(fds[1]);
+	*out_fd = fds[0];
+	return pid;
+}
+
+/*
+ * pass_notify_fd
+ * description:
+ *     gives a new process the write end of its ready=fd pipe as fd
+ *     READY_NOTIFY_FD, kept open across its exec. called before exec.
+ * parameters:
+ *     fd: the write end of the pipe.
+ */
+void pass_notify_fd(int fd)
+{
+	if (fd == READY_NOTIFY_FD)
+		fcntl(fd, F_SETFD, 0);
+	else
+		dup2(fd, READY_NOTIFY_FD);
+}
+
+/*
+ * apply_limits
+ * description:
+ *     applies the cpus, nice, rlimit_as and numa directives of line
+ *     to the calling process. called in a new process before its exec,
+ *     only makes system calls so it is safe after vfork.
+ * parameters:
+ *     line: the line of the process list being started.
+ * returns:
+ *     0 on success.
+ *     -1 if a limit could not be applied, with errno set.
+ */
+int apply_limits(struct list_line *line)
+{
+	if (line->limits == 0)
+		return 0;
+	if (line->cpus != NULL && sched_setaffinity(0, sizeof(cpu_set_t), line->cpus) == -1)
+		return -1;
+	if (line->nice != NICE_UNSET && setpriority(PRIO_PROCESS, 0, line->nice) == -1)
+		return -1;
+	if (line->rlimit_as != -1) {
+		struct rlimit limit;
 
-		if (*out_pid != -1 && result == 0)
-			*out_pid = pid;
+		limit.rlim_cur = line->rlimit_as;
+		limit.rlim_max = line->rlimit_as;
+		if (setrlimit(RLIMIT_AS, &limit) == -1)
+			return -1;
 	}
+	//the nodes are parsed into a cpu_set_t, its bits are laid out like a nodemask
+	if (line->numa != NULL &&
+	    syscall(SYS_set_mempolicy, MPOL_BIND, (unsigned long *)line->numa, CPU_SETSIZE) == -1)
+		return -1;
+	return 0;
 }
 
 /*
- * read_next_line
+ * open_log
  * description:
- *     reads the next line in the given file object
+ *     opens the log of a line with a log directive: the file at its
+ *     path, appended to if it exists, and a pipe the processes of the
+ *     line write their stdout and stderr to. macD keeps both ends of
+ *     the pipe, so restarts of the line share it and an exited process
+ *     never closes it, and drains it with drain_log when it is readable.
+ *     a process adopted after an upgrade brings the pipe macD had before.
  * parameters:
- *     fptr: pointer to the FILE object to read from.
- * pre-conditions:
- *     fptr is initialized and is a valid FILE object
+ *     line: the line to open the log of.
+ *     read_fd, write_fd: the ends of the pipe to use, -1 to create one.
  * returns:
- *     char array, string, containing the next line of the file.
+ *     0 on success.
+ *     -1 if the log could not be opened, with a warning displayed.
  */
-char *read_next_line(FILE *fptr)
+int open_log(struct list_line *line, int read_fd, int write_fd)
 {
-	char *scanner = malloc(1);
-	char *line = malloc(PATH_MAX+MAX_ARG_LENGTH);
-	int index = 0;
-	int extensions = 0;
-	int read_items = fread(scanner, 1, 1, fptr);
+	int fds[2] = {read_fd, write_fd};
 
-	if (read_items != 1) {
-		free(scanner);
-		free(line);
-		return NULL;
+	line->log_fd = open(line->log_path, O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+	if (line->log_fd == -1) {
+		warn("could not open log %s", line->log_path);
+		return -1;
 	}
-	while (*scanner != '\n' && read_items == 1) {
-		line[index] = *scanner;
-		index++;
-		if (index >= PATH_MAX + (MAX_ARG_LENGTH * (extensions+1))) {
-			//grow the array.
-			extensions++;
-			char *temp = line;
+	//splice cannot write to an O_APPEND file, so write from the end instead
+	line->log_written = lseek(line->log_fd, 0, SEEK_END);
+	if (read_fd == -1 && pipe2(fds, O_CLOEXEC) == -1)
+		err(1, "pipe error");
+	//only macD's end is non blocking, a process writing to a full pipe waits
+	fcntl(fds[0], F_SETFL, O_NONBLOCK);
+	fcntl(fds[0], F_SETPIPE_SZ, LOG_PIPE_SIZE);
+	line->log_read = fds[0];
+	line->log_write = fds[1];
+	if (line->log_read >= LOG_LINES_LEN) {
+		int len = line->log_read*2 + 1;
 
-			line = malloc(PATH_MAX + (MAX_ARG_LENGTH*(extensions+1)));
-			strncpy(line, temp, PATH_MAX+MAX_ARG_LENGTH*(extensions)-1);
-			free(temp);
-		}
-		read_items = fread(scanner, 1, 1, fptr);
+		LOG_LINES = realloc(LOG_LINES, sizeof(struct list_line *)*len);
+		if (LOG_LINES == NULL)
+			err(1, "log allocation error");
+		for (int i = LOG_LINES_LEN; i < len; i++)
+			LOG_LINES[i] = NULL;
+		LOG_LINES_LEN = len;
+	}
+	LOG_LINES[line->log_read] = line;
+	if (EPOLL_FD != -1)
+		watch_fd(line->log_read, EVENT_LOG);
+	return 0;
+}
+
+/*
+ * drain_log
+ * description:
+ *     moves everything waiting in the log pipe of line to its log file
+ *     with splice, so the output never passes through macD's memory.
+ *     once the file reaches the log_size of the line it is rotated:
+ *     renamed to [path].1, replacing the previous one, and a new file
+ *     is started.
+ * parameters:
+ *     line: the line to drain the log of.
+ */
+void drain_log(struct list_line *line)
+{
+	while (1) {
+		if (line->log_written >= line->log_size)
+			rotate_log(line);
+		ssize_t moved = splice(line->log_read, NULL, line->log_fd, NULL,
+				       line->log_size - line->log_written,
+				       SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+
+		if (moved == -1 && errno == EINTR)
+			continue;
+		if (moved <= 0)
+			return;
+		line->log_written += moved;
+	}
+}
+
+/*
+ * rotate_log
+ * description:
+ *     renames the log file of line to [path].1 and opens a new one.
+ *     if the new file cannot be opened the log continues in the
+ *     renamed one.
+ * parameters:
+ *     line: the line to rotate the log of.
+ */
+void rotate_log(struct list_line *line)
+{
+	char path[PATH_MAX];
+
+	snprintf(path, sizeof(path), "%s.1", line->log_path);
+	line->log_written = 0;
+	if (rename(line->log_path, path) == -1) {
+		warn("could not rotate log %s", line->log_path);
+		return;
+	}
+	int fd = open(line->log_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+
+	if (fd == -1) {
+		warn("could not open log %s", line->log_path);
+		return;
 	}
-	free(scanner);
-	line[index] = '\0';
-	return line;
+	close(line->log_fd);
+	line->log_fd = fd;
+}
+
+/*
+ * close_log
+ * description:
+ *     drains what is left in the log pipe of line and closes its log.
+ * parameters:
+ *     line: the line to close the log of.
+ */
+void close_log(struct list_line *line)
+{
+	if (line->log_read == -1)
+		return;
+	drain_log(line);
+	LOG_LINES[line->log_read] = NULL;
+	close(line->log_read);
+	close(line->log_write);
+	close(line->log_fd);
+	line->log_read = -1;
+	line->log_write = -1;
+	line->log_fd = -1;
+}
+
+/*
+ * flush_logs
+ * description:
+ *     drains the log pipe of every line, called before macD exits so
+ *     the last output of the processes reaches their logs.
+ */
+void flush_logs(void)
+{
+	for (int fd = 0; fd < LOG_LINES_LEN; fd++) {
+		if (LOG_LINES[fd] != NULL)
+			drain_log(LOG_LINES[fd]);
+	}
+}
+
+/*
+ * spawn_posix
+ * description:
+ *     creates a new process running args with posix_spawnp.
+ *     the signal mask of the new process is cleared.
+ *     posix_spawnp has no way to join a cgroup before the exec, so with
+ *     -g cgroup the process is moved into its cgroup right after it.
+ * parameters:
+ *     args: NULL terminated list of the program and its arguments.
+ *     group_fd: the cgroup.procs file of the cgroup of the process, or -1.
+ * pre-conditions:
+ *     args is initialized and args[0] is not NULL.
+ * returns:
+ *     the pid of the new process.
+ *     -1 if the process could not be created or failed to exec.
+ */
+int spawn_posix(char **args, int group_fd)
+{
+	posix_spawnattr_t attr;
+	sigset_t mask;
+	pid_t pid;
+	short flags = POSIX_SPAWN_SETSIGMASK;
+
+	sigemptyset(&mask);
+	posix_spawnattr_init(&attr);
+	posix_spawnattr_setsigmask(&attr, &mask);
+	if (GROUP_MODE == GROUP_PGID) {
+		posix_spawnattr_setpgroup(&attr, 0);
+		flags |= POSIX_SPAWN_SETPGROUP;
+	}
+	posix_spawnattr_setflags(&attr, flags);
+	fflush(stdout);
+	int result = posix_spawnp(&pid, args[0], NULL, &attr, args, environ);
+
+	posix_spawnattr_destroy(&attr);
+	if (result != 0)
+		return -1;
+	if (group_fd != -1)
+		dprintf(group_fd, "%d", pid);
+	return pid;
+}
+
+/*
+ * wait_for_exec
+ * description:
+ *     waits until the process created by create_process has either
+ *     exec'd, which closes the pipe, or failed to exec, in which case
+ *     the child wrote its errno to the pipe.
+ *     failed processes are reaped.
+ * parameters:
+ *     pid: the pid returned by create_process.
+ *     fd: the pipe returned by create_process, closed by this function.
+ *         if fd is -1 the process has already exec'd.
+ * returns:
+ *     pid if the process was started successfully.
+ *     -1 otherwise.
+ */
+int wait_for_exec(int pid, int fd)
+{
+	if (fd == -1)
+		return pid;
+	int error;
+	ssize_t got = read(fd, &error, sizeof(error));
+
+	while (got == -1 && errno == EINTR)
+		got = read(fd, &error, sizeof(error));
+	close(fd);
+	if (got == 0)
+		return pid;
+	waitpid(pid, NULL, 0);
+	return -1;
 }
 
 /*
@@ -267,679 +1141,6102 @@ int convert_str_to_int(char *str)
  *     the value of the time limit if the given line is a timer.
  *     -1 otherwise.
  */
-int read_timer(char *line)
+int read_timer(struct list_line *line)
 {
-	if (line == NULL)
+	if (line == NULL || line->argc != 2)
 		return -1;
-	if (line[0] == '\0')
-		return -1;
-	char *token = strtok(line, " ");
-
-	if (strcmp(token, "timelimit") == 0) {
-		token = strtok(NULL, " ");
-		if (token == NULL)
-			return -1;
-		int timer = convert_str_to_int(token);
-
-		return timer;
-	}
+	if (strcmp(line->argv[0], "timelimit") == 0)
+		return convert_str_to_int(line->argv[1]);
 	return -1;
 }
 
 /*
- * get_month
- * description:
- *     converts the month in current time to
- *     its string representation.
- * parameters:
- *     current_time: tm structure containing the current time.
- * returns:
- *     string representation of the month.
- */
-char *get_month(struct tm current_time)
-{
-	int month_num = current_time.tm_mon;
-	char *month = "";
-
-	switch (month_num) {
-	case 0:
-		month = "Jan";
-		break;
-	case 1:
-		month = "Feb";
-		break;
-	case 2:
-		month = "Mar";
-		break;
-	case 3:
-		month = "Apr";
-		break;
-	case 4:
-		month = "May";
-		break;
-	case 5:
-		month = "June";
-		break;
-	case 6:
-		month = "July";
-		break;
-	case 7:
-		month = "Aug";
-		break;
-	case 8:
-		month = "Sept";
-		break;
-	case 9:
-		month = "Oct";
-		break;
-	case 10:
-		month = "Nov";
-		break;
-	case 11:
-		month = "Dec";
-		break;
-	}
-	return month;
-}
-
-/*
- * get_day_of_week
- * description:
- *     converts the day in current time to
- *     its string representaion.
- * parameters:
- *     current_time: tm structure containing the current time.
- * returns:
- *     string representation of the day.
- */
-char *get_day_of_week(struct tm current_time)
-{
-	int day = current_time.tm_wday;
-	char *day_of_week = "";
-
-	switch (day) {
-	case 0:
-		day_of_week = "Sun";
-		break;
-	case 1:
-		day_of_week = "Mon";
-		break;
-	case 2:
-		day_of_week = "Tue";
-		break;
-	case 3:
-		day_of_week = "Wed";
-		break;
-	case 4:
-		day_of_week = "Thu";
-		break;
-	case 5:
-		day_of_week = "Fri";
-		break;
-	case 6:
-		day_of_week = "Sat";
-		break;
-	}
-	return day_of_week;
-}
-
-/*
- * display_date
+ * read_directives
  * description:
- *     displays the current time in the following format:
- *     [day_of_week], [month] [day], [year] [hour]:[min]:[sec] [AM/PM]
+ *     removes the directives at the start of a line of the process list
+ *     and stores them in the line. a directive is an argument of the
+ *     form "[name]=[value]" placed before the program, for example
+ *     "restart=on-failure ./server -p 80".
+ *     directives:
+ *         restart=always|on-failure|never: restart the process when it
+ *         exits, see schedule_restart. defaults to never.
+ *         cpus=[list]: the cpus the process may run on, e.g. 0-3,8.
+ *         nice=[n]: the nice value of the process.
+ *         rlimit_as=[size]: the limit on the address space of the
+ *         process in bytes, or with a K, M or G suffix.
+ *         numa=[list]: the NUMA nodes the process allocates memory from.
+ *         priority=[n]: the tier the line starts in, see run_launches.
+ *         after=[line]: the line number the line waits for to be ready.
+ *         ready=exec|cpu|fd: when the process counts as ready, see
+ *         update_starting. defaults to exec.
+ *         alert=[rule]: an action taken when the usage of the process
+ *         crosses a threshold, see compile_alert. up to MAX_ALERTS.
+ *         log=[path]: the file the stdout and stderr of the process
+ *         are written to instead of macD's stdout, see open_log.
+ *         log_size=[size]: the size the log is rotated at, in bytes or
+ *         with a K, M or G suffix. defaults to LOG_SIZE.
+ *         host=[name]: the instance the line runs on, see shard_owns.
+ *     an argument that does not start with the name of a directive
+ *     is the program and ends the directives.
+ * parameters:
+ *     line: the line to read the directives of.
+ * returns:
+ *     0 if every directive was valid.
+ *     -1 otherwise, the line should not be started.
  */
-void display_date(void)
+int read_directives(struct list_line *line)
 {
-	time_t t = time(NULL);
-	struct tm current_time = *localtime(&t);
-	char *wkday = get_day_of_week(current_time);
-	char *month = get_month(current_time);
-	int date = current_time.tm_mday;
-	int year = 1900 + current_time.tm_year;
-	int hour = current_time.tm_hour;
-	char *xm = "AM";
+	while (line->argc > 0) {
+		char *arg = line->argv[0];
+		char *value = strchr(arg, '=');
 
-	if (hour >= 12) {
-		xm = "PM";
-		hour -= 12;
-	}
-	if (hour == 0)
-		hour = 12;
-	int min = current_time.tm_min;
-	int sec = current_time.tm_sec;
+		if (value == NULL)
+			break;
+		value++;
+		if (strncmp(arg, "restart=", 8) == 0) {
+			if (strcmp(value, "always") == 0)
+				line->restart = RESTART_ALWAYS;
+			else if (strcmp(value, "on-failure") == 0)
+				line->restart = RESTART_ON_FAILURE;
+			else if (strcmp(value, "never") == 0)
+				line->restart = RESTART_NEVER;
+			else
+				return directive_error(line, arg);
+		} else if (strncmp(arg, "cpus=", 5) == 0) {
+			line->cpus = parse_id_list(value);
+			if (line->cpus == NULL)
+				return directive_error(line, arg);
+		} else if (strncmp(arg, "numa=", 5) == 0) {
+			line->numa = parse_id_list(value);
+			if (line->numa == NULL)
+				return directive_error(line, arg);
+		} else if (strncmp(arg, "nice=", 5) == 0) {
+			char *end;
+
+			line->nice = strtol(value, &end, 10);
+			if (end == value || *end != '\0' || line->nice < -20 || line->nice > 19)
+				return directive_error(line, arg);
+		} else if (strncmp(arg, "rlimit_as=", 10) == 0) {
+			line->rlimit_as = parse_size(value);
+			if (line->rlimit_as == -1)
+				return directive_error(line, arg);
+		} else if (strncmp(arg, "priority=", 9) == 0) {
+			char *end;
 
-	printf("%s, %s %d, %d %d:%d:%d %s\n", wkday, month, date, year, hour, min, sec, xm);
+			line->priority = strtol(value, &end, 10);
+			if (end == value || *end != '\0')
+				return directive_error(line, arg);
+		} else if (strncmp(arg, "after=", 6) == 0) {
+			line->after = convert_str_to_int(value);
+			if (line->after < 0)
+				return directive_error(line, arg);
+		} else if (strncmp(arg, "ready=", 6) == 0) {
+			if (strcmp(value, "exec") == 0)
+				line->ready = READY_EXEC;
+			else if (strcmp(value, "cpu") == 0)
+				line->ready = READY_CPU;
+			else if (strcmp(value, "fd") == 0)
+				line->ready = READY_FD;
+			else
+				return directive_error(line, arg);
+		} else if (strncmp(arg, "alert=", 6) == 0) {
+			if (line->alerts == NULL)
+				line->alerts = malloc(sizeof(struct alert_rule)*MAX_ALERTS);
+			if (line->num_alerts == MAX_ALERTS ||
+			    compile_alert(value, &line->alerts[line->num_alerts]) == -1)
+				return directive_error(line, arg);
+			line->num_alerts++;
+			ALERTS_USED = 1;
+		} else if (strncmp(arg, "log=", 4) == 0) {
+			if (value[0] == '\0')
+				return directive_error(line, arg);
+			line->log_path = value;
+		} else if (strncmp(arg, "host=", 5) == 0) {
+			line->host = value;
+		} else if (strncmp(arg, "log_size=", 9) == 0) {
+			line->log_size = parse_size(value);
+			if (line->log_size <= 0)
+				return directive_error(line, arg);
+		} else {
+			break;
+		}
+		line->argv++;
+		line->argc--;
+	}
+	line->limits = line->cpus != NULL || line->numa != NULL || line->nice != NICE_UNSET ||
+		       line->rlimit_as != -1;
+	return 0;
 }
 
 /*
- * read_file
+ * read_launch_settings
  * description:
- *     reads all lines in the given file.
- *     creates a process for each line in the file where the line
- *     indicates what process to create.
+ *     checks if a line at the top of the process list sets how lines
+ *     are started, and if so applies it. such a line holds nothing but
+ *     settings of the form "[name]=[value]":
+ *         max_starting=[n]: at most n processes start at the same time,
+ *         a process is starting until it is ready. 0, the default, is
+ *         no limit.
+ *         spawn_rate=[n]: at most n processes are started per second.
+ *         0, the default, is no limit.
+ *         ready_timeout=[s]: a process that is not ready after s seconds
+ *         counts as ready anyway. defaults to 30.
  * parameters:
- *     file_path: string of the path to the file to read.
- * pre-conditions:
- *     file_path is initialized.
+ *     line: the line to check.
+ * returns:
+ *     1 if the line is a settings line, even if a value is invalid.
+ *     0 if it is a line to start.
  */
-int *read_file(char *file_path)
+int read_launch_settings(struct list_line *line)
 {
-	FILE *fptr = fopen(file_path, "r");
+	char *names[] = {"max_starting=", "spawn_rate=", "ready_timeout="};
 
-	if (fptr == NULL) {
-		fprintf(stderr, "macD: %s not found", file_path);
-		return NULL;
-	}
-	//read file for processes
-	printf("%s", "Starting report, ");
-	display_date();
-	char *line = read_next_line(fptr);
+	if (line->argc == 0)
+		return 0;
+	for (int i = 0; i < line->argc; i++) {
+		int known = 0;
 
-	TARGET_TIME = read_timer(line);
-	if (TARGET_TIME != -1) {
-		free(line);
-		line = read_next_line(fptr);
+		for (int n = 0; n < 3; n++)
+			known |= strncmp(line->argv[i], names[n], strlen(names[n])) == 0;
+		if (known == 0)
+			return 0;
 	}
-	int *pids = malloc(sizeof(int)*MAX_PROCESSES);
-	int index = 0;
-	int line_number = 0;
-	int len_pids = MAX_PROCESSES;
-	int *out_pid = malloc(sizeof(int *));
-
-	while (line != NULL) {
-		*out_pid = -2;
-		if (line[0] != '\0')
-			create_process(line, out_pid);
-		if (*out_pid >= 0) {
-			pids[index] = *out_pid;
-			char *path = strtok(line, " ");
-
-			printf("[%d] %s, started successfully (pid: %d)\n", line_number, path, *out_pid);
-			index++;
-		} else {
-			if (line[0] == '\0') {
-				printf("[%d] badprogram , failed to start\n", line_number);
-			} else {
-				char *path = strtok(line, " ");
-
-				printf("[%d] badprogram %s, failed to start\n", line_number, path);
-			}
-		}
-		if (index >= len_pids - 1) {
-			//increase size of pids
-			len_pids = len_pids + MAX_PROCESSES;
-			int *temp = pids;
+	for (int i = 0; i < line->argc; i++) {
+		char *value = strchr(line->argv[i], '=') + 1;
+		char *end;
+		double number = strtod(value, &end);
 
-			pids = malloc(sizeof(int)*len_pids);
-			for (int i = 0; i < index; i++)
-				pids[i] = temp[i];
-			free(temp);
+		if (end == value || *end != '\0' || number < 0) {
+			directive_error(line, line->argv[i]);
+			continue;
 		}
-		line_number++;
-		free(line);
-		line = read_next_line(fptr);
+		if (strncmp(line->argv[i], "max_starting=", 13) == 0)
+			MAX_STARTING = number;
+		else if (strncmp(line->argv[i], "spawn_rate=", 11) == 0)
+			SPAWN_RATE = number*REPLAY_SPEED;
+		else
+			READY_TIMEOUT = number/REPLAY_SPEED;
 	}
-	free(line);
-	free(out_pid);
-	fclose(fptr);
-	pids[index] = -1;//to indicate end of array
-	return pids;
+	return 1;
 }
 
 /*
- * get_num_digits
+ * read_list_header
  * description:
- *     counts the number of digits in i.
+ *     finds the first line of the process list to start, skipping the
+ *     time limit, see read_timer, and the settings lines after it,
+ *     see read_launch_settings, which are applied.
  * parameters:
- *    i: integer to count the digits of.
+ *     list: the process list.
  * returns:
- *     the number of digits in i.
+ *     the index of the first line to start.
  */
-int get_num_digits(int i)
+int read_list_header(struct process_list *list)
 {
-	int digits = 0;
+	int first = 0;
 
-	if (i < 0)
-		i = i*-1;
-	if (i == 0)
-		return 1;
-	while (i >= 1) {
-		digits += 1;
-		i = i / 10;
-	}
-	return digits;
+	if (list->len > 0 && read_timer(&list->lines[0]) != -1)
+		first = 1;
+	while (first < list->len && read_launch_settings(&list->lines[first]) == 1)
+		first++;
+	return first;
 }
 
 /*
- * convert_int_to_string
+ * parse_id_list
  * description:
- *     converts the given integer to a string.
+ *     parses a list of cpu or node numbers and ranges separated by
+ *     commas, for example "0-3,8,10-11".
  * parameters:
- *     i: integer to convert to string.
- * pre-condition:
- *     i>=0
+ *     str: the list to parse.
  * returns:
- *     string representaion of i.
+ *     a new set of the numbers in the list.
+ *     NULL if the list is not valid.
  */
-char *convert_int_to_string(int i)
+cpu_set_t *parse_id_list(char *str)
 {
-	if (i == 0)
-		return "0";
-	char *str = malloc(get_num_digits(i));
-	int index = 0;
+	cpu_set_t *set = calloc(1, sizeof(cpu_set_t));
+	char *scan = str;
 
-	while (i > 0) {
-		int d = i % 10;
+	while (set != NULL && *scan != '\0') {
+		char *end;
+		long first = strtol(scan, &end, 10);
+		long last = first;
 
-		str[index] = '0' + d;
-		i -= d;
-		i = i / 10;
-		index++;
+		if (end == scan || first < 0)
+			break;
+		if (*end == '-') {
+			scan = end + 1;
+			last = strtol(scan, &end, 10);
+			if (end == scan)
+				break;
+		}
+		if (last < first || last >= CPU_SETSIZE)
+			break;
+		for (long id = first; id <= last; id++)
+			CPU_SET(id, set);
+		scan = end;
+		if (*scan == ',' && scan[1] != '\0')
+			scan++;
+		else if (*scan != '\0')
+			break;
 	}
-	//reverse string
-	int lptr = 0;
-	int rptr = index-1;
-
-	while (lptr < rptr) {
-		char temp = str[rptr];
-
-		str[rptr] = str[lptr];
-		str[lptr] = temp;
-		lptr++;
-		rptr--;
+	if (set == NULL || *scan != '\0' || CPU_COUNT(set) == 0) {
+		free(set);
+		return NULL;
 	}
-	return str;
+	return set;
 }
 
 /*
- * read_until_space
+ * parse_size
  * description:
- *     reads through the given file until it reaches a space
- *     or the end of a file.
+ *     parses a size in bytes with an optional K, M or G suffix.
  * parameters:
- *     fptr: FILE pointer to be read through.
- * pre-condition:
- *     fptr is initalized.
- * post-condition:
- *     the read from point in fptr is moved such that the next character read
- *     will be the character immediately after the space, or EOF if no space was found.
+ *     str: the size to parse, e.g. "512M".
  * returns:
- *     1 if a space was found, meaning fptr not at EOF.
- *     0 if no space was found, meaning fptr is at EOF.
+ *     the size in bytes.
+ *     -1 if str is not a valid size.
  */
-int read_until_space(FILE *fptr)
+long parse_size(char *str)
 {
-	char *c = malloc(1);
-	int read = fread(c, 1, 1, fptr);
+	char *end;
+	long size = strtol(str, &end, 10);
 
-	while (*c != ' ' && read == 1)
-		read = fread(c, 1, 1, fptr);
-	free(c);
-	return read;
+	if (end == str || size < 0)
+		return -1;
+	if (*end == 'K' || *end == 'k')
+		size <<= 10;
+	else if (*end == 'M' || *end == 'm')
+		size <<= 20;
+	else if (*end == 'G' || *end == 'g')
+		size <<= 30;
+	else if (*end != '\0')
+		return -1;
+	if (*end != '\0' && end[1] != '\0')
+		return -1;
+	return size;
 }
 
 /*
- * get_next_segment
+ * format_id_list
  * description:
- *     reads fptr until the next space character or EOF.
- *     returns all characters between read before finding a space.
+ *     formats a set of cpus as a list of numbers and ranges,
+ *     the inverse of parse_id_list.
  * parameters:
- *     fptr: FILE pointer to be read through.
- * pre-condition:
- *     fptr is initalized.
- * post-condition:
- *     the read from point in fptr is moved such that the next character read
- *     will be the character immediately after the space, or EOF if no space was found.
- * returns:
- *     char array of all characters read before finding a space or EOF.
+ *     set: the set to format.
+ *     buffer: where the list is written, NUL terminated.
+ *     size: the size of buffer.
  */
-char *get_next_segment(FILE *fptr)
+void format_id_list(cpu_set_t *set, char *buffer, int size)
 {
-	char *segment = malloc(MAX_SEGMENT_LENGTH);
-	int seg_size = MAX_SEGMENT_LENGTH;
-	int index = 0;
-	char *c = malloc(1);
-	int read = fread(c, 1, 1, fptr);
+	int len = 0;
 
-	while (*c != ' ' && read == 1) {
-		segment[index] = *c;
-		index++;
-		if (index >= seg_size) {
-			//adjust size
-			char *temp = segment;
+	buffer[0] = '\0';
+	for (int id = 0; id < CPU_SETSIZE && len < size; id++) {
+		if (!CPU_ISSET(id, set))
+			continue;
+		int last = id;
 
-			segment = malloc(seg_size+MAX_SEGMENT_LENGTH);
-			seg_size += MAX_SEGMENT_LENGTH;
-			for (int i = 0; i < index; i++)
-				segment[i] = temp[i];
-			free(temp);
-		}
-		read = fread(c, 1, 1, fptr);
+		while (last + 1 < CPU_SETSIZE && CPU_ISSET(last + 1, set))
+			last++;
+		if (last == id)
+			len += snprintf(buffer + len, size - len, "%s%d", len > 0 ? "," : "", id);
+		else
+			len += snprintf(buffer + len, size - len, "%s%d-%d", len > 0 ? "," : "", id, last);
+		id = last;
 	}
-	free(c);
-	segment[index] = '\0';
-	return segment;
 }
 
 /*
- * get_cpu_usage
+ * compile_alert
  * description:
- *     computes the total amount of time the process has spent
- *     on the cpu, measured in clock ticks by
- *     reading /proc/[pid]/stat to find the user time and kernal time.
+ *     parses the rule of an alert directive, of the form
+ *     "[metric][op][threshold] for [duration] -> [action]", for example
+ *     "cpu>90% for 30s -> SIGTERM" or "mem>=2GB -> restart".
+ *         metric: cpu, as a percent, or mem, in MB, which may also be
+ *         named after the metric of -m, e.g. rss.
+ *         op: >, >=, < or <=.
+ *         threshold: a number, for mem with an optional K, M or G
+ *         suffix, optionally followed by B.
+ *         duration: optional, how long the threshold must be crossed in
+ *         every sample before acting, with a ms, s or m suffix.
+ *         action: a signal such as SIGTERM or TERM, restart to stop the
+ *         process and restart it whatever its restart policy, or log to
+ *         only display the alert.
+ *     the rule is compiled once here so check_alerts only compares numbers.
  * parameters:
- *     pid: the process id of the process to compute the cpu usage for.
+ *     text: the rule.
+ *     rule: where the compiled rule is stored.
  * returns:
- *     the number of ticks the process has been on the cpu for
- *     or -1 if no such process with pid exists.
+ *     0 on success.
+ *     -1 if the rule is not valid.
  */
-int get_cpu_usage(int pid)
+int compile_alert(char *text, struct alert_rule *rule)
 {
-	char *path = malloc(12+get_num_digits(pid));
+	char *scan = text;
+	char *end;
+	int len;
 
-	path[0] = '\0';
-	char *part1 = "/proc/";
-	char *part2 = "/stat";
+	memset(rule, 0, sizeof(*rule));
+	rule->text = text;
+	scan += strspn(scan, " ");
+	len = strspn(scan, "abcdefghijklmnopqrstuvwxyz");
+	if (len == 3 && strncmp(scan, "cpu", 3) == 0)
+		rule->metric = ALERT_CPU;
+	else if ((len == 3 && strncmp(scan, "mem", 3) == 0) ||
+		 (len == (int)strlen(MEM_NAMES[MEM_METRIC]) && strncmp(scan, MEM_NAMES[MEM_METRIC], len) == 0))
+		rule->metric = ALERT_MEM;
+	else
+		return -1;
+	scan += len;
+	scan += strspn(scan, " ");
+	if (scan[0] == '>' || scan[0] == '<') {
+		rule->op = scan[0] == '>' ? ALERT_GT : ALERT_LT;
+		if (scan[1] == '=')
+			rule->op = scan[0] == '>' ? ALERT_GE : ALERT_LE;
+		scan += scan[1] == '=' ? 2 : 1;
+	} else {
+		return -1;
+	}
+	scan += strspn(scan, " ");
+	long threshold = strtol(scan, &end, 10);
 
-	strncat(path, part1, 6);
-	char *str_pid = convert_int_to_string(pid);
+	if (end == scan || threshold < 0)
+		return -1;
+	scan = end;
+	if (rule->metric == ALERT_CPU) {
+		if (*scan == '%')
+			scan++;
+	} else {
+		long unit = 1;
 
-	strncat(path, str_pid, get_num_digits(pid));
-	free(str_pid);
-	strncat(path, part2, 5);
-	FILE *fptr = fopen(path, "r");
+		if (*scan == 'K' || *scan == 'k')
+			unit = -1024;
+		else if (*scan == 'M' || *scan == 'm')
+			unit = 1;
+		else if (*scan == 'G' || *scan == 'g')
+			unit = 1024;
+		if (*scan == 'K' || *scan == 'k' || *scan == 'M' || *scan == 'm' || *scan == 'G' || *scan == 'g')
+			scan++;
+		if (*scan == 'B')
+			scan++;
+		threshold = unit < 0 ? threshold/-unit : threshold*unit;
+	}
+	rule->threshold = threshold;
+	scan += strspn(scan, " ");
+	if (strncmp(scan, "for ", 4) == 0) {
+		scan += 4;
+		scan += strspn(scan, " ");
+		double duration = strtod(scan, &end);
 
-	free(path);
-	if (fptr == NULL) {
-		fclose(fptr);
+		if (end == scan || duration < 0)
+			return -1;
+		scan = end;
+		if (strncmp(scan, "ms", 2) == 0) {
+			duration /= 1000;
+			scan += 2;
+		} else if (*scan == 's') {
+			scan++;
+		} else if (*scan == 'm') {
+			duration *= 60;
+			scan++;
+		}
+		rule->duration = duration;
+		scan += strspn(scan, " ");
+	}
+	if (strncmp(scan, "->", 2) != 0)
+		return -1;
+	scan += 2;
+	scan += strspn(scan, " ");
+	len = strcspn(scan, " ");
+	if (scan[len + strspn(scan + len, " ")] != '\0' || len == 0)
 		return -1;
+	if (len == 7 && strncmp(scan, "restart", 7) == 0) {
+		rule->action = ALERT_RESTART;
+		return 0;
+	}
+	if (len == 3 && strncmp(scan, "log", 3) == 0) {
+		rule->action = ALERT_LOG;
+		return 0;
+	}
+	if (strncmp(scan, "SIG", 3) == 0) {
+		scan += 3;
+		len -= 3;
 	}
-	//Read until the usertime section of the file
-	// which is the 14th segment (after 13 spaces).
-	for (int i = 0; i < 13; i++) {
-		int r = read_until_space(fptr);
+	for (int sig = 1; sig < NSIG; sig++) {
+		const char *name = sigabbrev_np(sig);
 
-		if (r == 0) {
-			fclose(fptr);
-			return -1; //file not long enough
+		if (name != NULL && (int)strlen(name) == len && strncmp(scan, name, len) == 0) {
+			rule->action = ALERT_SIGNAL;
+			rule->sig = sig;
+			return 0;
 		}
 	}
-	//get user time
-	char *s_user = get_next_segment(fptr);
-	int user_time = atoi(s_user);
-	//get kernal time
-	char *s_kernal = get_next_segment(fptr);
-	int kernal_time = atoi(s_kernal);
-
-	free(s_user);
-	free(s_kernal);
-	fclose(fptr);
-	return user_time + kernal_time;
+	return -1;
 }
 
 /*
- * get_mem_usage
+ * directive_error
  * description:
- *     computes the amount of memory used by the process
+ *     displays an invalid directive on stderr.
  * parameters:
- *     pid: id of the process to compute memory usage of.
+ *     line: the line the directive is on.
+ *     directive: the invalid directive.
  * returns:
- *     the memory usage, in MB, of the given process
- *     or -1 if no such process exists.
+ *     -1, for read_directives to return.
  */
-int get_mem_usage(int pid)
+int directive_error(struct list_line *line, char *directive)
 {
-	char *path = malloc(13+get_num_digits(pid));
+	fprintf(stderr, "macD: invalid directive %s in \"%s\"\n", directive, line->text);
+	return -1;
+}
 
-	path[0] = '\0';
-	char *part1 = "/proc/";
-	char *part2 = "/statm";
+/*
+ * display_date
+ * description:
+ *     displays the time of the clock snapshot in the following format:
+ *     [day_of_week], [month] [day], [year] [hour]:[min]:[sec] [AM/PM]
+ */
+void display_date(void)
+{
+	out_printf("%s\n", get_date());
+}
 
-	strncat(path, part1, 6);
-	char *str_pid = convert_int_to_string(pid);
+/*
+ * update_clock
+ * description:
+ *     takes a snapshot of the monotonic and real time in NOW, shared by
+ *     everything that needs the time in this iteration of the event
+ *     loop instead of each reading it again.
+ */
+void update_clock(void)
+{
+	struct timespec now;
 
-	strncat(path, str_pid, get_num_digits(pid));
-	free(str_pid);
-	strncat(path, part2, 6);
-	FILE *fptr = fopen(path, "r");
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	NOW.monotonic = now.tv_sec + now.tv_nsec/1e9;
+	clock_gettime(CLOCK_REALTIME_COARSE, &now);
+	NOW.realtime = now.tv_sec;
+}
 
-	free(path);
-	if (fptr == NULL) {
-		fclose(fptr);
-		return -1;
-	}
-	//read contents of file, summing up all numbers as they are read.
-	int sum = 0;
-	char *segment = get_next_segment(fptr);
+/*
+ * get_date
+ * description:
+ *     formats the real time of the clock snapshot for the reports as
+ *     [day_of_week], [month] [day], [year] [hour]:[min]:[sec] [AM/PM]
+ *     the text is kept, and only formatted again once the snapshot is
+ *     in another second, so reports in the same second share it.
+ *     the time zone is read once by tzset in main.
+ * returns:
+ *     the date, valid until the next call.
+ */
+char *get_date(void)
+{
+	static char *days[] = {"Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"};
+	static char *months[] = {"Jan", "Feb", "Mar", "Apr", "May", "June",
+				 "July", "Aug", "Sept", "Oct", "Nov", "Dec"};
 
-	while (strlen(segment) != 0) {
-		sum += atoi(segment);
-		free(segment);
-		segment = get_next_segment(fptr);
+	if (NOW.date_time != NOW.realtime || NOW.date[0] == '\0') {
+		struct tm current_time;
+
+		localtime_r(&NOW.realtime, &current_time);
+		int hour = current_time.tm_hour % 12;
+
+		snprintf(NOW.date, sizeof(NOW.date), "%s, %s %d, %d %d:%d:%d %s",
+			 days[current_time.tm_wday], months[current_time.tm_mon],
+			 current_time.tm_mday, 1900 + current_time.tm_year, hour == 0 ? 12 : hour,
+			 current_time.tm_min, current_time.tm_sec,
+			 current_time.tm_hour >= 12 ? "PM" : "AM");
+		NOW.date_time = NOW.realtime;
 	}
-	free(segment);
-	fclose(fptr);
-	return sum/1024;
+	return NOW.date;
 }
 
 /*
- * initialize_cpu_counters
+ * parse_output_format
  * description:
- *     creates an array with a size equal to the amount of processes.
- *     this array will contain the cpu usage of each process from the
- *     previous reporting cycle.
+ *     converts the name of an output format given with -o
+ *     to its OUTPUT_* value.
  * parameters:
- *     pids: list of process ids
- *     num_processes: the length of pids, the number of processes.
- * pre-conditions:
- *     pids is initialized.
- *     num_processes is the length of pids.
+ *     name: "text", "json" or "binary".
+ * returns:
+ *     the OUTPUT_* value of name.
+ *     -1 if name is not an output format.
+ */
+int parse_output_format(char *name)
+{
+	if (strcmp(name, "text") == 0)
+		return OUTPUT_TEXT;
+	if (strcmp(name, "json") == 0)
+		return OUTPUT_JSON;
+	if (strcmp(name, "binary") == 0)
+		return OUTPUT_BINARY;
+	return -1;
+}
+
+/*
+ * out_reserve
+ * description:
+ *     makes sure the output buffer has room for size more bytes
+ *     in its current chunk, moving on to the next chunk if needed.
+ *     chunks are kept between flushes, so after the first few reports
+ *     nothing is allocated.
+ * parameters:
+ *     size: the number of bytes about to be written.
  * returns:
- *     list of integers containing the number of ticks each process
- *     has run on the cpu for. This list is in the same order as pids.
- *     so the processes at pids[i] will have run for counters[i] ticks.
+ *     the chunk to write to.
  */
-int *initialize_cpu_counters(int *pids, int num_processes)
+struct out_chunk *out_reserve(size_t size)
 {
-	int *counters = malloc(sizeof(int)*num_processes);
+	struct report_buffer *out = &REPORT;
+
+	if (out->used > 0) {
+		struct out_chunk *chunk = out->chunks[out->used - 1];
 
-	for (int i = 0; i < num_processes; i++) {
-		//get initial cpu usage
-		counters[i] = get_cpu_usage(pids[i]);
-		if (counters[i] < 0)
-			counters[i] = 0;
+		if (chunk->capacity - chunk->len >= size)
+			return chunk;
 	}
-	return counters;
+	if (out->used == out->num_chunks || out->chunks[out->used]->capacity < size) {
+		if (out->used == out->num_chunks) {
+			out->num_chunks++;
+			out->chunks = realloc(out->chunks, sizeof(struct out_chunk *)*out->num_chunks);
+		} else {
+			//too small for this write, replace it with one that fits
+			free(out->chunks[out->used]);
+		}
+		size_t capacity = size > OUT_CHUNK_SIZE ? size : OUT_CHUNK_SIZE;
+		struct out_chunk *chunk = malloc(sizeof(struct out_chunk) + capacity);
+
+		if (chunk == NULL)
+			err(1, "output buffer allocation error");
+		chunk->capacity = capacity;
+		out->chunks[out->used] = chunk;
+	}
+	out->chunks[out->used]->len = 0;
+	out->used++;
+	return out->chunks[out->used - 1];
 }
 
 /*
- * len_pids
+ * out_printf
  * description:
- *     counts the number of elements in the pids list.
- *     this is calculated by searching the list until -1 is found.
+ *     appends formatted text to the output buffer, see flush_report.
  * parameters:
- *     pids: list of pids to calculate length of.
- * pre-conditions:
- *     pids is initialized.
- *     pids is terminated by a -1 element.
- * returns:
- *     the length of pids.
+ *     format: printf format string.
+ *     ...: the values for format.
  */
-int len_pids(int *pids)
+void out_printf(const char *format, ...)
 {
-	if (pids == NULL)
-		return 0;
-	int len = 0;
+	va_list args;
+	struct out_chunk *chunk = out_reserve(OUT_LINE_SIZE);
 
-	while (pids[len] != -1)
-		len++;
-	return len;
+	va_start(args, format);
+	int len = vsnprintf(chunk->data + chunk->len, chunk->capacity - chunk->len, format, args);
+
+	va_end(args);
+	if (len < 0)
+		return;
+	if ((size_t)len >= chunk->capacity - chunk->len) {
+		//did not fit, format again into a chunk large enough
+		chunk = out_reserve(len + 1);
+		va_start(args, format);
+		vsnprintf(chunk->data + chunk->len, len + 1, format, args);
+		va_end(args);
+	}
+	chunk->len += len;
 }
 
 /*
- * terminate_program
+ * out_write
  * description:
- *     terminates this process and all children processes.
- *     It then displays the final status for all children
- *     and the total runtime of the process.
+ *     appends raw bytes to the output buffer, see flush_report.
  * parameters:
- *     pids: list of all children process ids
- *     elapsed_time: the time the program has been running for.
- * pre-conditions:
- *     pids is initalized.
- * post-conditions:
- *     all processes with pid in pids list will be killed.
- *     this program will terminate.
+ *     data: the bytes to append.
+ *     size: the number of bytes.
  */
-void terminate_program(int *pids, double elapsed_time)
+void out_write(const void *data, size_t size)
 {
-	printf("%s", "Terminating, ");
-	display_date();
-	int pid = pids[0];
-	int index = 0;
+	struct out_chunk *chunk = out_reserve(size);
+
+	memcpy(chunk->data + chunk->len, data, size);
+	chunk->len += size;
+}
 
-	while (pid != -1) {
-		//check if process is still active
-		pid_t result = waitpid(pid, NULL, WNOHANG);
+/*
+ * out_json_string
+ * description:
+ *     appends str to the output buffer as a quoted JSON string.
+ * parameters:
+ *     str: the string to append.
+ */
+void out_json_string(const char *str)
+{
+	struct out_chunk *chunk = out_reserve(strlen(str)*6 + 3);
+	char *out = chunk->data + chunk->len;
 
-		if (result == 0) {
-			printf("[%d] %s\n", index, "Terminated");
-			kill(pid, SIGKILL);
+	*out++ = '"';
+	for (const unsigned char *c = (const unsigned char *)str; *c != '\0'; c++) {
+		if (*c == '"' || *c == '\\') {
+			*out++ = '\\';
+			*out++ = *c;
+		} else if (*c < 0x20) {
+			out += sprintf(out, "\\u%04x", *c);
 		} else {
-			printf("[%d] %s\n", index, "Exited");
+			*out++ = *c;
 		}
-		index++;
-		pid = pids[index];
 	}
-	free(pids);
-	printf("Exiting (total time: %d seconds)\n", (int)(elapsed_time/1));
-	exit(0);
+	*out++ = '"';
+	chunk->len = out - chunk->data;
 }
 
 /*
- * check_timer
+ * flush_report
  * description:
- *     checks if the program has run longer than the TARGET_TIME
- *     or if KILL_STATE == 1.
- *     if either of these condtions are true returns 1.
+ *     writes everything in the output buffer to stdout with writev,
+ *     one iovec per chunk, and empties the buffer.
+ *     called once per report so a report costs a single write
+ *     however many processes it covers.
+ */
+void flush_report(void)
+{
+	struct report_buffer *out = &REPORT;
+	struct iovec iov[IOV_MAX];
+	int next = 0;
+
+	fflush(stdout);
+	while (next < out->used && OUTPUT_FD != -1) {
+		int count = 0;
+
+		while (next + count < out->used && count < IOV_MAX) {
+			iov[count].iov_base = out->chunks[next + count]->data;
+			iov[count].iov_len = out->chunks[next + count]->len;
+			count++;
+		}
+		if (OUTPUT_FD == AGGREGATOR_FD && send_aggregator(iov, count) == -1) {
+			warn("lost the aggregator, the reports are discarded");
+			close(AGGREGATOR_FD);
+			AGGREGATOR_FD = -1;
+			OUTPUT_FD = -1;
+		} else if (OUTPUT_FD != AGGREGATOR_FD) {
+			write_all(OUTPUT_FD, iov, count);
+		}
+		next += count;
+	}
+	out->used = 0;
+}
+
+/*
+ * write_all
+ * description:
+ *     writes every byte of iov to fd, retrying after partial writes.
  * parameters:
- *     current_time: the current time. Created by calling time(NULL)
+ *     fd: the file descriptor to write to.
+ *     iov: the buffers to write, modified by this function.
+ *     count: the number of buffers in iov.
  * returns:
- *     1 if program has run for TARGET_TIME or KILL_STATE = 1.
- *     0 otherwise.
+ *     0 if everything was written, -1 on error.
  */
-int check_timer(double current_time)
+int write_all(int fd, struct iovec *iov, int count)
 {
-	if (current_time - START_TIME >= TARGET_TIME && TARGET_TIME != -1)
-		return 1;
-	if (KILL_STATE == 1)
-		return 1;
+	while (count > 0) {
+		ssize_t written = writev(fd, iov, count);
+
+		if (written == -1 && errno == EINTR)
+			continue;
+		if (written == -1)
+			return -1;
+		while (count > 0 && (size_t)written >= iov->iov_len) {
+			written -= iov->iov_len;
+			iov++;
+			count--;
+		}
+		if (count > 0) {
+			iov->iov_base = (char *)iov->iov_base + written;
+			iov->iov_len -= written;
+		}
+	}
 	return 0;
 }
 
 /*
- * display_proc_state
+ * send_aggregator
  * description:
- *     displays the cpu usage and mem usage of a process.
+ *     writes records to the non blocking aggregator socket without ever
+ *     waiting on it, so a slow aggregator cannot hold up the event loop.
+ *     what the socket did not take is kept and sent first next time,
+ *     so records are never cut. while some is still kept, new records
+ *     are dropped, the aggregator only misses those ticks.
  * parameters:
- *     index: the index of the process in the pids array.
- *     cpu: the percentage of time this process has spent on the cpu.
- *     mem: the amount of memory, in MB, used by the process.
+ *     iov: the records to write.
+ *     count: the number of entries in iov.
+ * returns:
+ *     0 if the records were written, kept or dropped.
+ *     -1 if the aggregator is gone.
  */
-void display_proc_state(int index, int cpu, int mem)
+int send_aggregator(struct iovec *iov, int count)
 {
-	char percent = '%';
+	while (AGGREGATOR_BACKLOG_SENT < AGGREGATOR_BACKLOG_LEN) {
+		ssize_t written = write(AGGREGATOR_FD, AGGREGATOR_BACKLOG + AGGREGATOR_BACKLOG_SENT,
+					AGGREGATOR_BACKLOG_LEN - AGGREGATOR_BACKLOG_SENT);
+
+		if (written == -1 && errno == EINTR)
+			continue;
+		if (written == -1 && errno != EAGAIN)
+			return -1;
+		if (written == -1) {
+			if (AGGREGATOR_DROPPED++ == 0)
+				fprintf(stderr, "macD: the aggregator is behind, dropping reports\n");
+			return 0;
+		}
+		AGGREGATOR_BACKLOG_SENT += written;
+	}
+	ssize_t written = writev(AGGREGATOR_FD, iov, count);
+
+	while (written == -1 && errno == EINTR)
+		written = writev(AGGREGATOR_FD, iov, count);
+	if (written == -1 && errno != EAGAIN)
+		return -1;
+	if (written == -1)
+		written = 0;
+	if (AGGREGATOR_DROPPED > 0) {
+		fprintf(stderr, "macD: the aggregator caught up, %d reports dropped\n", AGGREGATOR_DROPPED);
+		AGGREGATOR_DROPPED = 0;
+	}
+	AGGREGATOR_BACKLOG_LEN = 0;
+	AGGREGATOR_BACKLOG_SENT = 0;
+	for (int i = 0; i < count; i++) {
+		size_t len = iov[i].iov_len;
 
-	printf("[%d] Running, cpu usage: %d%c,", index, cpu, percent);
-	printf(" mem usage: %d MB\n", mem);
+		if ((size_t)written >= len) {
+			written -= len;
+			continue;
+		}
+		//keep the rest, starting where the socket stopped
+		AGGREGATOR_BACKLOG = realloc(AGGREGATOR_BACKLOG, AGGREGATOR_BACKLOG_LEN + len - written);
+		if (AGGREGATOR_BACKLOG == NULL)
+			err(1, "aggregator allocation error");
+		memcpy(AGGREGATOR_BACKLOG + AGGREGATOR_BACKLOG_LEN, (char *)iov[i].iov_base + written,
+		       len - written);
+		AGGREGATOR_BACKLOG_LEN += len - written;
+		written = 0;
+	}
+	return 0;
 }
 
 /*
- * periodic_reports
+ * write_record
  * description:
- *     displays the status of all processes every 5 seconds.
+ *     appends a binary record to the output buffer.
+ *     fields that do not apply to the record type are -1.
  * parameters:
- *     pids: list of process ids
- * pre-conditions:
- *     pids is initialized.
- *     pids is terminated by a -1 element.
+ *     type: the RECORD_* type of the record.
+ *     table: the process table, or NULL for records about macD itself.
+ *     slot: the slot the record is about.
+ *     value: for RECORD_REPORT the tick, for RECORD_EXIT the total time.
  */
-void periodic_reports(int *pids)
+void write_record(int type, struct proc_table *table, int slot, int value)
 {
-	int *counters = initialize_cpu_counters(pids, len_pids(pids));
-	int full_cpu_increase = 5*sysconf(_SC_CLK_TCK);
+	struct sample_record record;
 
-	while (1) {
-		int done = 1;
-		int index = 0;
+	memset(&record, 0, sizeof(record));
+	record.timestamp_ns = (uint64_t)(REPORT_TIME*1e9);
+	record.type = type;
+	record.slot = -1;
+	record.pid = -1;
+	record.line_number = -1;
+	record.cpu = -1;
+	record.mem = -1;
+	record.exit_code = -1;
+	record.exit_signal = -1;
+	record.value = value;
+	if (table != NULL) {
+		record.slot = slot;
+		record.pid = table->pid[slot];
+		record.line_number = table->line_number[slot];
+		record.state = table->state[slot];
+		record.restarts = table->restart[slot].restarts;
+		if (table->state[slot] == PROC_RUNNING) {
+			record.cpu = table->cpu[slot];
+			record.mem = table->mem[slot];
+		} else {
+			record.exit_code = table->exit[slot].code;
+			record.exit_signal = table->exit[slot].signal;
+			record.cpu_time_ms = table->exit[slot].cpu_time*1000;
+			record.max_rss = table->exit[slot].max_rss;
+		}
+	}
+	out_write(&record, sizeof(record));
+}
 
-		printf("%s\n", "...");
-		printf("%s", "Normal report, ");
+/*
+ * display_header
+ * description:
+ *     starts a report. in text mode displays the title and the date,
+ *     in json mode writes a report object and in binary mode a
+ *     RECORD_REPORT record.
+ *     the clock snapshot taken here is the timestamp of every record
+ *     of the report and the date displayed.
+ * parameters:
+ *     title: "Starting report", "Normal report" or "Terminating".
+ *     tick: the number of normal reports before this one.
+ */
+void display_header(char *title, int tick)
+{
+	update_clock();
+	REPORT_TIME = NOW.monotonic;
+	if (OUTPUT_FORMAT == OUTPUT_TEXT) {
+		out_printf("%s, ", title);
 		display_date();
-		while (pids[index] != -1) {
-			pid_t result = waitpid(pids[index], NULL, WNOHANG);
-
-			if (result == 0) {
-				int cpu = get_cpu_usage(pids[index]);
-				int cpu_percent = ((cpu - counters[index])*100);
-				int mem = get_mem_usage(pids[index]);
-
-				cpu_percent = cpu_percent/full_cpu_increase;
-				counters[index] = cpu;
-				done = 0;
-				display_proc_state(index, cpu_percent, mem);
-			} else {
-				printf("[%d] Exited\n", index);
-			}
-			index++;
-		}
-		if (done == 1) {
-			double current_time = time(NULL);
-			int total_time = (int)(current_time - START_TIME);
+	} else if (OUTPUT_FORMAT == OUTPUT_JSON) {
+		out_printf("{\"type\":\"report\",\"ts\":%.6f,\"time\":%ld,\"tick\":%d,\"title\":",
+			   REPORT_TIME, (long)NOW.realtime, tick);
+		out_json_string(title);
+		out_printf("}\n");
+	} else {
+		write_record(RECORD_REPORT, NULL, 0, tick);
+	}
+}
 
-			printf("Exiting (total time: %d seconds)\n...\n", total_time);
-			exit(0);
+/*
+ * display_separator
+ * description:
+ *     displays the "..." line around normal reports in text mode.
+ */
+void display_separator(void)
+{
+	if (OUTPUT_FORMAT == OUTPUT_TEXT)
+		out_printf("%s\n", "...");
+}
+
+/*
+ * display_exiting
+ * description:
+ *     displays the total time macD ran for, just before it exits.
+ * parameters:
+ *     total_time: the time macD ran for, in seconds.
+ */
+void display_exiting(int total_time)
+{
+	if (OUTPUT_FORMAT == OUTPUT_TEXT)
+		out_printf("Exiting (total time: %d seconds)\n", total_time);
+	else if (OUTPUT_FORMAT == OUTPUT_JSON)
+		out_printf("{\"type\":\"exit\",\"ts\":%.6f,\"total_time\":%d}\n", REPORT_TIME, total_time);
+	else
+		write_record(RECORD_EXIT, NULL, 0, total_time);
+}
+
+/*
+ * read_file
+ * description:
+ *     reads all lines in the given file.
+ *     creates a process for each line in the file where the line
+ *     indicates what process to create, see launch_lines.
+ *     the process list is owned by the returned table.
+ * parameters:
+ *     file_path: string of the path to the file to read.
+ * pre-conditions:
+ *     file_path is initialized.
+ * returns:
+ *     process table holding a slot for each started process.
+ *     NULL if the file could not be opened.
+ */
+struct proc_table *read_file(char *file_path)
+{
+	struct process_list *list = parse_process_list(file_path);
+
+	if (list == NULL) {
+		fprintf(stderr, "macD: %s not found", file_path);
+		return NULL;
+	}
+	return start_list(list);
+}
+
+/*
+ * start_list
+ * description:
+ *     reads the time limit and launch settings of a process list and
+ *     starts its lines, see launch_lines. with --replay the time limit
+ *     is in virtual seconds.
+ * parameters:
+ *     list: the process list, owned by the returned table.
+ * returns:
+ *     process table holding a slot for each started process.
+ */
+struct proc_table *start_list(struct process_list *list)
+{
+	display_header("Starting report", 0);
+	if (list->len > 0)
+		TARGET_TIME = read_timer(&list->lines[0]);
+	if (TARGET_TIME != -1)
+		TARGET_TIME /= REPLAY_SPEED;
+	int first = read_list_header(list);
+	struct proc_table *table = create_proc_table();
+	double launch_start = get_monotonic_time();
+
+	//kept for restarts and lines that start later
+	table->list = list;
+	for (int i = 0; i < RESUME_LEN; i++) {
+		//no line is left to adopt the process of these entries
+		if (RESUME_ENTRIES[i].line_number >= list->len - first)
+			release_log_pipe(&RESUME_ENTRIES[i]);
+	}
+	launch_lines(table, list, first, NULL);
+	if (LAUNCH_LATENCY == 1 && OUTPUT_FORMAT == OUTPUT_TEXT) {
+		double total = get_monotonic_time() - launch_start;
+
+		out_printf("Launched %d of %d processes in %.1f ms", table->len, list->len - first,
+			   total*1000);
+		if (table->pending > 0)
+			out_printf(", %d not started or not ready yet", table->pending);
+		out_printf("\n");
+		flush_report();
+	}
+	return table;
+}
+
+/*
+ * launch_lines
+ * description:
+ *     queues the lines of list from first on to be started by
+ *     run_launches, ordered by their priority then line number,
+ *     and starts as many as the launch settings allow right away.
+ *     lines of another shard, see shard_owns, are not started and
+ *     count as done for the lines that wait for them.
+ * pre-conditions:
+ *     list is the process list of table.
+ * parameters:
+ *     table: the process table to add the processes to.
+ *     list: the process list.
+ *     first: the first line to start, see read_list_header.
+ *     skip: lines with a non zero entry are not started, or NULL.
+ */
+void launch_lines(struct proc_table *table, struct process_list *list, int first, char *skip)
+{
+	free(table->launch_order);
+	table->launch_order = malloc(sizeof(int)*(list->len + 1));
+	table->starting = realloc(table->starting, sizeof(int)*(list->len + 1));
+	table->launch_len = 0;
+	table->launch_next = 0;
+	for (int i = first; i < list->len; i++) {
+		struct list_line *line = &list->lines[i];
+
+		if (skip != NULL && skip[i] != 0)
+			continue;
+		line->line_number = i - first;
+		line->invalid = read_directives(line) != 0 || line->argc == 0;
+		if (line->invalid == 0 && shard_owns(line) == 0) {
+			line->launch = LAUNCH_DONE; //started by another instance
+			continue;
 		}
-		printf("%s\n", "...");
-		double t = time(NULL);
-		double current_time = t;
+		line->launch = LAUNCH_PENDING;
+		table->launch_order[table->launch_len++] = i;
+		table->pending++;
+	}
+	qsort_r(table->launch_order, table->launch_len, sizeof(int), compare_launch_order, list);
+	LAUNCH_START = get_monotonic_time();
+	run_launches(table);
+}
 
-		while (current_time - t < 5) {
-			current_time = time(NULL);
-			if (check_timer(current_time) == 1)
-				terminate_program(pids, current_time - START_TIME);
+/*
+ * compare_launch_order
+ * description:
+ *     orders line indices by the priority of their line, then by
+ *     their line number, for qsort_r.
+ * parameters:
+ *     a, b: pointers to the indices to compare.
+ *     arg: the process list.
+ * returns:
+ *     a negative number if a starts first, a positive number otherwise.
+ */
+int compare_launch_order(const void *a, const void *b, void *arg)
+{
+	struct process_list *list = arg;
+	int x = *(const int *)a;
+	int y = *(const int *)b;
+
+	if (list->lines[x].priority != list->lines[y].priority)
+		return list->lines[x].priority < list->lines[y].priority ? -1 : 1;
+	return x - y;
+}
+
+/*
+ * run_launches
+ * description:
+ *     starts the queued lines that are allowed to start now, then arms
+ *     the launch timer for when the next one may. a line starts once:
+ *         every line of a lower priority is ready, so tiers start in turn.
+ *         its after= line is ready, or failed, or exited.
+ *         fewer than max_starting processes are starting.
+ *         the spawn_rate allows another spawn.
+ *     processes are started LAUNCH_BATCH at a time without waiting in
+ *     between, then each batch is reported in line order. after= lines
+ *     that wait on each other in a cycle are started anyway, with a warning.
+ * parameters:
+ *     table: the process table.
+ * pre-conditions:
+ *     the table has a process list.
+ */
+void run_launches(struct proc_table *table)
+{
+	double now = NOW.monotonic;
+	int waiting = 0;
+
+	if (SHUTTING_DOWN == 1 || table->pending == 0)
+		return;
+	if (SPAWN_RATE > 0) {
+		LAUNCH_TOKENS += (now - LAST_LAUNCH_TIME)*SPAWN_RATE;
+		if (LAUNCH_TOKENS > 1)
+			LAUNCH_TOKENS = 1;
+	}
+	LAST_LAUNCH_TIME = now;
+	REPORT_TIME = now;
+	NEXT_LAUNCH = 0;
+	while (table->pending > 0 && waiting == 0) {
+		update_starting(table, now);
+		//lines that were done in the last pass may let more start
+		if (start_lines(table, now, &waiting) > 0)
+			continue;
+		if (waiting == 1 || table->starting_len > 0 || table->pending == 0)
+			break;
+		struct list_line *line = &table->list->lines[table->launch_order[table->launch_next]];
+
+		fprintf(stderr, "macD: line %d waits on a cycle of after= lines, starting it\n",
+			line->line_number);
+		line->after = -1;
+	}
+	arm_launch_timer(table, now);
+	flush_report();
+}
+
+/*
+ * start_lines
+ * description:
+ *     one pass of run_launches, starts the pending lines that may
+ *     start now in the order of launch_order.
+ * parameters:
+ *     table: the process table.
+ *     now: the current monotonic time.
+ *     waiting: set to 1 if the spawn rate stopped the pass, the time
+ *              of the next spawn is then in NEXT_LAUNCH.
+ * returns:
+ *     the number of lines started, including lines that failed to start.
+ */
+int start_lines(struct proc_table *table, double now, int *waiting)
+{
+	struct process_list *list = table->list;
+	struct launch *batch = malloc(sizeof(struct launch)*LAUNCH_BATCH);
+	int batch_len = 0;
+	int started = 0;
+	int tier = INT_MAX;
+
+	while (table->launch_next < table->launch_len &&
+	       list->lines[table->launch_order[table->launch_next]].launch != LAUNCH_PENDING)
+		table->launch_next++;
+	for (int i = 0; i < table->starting_len; i++) {
+		if (list->lines[table->starting[i]].priority < tier)
+			tier = list->lines[table->starting[i]].priority;
+	}
+	for (int k = table->launch_next; k < table->launch_len; k++) {
+		int index = table->launch_order[k];
+		struct list_line *line = &list->lines[index];
+
+		if (line->launch != LAUNCH_PENDING)
+			continue;
+		if (line->priority > tier)
+			break;
+		tier = line->priority;
+		if (MAX_STARTING > 0 && table->starting_len + batch_len >= MAX_STARTING)
+			break;
+		if (line->after != -1 && line_ready(list, index - line->line_number + line->after) == 0)
+			continue;
+		if (SPAWN_RATE > 0 && LAUNCH_TOKENS < 1) {
+			*waiting = 1;
+			NEXT_LAUNCH = now + (1 - LAUNCH_TOKENS)/SPAWN_RATE;
+			break;
+		}
+		if (SPAWN_RATE > 0)
+			LAUNCH_TOKENS--;
+		batch[batch_len].line = line;
+		batch[batch_len].line_number = line->line_number;
+		batch[batch_len].pid = -1;
+		batch[batch_len].group = NULL;
+		batch[batch_len].slot = -1;
+		batch[batch_len].resumed = NULL;
+		if (line->invalid == 0 && adopt_launch(&batch[batch_len]) == 0)
+			start_launch(&batch[batch_len]);
+		//not pending while in the batch, so it is not started twice
+		line->launch = LAUNCH_STARTING;
+		batch_len++;
+		started++;
+		if (batch_len == LAUNCH_BATCH) {
+			finish_launches(table, batch, batch_len);
+			batch_len = 0;
 		}
 	}
+	finish_launches(table, batch, batch_len);
+	free(batch);
+	return started;
 }
 
 /*
- * sig_handler
+ * finish_launches
  * description:
- *     called when SIGINT is passed to the process
- *     sets KILL_STATE to 1 which tells the process to terminate
- *     itself and its children.
+ *     reports a batch started by run_launches and moves each of its
+ *     lines on: processes that failed to start, or are ready as soon
+ *     as they exec, are done, others are starting until they are ready.
  * parameters:
- *     sig: the id of the signal passed to the process
+ *     table: the process table.
+ *     batch: the launches started by run_launches.
+ *     batch_len: the number of launches in batch.
  */
-void sig_handler(int sig)
+void finish_launches(struct proc_table *table, struct launch *batch, int batch_len)
 {
-	printf("Signal Received - ");
-	KILL_STATE = 1;
+	if (batch_len == 0)
+		return;
+	report_launch_batch(batch, batch_len, table);
+	//waiting for the execs of the batch can take a while, NOW is taken again once
+	update_clock();
+	for (int i = 0; i < batch_len; i++) {
+		struct list_line *line = batch[i].line;
+
+		if (line->notify_fd != -1)
+			close(line->notify_fd);
+		line->notify_fd = -1;
+		line->slot = batch[i].slot;
+		line->launch_time = NOW.monotonic;
+		//slots started before the event loop are initialized by initialize_cpu_counters
+		if (line->slot != -1 && table->state[line->slot] == PROC_RUNNING &&
+		    (EPOLL_FD != -1 || line->ready == READY_CPU))
+			initialize_slot(table, line->slot);
+		if (line->slot == -1 || line->ready == READY_EXEC || batch[i].resumed != NULL) {
+			line_done(table, line);
+			continue;
+		}
+		line->launch = LAUNCH_STARTING;
+		table->starting[table->starting_len++] = line - table->list->lines;
+		if (line->ready == READY_FD && EPOLL_FD != -1)
+			watch_fd(line->ready_fd, EVENT_READY);
+	}
 }
 
 /*
- * register_handler
+ * update_starting
  * description:
- *     registers this program to react to the SIGINT signal
+ *     checks whether the starting processes have become ready.
+ *     with ready=cpu a process is ready once it has used a cpu tick,
+ *     with ready=fd once it writes to or closes fd READY_NOTIFY_FD.
+ *     a process that exited, or is not ready after READY_TIMEOUT
+ *     seconds, is done starting too.
+ * parameters:
+ *     table: the process table.
+ *     now: the current monotonic time.
  */
-void register_handler(void)
+void update_starting(struct proc_table *table, double now)
+{
+	struct process_list *list = table->list;
+
+	for (int i = 0; i < table->starting_len; i++) {
+		struct list_line *line = &list->lines[table->starting[i]];
+		int slot = line->slot;
+		int ready = table->state[slot] != PROC_RUNNING;
+
+		if (ready == 0 && line->ready == READY_CPU)
+			ready = (table->replay != NULL ? table->cpu[slot] : get_cpu_usage(&table->files[slot])) > 0;
+		if (ready == 0 && line->ready == READY_FD) {
+			char byte;
+
+			ready = read(line->ready_fd, &byte, 1) != -1 || errno != EAGAIN;
+		}
+		if (ready == 0 && now - line->launch_time < READY_TIMEOUT)
+			continue;
+		display_ready(line, ready == 0);
+		if (line->ready_fd != -1 && EPOLL_FD != -1)
+			epoll_ctl(EPOLL_FD, EPOLL_CTL_DEL, line->ready_fd, NULL);
+		table->starting[i--] = table->starting[--table->starting_len];
+		line_done(table, line);
+	}
+}
+
+/*
+ * line_done
+ * description:
+ *     marks a line as done starting. with -l the time it took every
+ *     line to be ready is displayed once the last one is, if that is
+ *     after the event loop started.
+ * parameters:
+ *     table: the process table.
+ *     line: the line that is done.
+ */
+void line_done(struct proc_table *table, struct list_line *line)
+{
+	line->launch = LAUNCH_DONE;
+	table->pending--;
+	//lines all started by read_file are reported by its launch time instead
+	if (table->pending == 0 && LAUNCH_LATENCY == 1 && OUTPUT_FORMAT == OUTPUT_TEXT &&
+	    EPOLL_FD != -1)
+		out_printf("All processes ready in %.1f ms\n",
+			   (get_monotonic_time() - LAUNCH_START)*1000);
+}
+
+/*
+ * line_ready
+ * description:
+ *     checks if the line an after= directive refers to is done.
+ *     a line number past the end of the list counts as done.
+ * parameters:
+ *     list: the process list.
+ *     index: the index of the line in list.
+ * returns:
+ *     1 if the line is done starting or is not started at all.
+ *     0 if it has yet to be ready.
+ */
+int line_ready(struct process_list *list, int index)
+{
+	if (index < 0 || index >= list->len)
+		return 1;
+	return list->lines[index].launch != LAUNCH_PENDING && list->lines[index].launch != LAUNCH_STARTING;
+}
+
+/*
+ * arm_launch_timer
+ * description:
+ *     arms the launch timer for the next time run_launches has work:
+ *     the next spawn the spawn rate allows, the next poll of processes
+ *     waiting for ready=cpu, or the next READY_TIMEOUT.
+ * parameters:
+ *     table: the process table.
+ *     now: the current monotonic time.
+ */
+void arm_launch_timer(struct proc_table *table, double now)
+{
+	struct process_list *list = table->list;
+
+	for (int i = 0; i < table->starting_len; i++) {
+		struct list_line *line = &list->lines[table->starting[i]];
+		double due = line->launch_time + READY_TIMEOUT;
+
+		if (line->ready == READY_CPU && now + READY_POLL < due)
+			due = now + READY_POLL;
+		if (NEXT_LAUNCH == 0 || due < NEXT_LAUNCH)
+			NEXT_LAUNCH = due;
+	}
+	if (LAUNCH_TIMER_FD != -1)
+		set_timer(LAUNCH_TIMER_FD, TFD_TIMER_ABSTIME, NEXT_LAUNCH, 0);
+}
+
+/*
+ * watch_ready_fds
+ * description:
+ *     adds the ready=fd pipes of the processes started before the event
+ *     loop was created to it.
+ * parameters:
+ *     table: the process table.
+ * pre-conditions:
+ *     init_event_loop has been called.
+ */
+void watch_ready_fds(struct proc_table *table)
+{
+	for (int i = 0; i < table->starting_len; i++) {
+		struct list_line *line = &table->list->lines[table->starting[i]];
+
+		if (line->ready == READY_FD)
+			watch_fd(line->ready_fd, EVENT_READY);
+	}
+}
+
+/*
+ * display_ready
+ * description:
+ *     displays that a process with a ready= directive is ready.
+ * parameters:
+ *     line: the line of the process.
+ *     timed_out: 1 if the process was not ready within READY_TIMEOUT.
+ */
+void display_ready(struct list_line *line, int timed_out)
+{
+	double elapsed = NOW.monotonic - line->launch_time;
+
+	if (OUTPUT_FORMAT == OUTPUT_TEXT && timed_out == 1)
+		out_printf("[%d] %s, not ready after %.1fs\n", line->line_number, line->argv[0], elapsed);
+	else if (OUTPUT_FORMAT == OUTPUT_TEXT)
+		out_printf("[%d] %s, ready (%.1f ms)\n", line->line_number, line->argv[0], elapsed*1000);
+	else if (OUTPUT_FORMAT == OUTPUT_JSON)
+		out_printf("{\"type\":\"ready\",\"ts\":%.6f,\"slot\":%d,\"line\":%d,\"ready_ms\":%.3f,"
+			   "\"timed_out\":%s}\n", REPORT_TIME, line->slot, line->line_number,
+			   elapsed*1000, timed_out ? "true" : "false");
+}
+
+/*
+ * start_launch
+ * description:
+ *     creates the process of the line of launch,
+ *     recording how long the spawn took. it reads the clock itself
+ *     instead of NOW, the snapshot is older than the spawn it times.
+ * parameters:
+ *     launch: the launch to start.
+ * pre-conditions:
+ *     launch->line has at least one argument.
+ * post-conditions:
+ *     launch->pid and launch->fd are set as returned by create_process.
+ *     with -g cgroup launch->group is the cgroup of the process.
+ *     with ready=fd the line holds both ends of its readiness pipe.
+ */
+void start_launch(struct launch *launch)
+{
+	double t = get_monotonic_time();
+	int group_fd = -1;
+
+	if (GROUP_MODE == GROUP_CGROUP)
+		launch->group = create_group(launch->line_number, &group_fd);
+	if (launch->line->ready == READY_FD) {
+		int fds[2];
+
+		if (pipe2(fds, O_CLOEXEC | O_NONBLOCK) == -1)
+			err(1, "pipe error");
+		launch->line->ready_fd = fds[0];
+		launch->line->notify_fd = fds[1];
+	}
+	launch->pid = create_process(launch->line, group_fd, &launch->fd);
+	launch->spawn_time = get_monotonic_time() - t;
+	if (group_fd != -1)
+		close(group_fd);
+}
+
+/*
+ * get_monotonic_time
+ * description:
+ *     reads CLOCK_MONOTONIC.
+ * returns:
+ *     the current monotonic time in seconds.
+ */
+double get_monotonic_time(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec/1e9;
+}
+
+/*
+ * report_launch_batch
+ * description:
+ *     waits for the exec of every process in the batch and displays
+ *     whether it started, in line order.
+ *     every started process is given a slot in table along with
+ *     a copy of its line, the slot is stored in its launch.
+ *     a process adopted by adopt_launch has no exec to wait for.
+ * parameters:
+ *     batch: list of launches created by read_file.
+ *     batch_len: the number of launches in batch.
+ *     table: the process table to add the started processes to.
+ * pre-conditions:
+ *     table is initialized.
+ */
+void report_launch_batch(struct launch *batch, int batch_len, struct proc_table *table)
+{
+	for (int i = 0; i < batch_len; i++) {
+		struct list_line *line = batch[i].line;
+		int pid = batch[i].pid;
+
+		if (pid != -1)
+			pid = wait_for_exec(pid, batch[i].fd);
+		if (pid >= 0) {
+			int slot = add_process(table, pid, batch[i].line_number, strdup(line->text));
+
+			batch[i].slot = slot;
+			table->group[slot] = batch[i].group;
+			table->line[slot] = line;
+			if (batch[i].resumed != NULL)
+				resume_slot(table, slot, batch[i].resumed);
+			else
+				display_started(table, slot, line, batch[i].spawn_time);
+		} else {
+			remove_group(batch[i].group);
+			free(batch[i].group);
+			display_failed(batch[i].line_number, line);
+		}
+	}
+	flush_report();
+}
+
+/*
+ * display_started
+ * description:
+ *     displays that the process of line was started, or restarted.
+ * parameters:
+ *     table: the process table.
+ *     slot: the slot the process was given.
+ *     line: the line of the process list the process came from.
+ *     spawn_time: the time, in seconds, the spawn took.
+ */
+void display_started(struct proc_table *table, int slot, struct list_line *line, double spawn_time)
+{
+	int line_number = table->line_number[slot];
+
+	int restarts = table->restart[slot].restarts;
+
+	if (OUTPUT_FORMAT == OUTPUT_TEXT && restarts > 0) {
+		out_printf("[%d] %s, restarted (pid: %d, restarts: %d)\n", line_number, line->argv[0],
+			   table->pid[slot], restarts);
+	} else if (OUTPUT_FORMAT == OUTPUT_TEXT) {
+		out_printf("[%d] %s, started successfully (pid: %d)", line_number, line->argv[0],
+			   table->pid[slot]);
+		if (LAUNCH_LATENCY == 1)
+			out_printf(" (spawn: %.0f us)", spawn_time*1e6);
+		out_printf("\n");
+	} else if (OUTPUT_FORMAT == OUTPUT_JSON) {
+		out_printf("{\"type\":\"started\",\"ts\":%.6f,\"slot\":%d,\"pid\":%d,\"line\":%d,",
+			   REPORT_TIME, slot, table->pid[slot], line_number);
+		out_printf("\"restarts\":%d,\"spawn_us\":%.0f,\"command\":", restarts, spawn_time*1e6);
+		out_json_string(line->text);
+		out_printf("}\n");
+	} else {
+		write_record(RECORD_STARTED, table, slot, spawn_time*1e6);
+	}
+}
+
+/*
+ * display_failed
+ * description:
+ *     displays that the process of line failed to start.
+ * parameters:
+ *     line_number: the line number of the process.
+ *     line: the line of the process list.
+ */
+void display_failed(int line_number, struct list_line *line)
+{
+	char *path = line->argc > 0 ? line->argv[0] : "";
+
+	if (OUTPUT_FORMAT == OUTPUT_TEXT) {
+		out_printf("[%d] badprogram %s, failed to start\n", line_number, path);
+	} else if (OUTPUT_FORMAT == OUTPUT_JSON) {
+		out_printf("{\"type\":\"failed\",\"ts\":%.6f,\"line\":%d,\"command\":",
+			   REPORT_TIME, line_number);
+		out_json_string(line->text);
+		out_printf("}\n");
+	} else {
+		struct sample_record record;
+
+		memset(&record, 0, sizeof(record));
+		record.timestamp_ns = (uint64_t)(REPORT_TIME*1e9);
+		record.type = RECORD_FAILED;
+		record.slot = -1;
+		record.pid = -1;
+		record.line_number = line_number;
+		out_write(&record, sizeof(record));
+	}
+}
+
+/*
+ * create_proc_table
+ * description:
+ *     creates an empty process table with room for MAX_PROCESSES slots.
+ *     with -H the sample history is created with it, see grow_history.
+ * returns:
+ *     the new process table.
+ */
+struct proc_table *create_proc_table(void)
+{
+	struct proc_table *table = calloc(1, sizeof(struct proc_table));
+
+	table->history_fd = -1;
+	grow_proc_table(table, MAX_PROCESSES);
+	return table;
+}
+
+/*
+ * grow_proc_table
+ * description:
+ *     resizes every array of the table to hold capacity slots
+ *     and rebuilds the pid hash so it stays at most half full.
+ * parameters:
+ *     table: the process table to grow.
+ *     capacity: the new number of slots.
+ * pre-conditions:
+ *     capacity >= table->len.
+ */
+void grow_proc_table(struct proc_table *table, int capacity)
+{
+	table->capacity = capacity;
+	table->pid = realloc(table->pid, sizeof(int)*capacity);
+	table->line_number = realloc(table->line_number, sizeof(int)*capacity);
+	table->command = realloc(table->command, sizeof(char *)*capacity);
+	table->last_ticks = realloc(table->last_ticks, sizeof(int)*capacity);
+	table->last_sample = realloc(table->last_sample, sizeof(double)*capacity);
+	table->next_sample = realloc(table->next_sample, sizeof(int)*capacity);
+	table->sample_interval = realloc(table->sample_interval, sizeof(int)*capacity);
+	table->mem_tick = realloc(table->mem_tick, sizeof(int)*capacity);
+	table->group = realloc(table->group, sizeof(char *)*capacity);
+	table->line = realloc(table->line, sizeof(struct list_line *)*capacity);
+	table->restart = realloc(table->restart, sizeof(struct restart_info)*capacity);
+	table->cpu = realloc(table->cpu, sizeof(int)*capacity);
+	table->mem = realloc(table->mem, sizeof(int)*capacity);
+	table->due = realloc(table->due, sizeof(int)*capacity);
+	table->state = realloc(table->state, sizeof(int)*capacity);
+	table->exit = realloc(table->exit, sizeof(struct exit_info)*capacity);
+	table->files = realloc(table->files, sizeof(struct proc_files)*capacity);
+	if (table->pid == NULL || table->line_number == NULL || table->command == NULL ||
+	    table->last_ticks == NULL || table->last_sample == NULL || table->next_sample == NULL ||
+	    table->sample_interval == NULL || table->mem_tick == NULL || table->group == NULL ||
+	    table->line == NULL || table->restart == NULL || table->cpu == NULL || table->mem == NULL ||
+	    table->due == NULL || table->state == NULL || table->exit == NULL ||
+	    table->files == NULL)
+		err(1, "process table allocation error");
+	if (HISTORY_LEN > 0)
+		grow_history(table, capacity);
+	if (table->alert_since != NULL) {
+		table->alert_since = realloc(table->alert_since, sizeof(double)*MAX_ALERTS*capacity);
+		if (table->alert_since == NULL)
+			err(1, "process table allocation error");
+	}
+	if (GROUP_MODE == GROUP_PGID) {
+		table->group_live = realloc(table->group_live, sizeof(int)*capacity);
+		if (table->group_live == NULL)
+			err(1, "process table allocation error");
+	}
+	if (CHECKPOINT_PATH != NULL) {
+		table->start_ticks = realloc(table->start_ticks, sizeof(uint64_t)*capacity);
+		if (table->start_ticks == NULL)
+			err(1, "process table allocation error");
+	}
+	if (REPLAY_TRACES != NULL) {
+		table->replay = realloc(table->replay, sizeof(struct replay_state)*capacity);
+		if (table->replay == NULL)
+			err(1, "process table allocation error");
+	}
+	if (COLLECT_BACKEND == COLLECT_NETLINK) {
+		table->batch_cpu = realloc(table->batch_cpu, sizeof(int)*capacity);
+		table->exiting = realloc(table->exiting, sizeof(int)*capacity);
+		if (table->batch_cpu == NULL || table->exiting == NULL)
+			err(1, "process table allocation error");
+	}
+	int hash_capacity = 16;
+
+	while (hash_capacity < capacity*2)
+		hash_capacity *= 2;
+	if (hash_capacity == table->hash_capacity)
+		return;
+	rebuild_hash(table, hash_capacity);
+}
+
+/*
+ * grow_history
+ * description:
+ *     makes room in the sample history of the table for capacity slots.
+ *     the history is a header followed by one block per slot, each a
+ *     history_slot and its ring of HISTORY_LEN samples, so a slot's
+ *     samples are contiguous and adding slots only appends blocks.
+ *     it is mapped from HISTORY_PATH if set with -M, so the samples
+ *     survive macD crashing, or from anonymous memory otherwise.
+ *     all memory is allocated here, recording a sample never allocates.
+ * parameters:
+ *     table: the process table.
+ *     capacity: the new number of slots.
+ */
+void grow_history(struct proc_table *table, int capacity)
+{
+	size_t block_size = sizeof(struct history_slot) + sizeof(struct history_sample)*HISTORY_LEN;
+	size_t size = sizeof(struct history_header) + block_size*capacity;
+	void *history;
+
+	if (table->history == NULL && HISTORY_PATH != NULL) {
+		table->history_fd = open(HISTORY_PATH, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+		if (table->history_fd == -1)
+			err(1, "could not open %s", HISTORY_PATH);
+	}
+	if (table->history_fd != -1 && ftruncate(table->history_fd, size) == -1)
+		err(1, "could not grow %s", HISTORY_PATH);
+	if (table->history == NULL && table->history_fd != -1)
+		history = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, table->history_fd, 0);
+	else if (table->history == NULL)
+		history = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	else
+		history = mremap(table->history, table->history_size, size, MREMAP_MAYMOVE);
+	if (history == MAP_FAILED)
+		err(1, "sample history allocation error");
+	struct history_header *header = history;
+
+	if (table->history == NULL) {
+		struct timespec now;
+
+		clock_gettime(CLOCK_REALTIME, &now);
+		memcpy(header->magic, HISTORY_MAGIC, sizeof(header->magic));
+		header->version = HISTORY_VERSION;
+		header->length = HISTORY_LEN;
+		header->block_size = block_size;
+		header->realtime_offset = now.tv_sec + now.tv_nsec/1e9 - get_monotonic_time();
+	}
+	header->slots = capacity;
+	table->history = history;
+	table->history_size = size;
+}
+
+/*
+ * get_history
+ * description:
+ *     finds the block of a slot in the sample history.
+ * parameters:
+ *     table: the process table.
+ *     slot: the slot of the process.
+ * pre-conditions:
+ *     the table has a history, HISTORY_LEN > 0.
+ * returns:
+ *     the history_slot of slot, followed by its samples.
+ */
+struct history_slot *get_history(struct proc_table *table, int slot)
+{
+	struct history_header *header = table->history;
+
+	return (struct history_slot *)((char *)table->history + sizeof(struct history_header) +
+				       header->block_size*slot);
+}
+
+/*
+ * record_history
+ * description:
+ *     adds a sample of the process in slot to its ring in the history,
+ *     replacing the oldest once the ring is full. only touches slot, so
+ *     it is safe from the sampler threads.
+ * parameters:
+ *     table: the process table.
+ *     slot: the slot of the process that was just sampled.
+ *     time: the monotonic time of the sample.
+ */
+void record_history(struct proc_table *table, int slot, double time)
+{
+	struct history_slot *history = get_history(table, slot);
+	struct history_sample *sample = &history->samples[history->next];
+
+	sample->time = time;
+	sample->cpu = table->cpu[slot];
+	sample->mem = table->mem[slot];
+	history->next = (history->next + 1) % HISTORY_LEN;
+	if (history->count < (uint32_t)HISTORY_LEN)
+		history->count++;
+}
+
+/*
+ * rebuild_hash
+ * description:
+ *     replaces the pid hash with an empty one of hash_capacity
+ *     positions and adds the current pid of every slot to it.
+ * parameters:
+ *     table: the process table.
+ *     hash_capacity: the number of positions, a power of 2.
+ */
+void rebuild_hash(struct proc_table *table, int hash_capacity)
+{
+	free(table->hash);
+	table->hash = malloc(sizeof(int)*hash_capacity);
+	if (table->hash == NULL)
+		err(1, "process table allocation error");
+	table->hash_capacity = hash_capacity;
+	table->hash_used = 0;
+	for (int i = 0; i < hash_capacity; i++)
+		table->hash[i] = -1;
+	for (int slot = 0; slot < table->len; slot++)
+		hash_insert(table, slot);
+}
+
+/*
+ * add_process
+ * description:
+ *     adds a started process to the next free slot of the table.
+ *     the table doubles in size when it is full.
+ *     slots are never reused or moved, so the slot of a process
+ *     stays its index in every report.
+ * parameters:
+ *     table: the process table to add to.
+ *     pid: the process id of the started process.
+ *     line_number: the line of the process list file it came from.
+ *     command: the line of the file, owned by the table from now on.
+ * pre-conditions:
+ *     table is initialized.
+ * returns:
+ *     the slot of the process.
+ */
+int add_process(struct proc_table *table, int pid, int line_number, char *command)
+{
+	if (table->len == table->capacity)
+		grow_proc_table(table, table->capacity*2);
+	int slot = table->len;
+
+	table->len++;
+	table->pid[slot] = pid;
+	table->line_number[slot] = line_number;
+	table->command[slot] = command;
+	table->last_ticks[slot] = 0;
+	table->last_sample[slot] = 0;
+	table->next_sample[slot] = 0;
+	table->sample_interval[slot] = 0;
+	table->mem_tick[slot] = -1;
+	table->group[slot] = NULL;
+	table->line[slot] = NULL;
+	memset(&table->restart[slot], 0, sizeof(struct restart_info));
+	table->restart[slot].started_at = get_monotonic_time();
+	table->cpu[slot] = 0;
+	table->mem[slot] = 0;
+	table->state[slot] = PROC_RUNNING;
+	memset(&table->exit[slot], 0, sizeof(struct exit_info));
+	table->files[slot].pid = -1;
+	table->files[slot].group = NULL;
+	table->files[slot].cached = 0;
+	table->files[slot].dir_fd = -1;
+	table->files[slot].stat_fd = -1;
+	table->files[slot].mem_fd = -1;
+	if (table->batch_cpu != NULL) {
+		table->batch_cpu[slot] = -1;
+		table->exiting[slot] = 0;
+	}
+	if (table->replay != NULL)
+		start_replay(table, slot);
+	if (table->start_ticks != NULL)
+		table->start_ticks[slot] = 0;
+	if (table->group_live != NULL)
+		table->group_live[slot] = 1;
+	if (ALERTS_USED == 1 && table->alert_since == NULL)
+		table->alert_since = malloc(sizeof(double)*MAX_ALERTS*table->capacity);
+	if (table->alert_since != NULL)
+		reset_alerts(table, slot);
+	if (table->history != NULL) {
+		struct history_slot *history = get_history(table, slot);
+
+		history->pid = pid;
+		history->line_number = line_number;
+		history->count = 0;
+		history->next = 0;
+	}
+	hash_insert(table, slot);
+	return slot;
+}
+
+/*
+ * hash_pid
+ * description:
+ *     computes the position of pid in the pid hash of the table.
+ * parameters:
+ *     table: the process table.
+ *     pid: the process id to hash.
+ * returns:
+ *     the first position of the hash to probe for pid.
+ */
+int hash_pid(struct proc_table *table, int pid)
+{
+	return ((unsigned int)pid * 2654435761u) & (table->hash_capacity - 1);
+}
+
+/*
+ * hash_insert
+ * description:
+ *     adds the pid of slot to the pid hash of the table.
+ * parameters:
+ *     table: the process table.
+ *     slot: the slot to add.
+ * pre-conditions:
+ *     the hash has at least one empty position.
+ */
+void hash_insert(struct proc_table *table, int slot)
+{
+	int mask = table->hash_capacity - 1;
+	int i = hash_pid(table, table->pid[slot]);
+
+	while (table->hash[i] != -1)
+		i = (i + 1) & mask;
+	table->hash[i] = slot;
+	table->hash_used++;
+}
+
+/*
+ * change_pid
+ * description:
+ *     gives slot the pid of its restarted process. the entry of the old
+ *     pid is left in the hash, find_slot skips it as the pid of the slot
+ *     no longer matches, and the hash is rebuilt without such entries
+ *     once it is half full.
+ * parameters:
+ *     table: the process table.
+ *     slot: the slot of the restarted process.
+ *     pid: the process id of the restarted process.
+ */
+void change_pid(struct proc_table *table, int slot, int pid)
+{
+	table->pid[slot] = pid;
+	if (table->history != NULL)
+		get_history(table, slot)->pid = pid;
+	if (table->exiting != NULL)
+		table->exiting[slot] = 0;
+	if (table->replay != NULL)
+		start_replay(table, slot);
+	if (table->start_ticks != NULL)
+		table->start_ticks[slot] = 0;
+	if (table->group_live != NULL)
+		table->group_live[slot] = 1;
+	if ((table->hash_used + 1)*2 > table->hash_capacity)
+		rebuild_hash(table, table->hash_capacity);
+	else
+		hash_insert(table, slot);
+}
+
+/*
+ * find_slot
+ * description:
+ *     finds the slot of the process with the given pid.
+ * parameters:
+ *     table: the process table.
+ *     pid: the process id to find.
+ * returns:
+ *     the slot of pid.
+ *     -1 if pid is not in the table.
+ */
+int find_slot(struct proc_table *table, int pid)
+{
+	int mask = table->hash_capacity - 1;
+	int i = hash_pid(table, pid);
+
+	int found = -1;
+
+	//a slot that exited keeps its pid, which may since belong to another slot
+	while (table->hash[i] != -1) {
+		int slot = table->hash[i];
+
+		if (table->pid[slot] == pid) {
+			if (table->state[slot] == PROC_RUNNING)
+				return slot;
+			if (found == -1)
+				found = slot;
+		}
+		i = (i + 1) & mask;
+	}
+	return found;
+}
+
+/*
+ * free_proc_table
+ * description:
+ *     frees the process table and everything it owns.
+ * parameters:
+ *     table: the process table to free.
+ */
+void free_proc_table(struct proc_table *table)
+{
+	for (int slot = 0; slot < table->len; slot++) {
+		close_proc_files(&table->files[slot]);
+		free(table->command[slot]);
+	}
+	remove_groups(table);
+	free(table->pid);
+	free(table->line_number);
+	free(table->command);
+	free(table->last_ticks);
+	free(table->last_sample);
+	free(table->next_sample);
+	free(table->sample_interval);
+	free(table->mem_tick);
+	free(table->group);
+	free(table->line);
+	free(table->restart);
+	if (table->list != NULL)
+		free_process_list(table->list);
+	while (table->retired != NULL) {
+		struct process_list *next = table->retired->next;
+
+		free_process_list(table->retired);
+		table->retired = next;
+	}
+	free(table->cpu);
+	free(table->mem);
+	free(table->due);
+	free(table->state);
+	free(table->exit);
+	free(table->files);
+	free(table->hash);
+	if (table->history != NULL)
+		munmap(table->history, table->history_size);
+	if (table->history_fd != -1)
+		close(table->history_fd);
+	free(table->launch_order);
+	free(table->starting);
+	free(table->alert_since);
+	free(table->batch_cpu);
+	free(table->exiting);
+	free(table->replay);
+	free(table->start_ticks);
+	free(table->group_live);
+	free(table);
+}
+
+/*
+ * open_proc_files
+ * description:
+ *     opens /proc/[pid] and, relative to it, the stat file and the
+ *     memory file of MEM_METRIC, see get_mem_usage, so they can be read
+ *     again on every report without opening them by path.
+ *     if cache is 0 nothing is opened and the files are opened by
+ *     path each time they are read instead.
+ * parameters:
+ *     files: the proc_files to open.
+ *     pid: the process id to open the files of.
+ *     cache: 1 to keep the files open, 0 otherwise.
+ * post-conditions:
+ *     any file that could not be opened is set to -1.
+ */
+void open_proc_files(struct proc_files *files, int pid, int cache)
+{
+	char path[32];
+
+	files->pid = pid;
+	files->group = NULL;
+	files->cached = cache;
+	files->dir_fd = -1;
+	files->stat_fd = -1;
+	files->mem_fd = -1;
+	if (cache == 0)
+		return;
+	snprintf(path, sizeof(path), "/proc/%d", pid);
+	files->dir_fd = open(path, O_PATH | O_DIRECTORY | O_CLOEXEC);
+	if (files->dir_fd == -1)
+		return;
+	files->stat_fd = openat(files->dir_fd, "stat", O_RDONLY | O_CLOEXEC);
+	files->mem_fd = openat(files->dir_fd, MEM_FILES[MEM_METRIC], O_RDONLY | O_CLOEXEC);
+}
+
+/*
+ * close_proc_files
+ * description:
+ *     closes the files opened by open_proc_files.
+ * parameters:
+ *     files: the proc_files to close.
+ */
+void close_proc_files(struct proc_files *files)
+{
+	if (files->stat_fd != -1)
+		close(files->stat_fd);
+	if (files->mem_fd != -1)
+		close(files->mem_fd);
+	if (files->dir_fd != -1)
+		close(files->dir_fd);
+	files->dir_fd = -1;
+	files->stat_fd = -1;
+	files->mem_fd = -1;
+	files->cached = 0;
+	files->pid = -1;
+	files->group = NULL;
+}
+
+/*
+ * open_group_files
+ * description:
+ *     opens the files of a process started with -g cgroup.
+ *     the process is sampled from its cgroup instead of /proc/[pid]:
+ *     the cpu of the whole tree from cpu.stat and, if the memory
+ *     controller is enabled, its memory from memory.current.
+ *     otherwise the memory is that of the process alone.
+ * parameters:
+ *     files: the proc_files to open.
+ *     pid: the process id of the process.
+ *     group: the path of the cgroup of the process.
+ *     cache: 1 to keep the files open, 0 otherwise.
+ */
+void open_group_files(struct proc_files *files, int pid, char *group, int cache)
+{
+	char path[PATH_MAX];
+
+	open_proc_files(files, pid, cache);
+	files->group = group;
+	if (cache == 0)
+		return;
+	if (files->stat_fd != -1)
+		close(files->stat_fd);
+	snprintf(path, sizeof(path), "%s/cpu.stat", group);
+	files->stat_fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (CGROUP_MEMORY == 0)
+		return;
+	if (files->mem_fd != -1)
+		close(files->mem_fd);
+	snprintf(path, sizeof(path), "%s/memory.current", group);
+	files->mem_fd = open(path, O_RDONLY | O_CLOEXEC);
+}
+
+/*
+ * read_proc_file
+ * description:
+ *     reads the whole of a /proc file of the process from the beginning
+ *     in a single pread.
+ *     if the files are not cached the file is opened by path,
+ *     read and closed again. the system calls are counted for -O.
+ * parameters:
+ *     files: the /proc files of the process.
+ *     fd: the open file, one of the fds of files.
+ *     name: the name of the file in /proc/[pid], or an absolute path.
+ *     buffer: where the contents are stored, NUL terminated.
+ *     size: the size of buffer.
+ * returns:
+ *     the number of bytes read.
+ *     -1 if the file could not be read, meaning the process is gone.
+ */
+int read_proc_file(struct proc_files *files, int fd, char *name, char *buffer, int size)
+{
+	int opened = 0;
+
+	if (fd == -1 && files->cached == 0 && files->pid > 0) {
+		char path[PATH_MAX];
+
+		if (name[0] == '/')
+			snprintf(path, sizeof(path), "%s", name);
+		else
+			snprintf(path, sizeof(path), "/proc/%d/%s", files->pid, name);
+		fd = open(path, O_RDONLY | O_CLOEXEC);
+		opened = 1;
+		count_proc_io(fd == -1 ? 1 : 2, 1);
+	}
+	if (fd == -1)
+		return -1;
+	ssize_t len = pread(fd, buffer, size - 1, 0);
+
+	count_proc_io(1, 0);
+
+	if (opened == 1)
+		close(fd);
+	if (len <= 0)
+		return -1;
+	buffer[len] = '\0';
+	return len;
+}
+
+/*
+ * count_proc_io
+ * description:
+ *     adds to the number of system calls and opens made to sample
+ *     processes, displayed by display_overhead. safe to call from
+ *     the sampler threads.
+ * parameters:
+ *     syscalls: the number of system calls made.
+ *     opens: how many of them opened a file.
+ */
+void count_proc_io(int syscalls, int opens)
+{
+	__atomic_add_fetch(&SAMPLER_SYSCALLS, syscalls, __ATOMIC_RELAXED);
+	if (opens > 0)
+		__atomic_add_fetch(&SAMPLER_OPENS, opens, __ATOMIC_RELAXED);
+}
+
+/*
+ * get_cpu_usage
+ * description:
+ *     computes the total amount of time the process has spent
+ *     on the cpu, measured in clock ticks by
+ *     reading /proc/[pid]/stat to find the user time and kernal time.
+ *     the fields are counted from the last ')' so a process name
+ *     containing spaces or brackets is skipped correctly.
+ * parameters:
+ *     files: the open /proc files of the process.
+ * returns:
+ *     the number of ticks the process has been on the cpu for
+ *     or -1 if no such process exists.
+ */
+int get_cpu_usage(struct proc_files *files)
+{
+	char buffer[PROC_BUFFER_SIZE];
+
+	if (files->group != NULL)
+		return get_group_cpu_usage(files);
+	if (read_proc_file(files, files->stat_fd, "stat", buffer, sizeof(buffer)) == -1)
+		return -1;
+	char *scan = strrchr(buffer, ')');
+
+	if (scan == NULL)
+		return -1;
+	//the user time is the 14th field, the 12th after the name (field 2).
+	scan++;
+	for (int i = 0; i < 11; i++) {
+		scan = strchr(scan + 1, ' ');
+		if (scan == NULL)
+			return -1; //file not long enough
+	}
+	char *end;
+	long user_time = strtol(scan, &end, 10);
+	long kernal_time = strtol(end, NULL, 10);
+
+	return user_time + kernal_time;
+}
+
+/*
+ * get_group_cpu_usage
+ * description:
+ *     computes the total amount of time every process in the cgroup
+ *     of files has spent on the cpu, from usage_usec in cpu.stat.
+ *     includes processes of the group that already exited.
+ * parameters:
+ *     files: the open files of the process, see open_group_files.
+ * returns:
+ *     the cpu time in clock ticks, like get_cpu_usage.
+ *     -1 if the cgroup could not be read.
+ */
+int get_group_cpu_usage(struct proc_files *files)
+{
+	char buffer[PROC_BUFFER_SIZE];
+	char path[PATH_MAX];
+
+	snprintf(path, sizeof(path), "%s/cpu.stat", files->group);
+	if (read_proc_file(files, files->stat_fd, path, buffer, sizeof(buffer)) == -1)
+		return -1;
+	if (strncmp(buffer, "usage_usec ", 11) != 0)
+		return -1;
+	return strtoll(buffer + 11, NULL, 10)*CLOCK_TICKS/1000000;
+}
+
+/*
+ * parse_collector
+ * description:
+ *     converts the name of a collector given with -C
+ *     to its COLLECT_* value.
+ * parameters:
+ *     name: "proc" or "netlink".
+ * returns:
+ *     the COLLECT_* value of name.
+ *     -1 if name is not a collector.
+ */
+int parse_collector(char *name)
+{
+	if (strcmp(name, "proc") == 0)
+		return COLLECT_PROC;
+	if (strcmp(name, "netlink") == 0)
+		return COLLECT_NETLINK;
+	return -1;
+}
+
+/*
+ * init_netlink_collector
+ * description:
+ *     sets up -C netlink: a generic netlink socket to query the
+ *     taskstats of many processes with a few system calls, and a
+ *     connector socket the kernel sends process events to, see
+ *     handle_proc_events. both need CAP_NET_ADMIN.
+ *     the taskstats of macD itself are queried once to check they
+ *     can be read. if they cannot, /proc is used instead.
+ * returns:
+ *     0 on success.
+ *     -1 if the netlink sockets could not be set up.
+ */
+int init_netlink_collector(void)
+{
+	int pid = getpid();
+	int ticks;
+	int size = TASKSTATS_BATCH*TASKSTATS_REPLY_SIZE*4;
+
+	TASKSTATS_FD = socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC, NETLINK_GENERIC);
+	if (TASKSTATS_FD != -1)
+		TASKSTATS_FAMILY = get_taskstats_family(TASKSTATS_FD);
+	if (TASKSTATS_FAMILY == -1 || query_taskstats(&pid, &ticks, 1) != 1) {
+		warn("netlink taskstats unavailable, sampling from /proc");
+		if (TASKSTATS_FD != -1)
+			close(TASKSTATS_FD);
+		TASKSTATS_FD = -1;
+		return -1;
+	}
+	//the replies of a whole batch are queued before they are read
+	if (setsockopt(TASKSTATS_FD, SOL_SOCKET, SO_RCVBUFFORCE, &size, sizeof(size)) == -1)
+		setsockopt(TASKSTATS_FD, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+	if (open_proc_events() == -1)
+		warn("netlink process events unavailable");
+	return 0;
+}
+
+/*
+ * put_attr
+ * description:
+ *     appends a netlink attribute to a message being built.
+ * parameters:
+ *     attr: where the attribute is written.
+ *     type: the type of the attribute.
+ *     data: the payload of the attribute.
+ *     len: the length of data.
+ * returns:
+ *     the number of bytes written, padding included.
+ */
+int put_attr(struct nlattr *attr, int type, void *data, int len)
+{
+	attr->nla_type = type;
+	attr->nla_len = NLA_HDRLEN + len;
+	memcpy((char *)attr + NLA_HDRLEN, data, len);
+	return NLA_ALIGN(attr->nla_len);
+}
+
+/*
+ * find_attr
+ * description:
+ *     finds an attribute in a list of netlink attributes.
+ * parameters:
+ *     attr: the first attribute.
+ *     len: the length of the list in bytes.
+ *     type: the type of the attribute to find.
+ * returns:
+ *     the attribute, its payload follows NLA_HDRLEN bytes after it.
+ *     NULL if there is no such attribute.
+ */
+struct nlattr *find_attr(struct nlattr *attr, int len, int type)
+{
+	while (len >= NLA_HDRLEN && attr->nla_len >= NLA_HDRLEN && attr->nla_len <= len) {
+		if ((attr->nla_type & NLA_TYPE_MASK) == type)
+			return attr;
+		len -= NLA_ALIGN(attr->nla_len);
+		attr = (struct nlattr *)((char *)attr + NLA_ALIGN(attr->nla_len));
+	}
+	return NULL;
+}
+
+/*
+ * get_taskstats_family
+ * description:
+ *     asks the generic netlink controller for the id of the
+ *     taskstats family, which is assigned when the kernel boots.
+ * parameters:
+ *     fd: a NETLINK_GENERIC socket.
+ * returns:
+ *     the family id.
+ *     -1 if the kernel has no taskstats.
+ */
+int get_taskstats_family(int fd)
+{
+	char request[NLMSG_SPACE(GENL_HDRLEN + NLA_HDRLEN + 16)] __attribute__((aligned(NLMSG_ALIGNTO)));
+	char reply[TASKSTATS_REPLY_SIZE] __attribute__((aligned(NLMSG_ALIGNTO)));
+	struct nlmsghdr *msg = (struct nlmsghdr *)request;
+	struct genlmsghdr *genl = NLMSG_DATA(msg);
+	int len = GENL_HDRLEN;
+
+	memset(request, 0, sizeof(request));
+	len += put_attr((struct nlattr *)((char *)genl + GENL_HDRLEN), CTRL_ATTR_FAMILY_NAME,
+			TASKSTATS_GENL_NAME, strlen(TASKSTATS_GENL_NAME) + 1);
+	msg->nlmsg_len = NLMSG_LENGTH(len);
+	msg->nlmsg_type = GENL_ID_CTRL;
+	msg->nlmsg_flags = NLM_F_REQUEST;
+	genl->cmd = CTRL_CMD_GETFAMILY;
+	genl->version = 1;
+	if (send(fd, request, msg->nlmsg_len, 0) == -1)
+		return -1;
+	ssize_t received = recv(fd, reply, sizeof(reply), 0);
+
+	msg = (struct nlmsghdr *)reply;
+	if (received <= 0 || !NLMSG_OK(msg, received) || msg->nlmsg_type == NLMSG_ERROR)
+		return -1;
+	struct nlattr *attr = find_attr((struct nlattr *)((char *)NLMSG_DATA(msg) + GENL_HDRLEN),
+					msg->nlmsg_len - NLMSG_LENGTH(GENL_HDRLEN), CTRL_ATTR_FAMILY_ID);
+
+	if (attr == NULL)
+		return -1;
+	return *(uint16_t *)((char *)attr + NLA_HDRLEN);
+}
+
+/*
+ * query_taskstats
+ * description:
+ *     reads the cpu time of up to TASKSTATS_BATCH processes from
+ *     taskstats in two system calls: every request is packed into one
+ *     message sent with a single send, the kernel answers them all
+ *     before send returns, and the answers are read with one recvmmsg.
+ *     the answers are matched by sequence number, so an answer that
+ *     was dropped or left over from an earlier batch is never used.
+ *     the system calls are counted for -O.
+ * parameters:
+ *     pids: the process ids to query, as thread group ids.
+ *     ticks: set to the cpu time of each process in clock ticks,
+ *            like get_cpu_usage, or -1 if it could not be read.
+ *     count: the length of pids and ticks, at most TASKSTATS_BATCH.
+ * returns:
+ *     the number of processes whose cpu time was read.
+ *     errno is set to the error of the last process that was not.
+ */
+int query_taskstats(int *pids, int *ticks, int count)
+{
+	static char requests[TASKSTATS_BATCH][NLMSG_SPACE(GENL_HDRLEN + NLA_HDRLEN + 4)]
+		__attribute__((aligned(NLMSG_ALIGNTO)));
+	static char replies[TASKSTATS_BATCH][TASKSTATS_REPLY_SIZE] __attribute__((aligned(NLMSG_ALIGNTO)));
+	struct mmsghdr messages[TASKSTATS_BATCH];
+	struct iovec iov[TASKSTATS_BATCH];
+	unsigned int seq = TASKSTATS_SEQ;
+	int found = 0;
+
+	TASKSTATS_SEQ += count;
+	for (int i = 0; i < count; i++) {
+		struct nlmsghdr *msg = (struct nlmsghdr *)requests[i];
+		struct genlmsghdr *genl = NLMSG_DATA(msg);
+		uint32_t tgid = pids[i];
+
+		memset(msg, 0, sizeof(requests[i]));
+		msg->nlmsg_len = NLMSG_LENGTH(GENL_HDRLEN +
+			put_attr((struct nlattr *)((char *)genl + GENL_HDRLEN), TASKSTATS_CMD_ATTR_TGID,
+				 &tgid, sizeof(tgid)));
+		msg->nlmsg_type = TASKSTATS_FAMILY;
+		msg->nlmsg_flags = NLM_F_REQUEST;
+		msg->nlmsg_seq = seq + i;
+		genl->cmd = TASKSTATS_CMD_GET;
+		genl->version = TASKSTATS_GENL_VERSION;
+		ticks[i] = -1;
+	}
+	count_proc_io(1, 0);
+	if (send(TASKSTATS_FD, requests, sizeof(requests[0])*count, 0) == -1)
+		return 0;
+	memset(messages, 0, sizeof(messages));
+	for (int i = 0; i < count; i++) {
+		iov[i].iov_base = replies[i];
+		iov[i].iov_len = sizeof(replies[i]);
+		messages[i].msg_hdr.msg_iov = &iov[i];
+		messages[i].msg_hdr.msg_iovlen = 1;
+	}
+	int received = 0;
+
+	while (received < count) {
+		int n = recvmmsg(TASKSTATS_FD, messages + received, count - received, MSG_DONTWAIT, NULL);
+
+		count_proc_io(1, 0);
+		if (n == -1 && errno == ENOBUFS)
+			continue; //some answers were dropped, the rest are still queued
+		if (n <= 0)
+			break;
+		received += n;
+	}
+	for (int i = 0; i < received; i++) {
+		struct nlmsghdr *msg = (struct nlmsghdr *)replies[i];
+		unsigned int index = msg->nlmsg_seq - seq;
+
+		if (!NLMSG_OK(msg, messages[i].msg_len) || index >= (unsigned int)count)
+			continue;
+		if (msg->nlmsg_type == NLMSG_ERROR) {
+			errno = -((struct nlmsgerr *)NLMSG_DATA(msg))->error;
+			continue;
+		}
+		struct nlattr *aggr = find_attr((struct nlattr *)((char *)NLMSG_DATA(msg) + GENL_HDRLEN),
+						msg->nlmsg_len - NLMSG_LENGTH(GENL_HDRLEN),
+						TASKSTATS_TYPE_AGGR_TGID);
+
+		if (aggr == NULL)
+			continue;
+		struct nlattr *attr = find_attr((struct nlattr *)((char *)aggr + NLA_HDRLEN),
+						aggr->nla_len - NLA_HDRLEN, TASKSTATS_TYPE_STATS);
+
+		if (attr == NULL)
+			continue;
+		struct taskstats stats;
+		int len = attr->nla_len - NLA_HDRLEN;
+
+		memset(&stats, 0, sizeof(stats));
+		memcpy(&stats, (char *)attr + NLA_HDRLEN, len < (int)sizeof(stats) ? len : (int)sizeof(stats));
+		ticks[index] = (stats.ac_utime + stats.ac_stime)*CLOCK_TICKS/1000000;
+		found++;
+	}
+	return found;
+}
+
+/*
+ * collect_taskstats
+ * description:
+ *     collects the cpu time of every process in slots from taskstats,
+ *     TASKSTATS_BATCH processes per query, for sample_process to use
+ *     instead of reading /proc/[pid]/stat. processes in a cgroup are
+ *     skipped, their cpu is that of the whole cgroup. taskstats has
+ *     no current memory usage, so the memory is still read from /proc.
+ * parameters:
+ *     table: the process table.
+ *     slots: the slots about to be sampled.
+ *     num_slots: the length of slots.
+ * post-conditions:
+ *     the batch_cpu of every slot in slots is its cpu time in clock
+ *     ticks, or -1 if it was not collected.
+ */
+void collect_taskstats(struct proc_table *table, int *slots, int num_slots)
+{
+	int pids[TASKSTATS_BATCH];
+	int ticks[TASKSTATS_BATCH];
+	int batch[TASKSTATS_BATCH];
+	int count = 0;
+
+	for (int i = 0; i < num_slots; i++) {
+		int slot = slots[i];
+
+		table->batch_cpu[slot] = -1;
+		if (table->files[slot].group == NULL) {
+			batch[count] = slot;
+			pids[count] = table->pid[slot];
+			count++;
+		}
+		if (count == 0 || (count < TASKSTATS_BATCH && i < num_slots - 1))
+			continue;
+		query_taskstats(pids, ticks, count);
+		for (int j = 0; j < count; j++)
+			table->batch_cpu[batch[j]] = ticks[j];
+		count = 0;
+	}
+}
+
+/*
+ * open_proc_events
+ * description:
+ *     subscribes to the process events of the netlink connector:
+ *     the kernel then sends every fork, exec and exit in the system
+ *     to PROC_EVENTS_FD, see handle_proc_events.
+ * returns:
+ *     0 on success.
+ *     -1 if the events could not be subscribed to.
+ */
+int open_proc_events(void)
+{
+	char request[NLMSG_SPACE(sizeof(struct cn_msg) + sizeof(enum proc_cn_mcast_op))]
+		__attribute__((aligned(NLMSG_ALIGNTO)));
+	struct sockaddr_nl addr;
+	struct nlmsghdr *msg = (struct nlmsghdr *)request;
+	struct cn_msg *cn = NLMSG_DATA(msg);
+	enum proc_cn_mcast_op op = PROC_CN_MCAST_LISTEN;
+
+	PROC_EVENTS_FD = socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK, NETLINK_CONNECTOR);
+	if (PROC_EVENTS_FD == -1)
+		return -1;
+	memset(&addr, 0, sizeof(addr));
+	addr.nl_family = AF_NETLINK;
+	addr.nl_groups = CN_IDX_PROC;
+	memset(request, 0, sizeof(request));
+	msg->nlmsg_len = NLMSG_LENGTH(sizeof(struct cn_msg) + sizeof(op));
+	msg->nlmsg_type = NLMSG_DONE;
+	cn->id.idx = CN_IDX_PROC;
+	cn->id.val = CN_VAL_PROC;
+	cn->len = sizeof(op);
+	memcpy(cn->data, &op, sizeof(op));
+	if (bind(PROC_EVENTS_FD, (struct sockaddr *)&addr, sizeof(addr)) == -1 ||
+	    send(PROC_EVENTS_FD, request, msg->nlmsg_len, 0) == -1) {
+		close(PROC_EVENTS_FD);
+		PROC_EVENTS_FD = -1;
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * close_proc_events
+ * description:
+ *     stops receiving process events, once macD is shutting down
+ *     they are no longer needed.
+ */
+void close_proc_events(void)
+{
+	if (PROC_EVENTS_FD == -1)
+		return;
+	close(PROC_EVENTS_FD);
+	PROC_EVENTS_FD = -1;
+}
+
+/*
+ * handle_proc_events
+ * description:
+ *     reads every pending process event and keeps those of processes
+ *     in the table:
+ *         exit: the process is no longer sampled until it is reaped,
+ *         which SIGCHLD still does once it is a zombie.
+ *         fork and exec: with -a the process is no longer stable and
+ *         is sampled on its next report.
+ *     the events of every other process in the system are skipped
+ *     with a lookup in the pid hash.
+ * parameters:
+ *     table: the process table.
+ */
+void handle_proc_events(struct proc_table *table)
+{
+	char buffer[4096] __attribute__((aligned(NLMSG_ALIGNTO)));
+	ssize_t len;
+
+	while ((len = recv(PROC_EVENTS_FD, buffer, sizeof(buffer), 0)) != 0) {
+		if (len == -1 && errno == ENOBUFS)
+			continue; //events were lost, the next ones are still useful
+		if (len == -1)
+			return;
+		for (struct nlmsghdr *msg = (struct nlmsghdr *)buffer; NLMSG_OK(msg, len);
+		     msg = NLMSG_NEXT(msg, len)) {
+			struct cn_msg *cn = NLMSG_DATA(msg);
+			struct proc_event *event = (struct proc_event *)cn->data;
+			int slot = -1;
+
+			if (event->what == PROC_EVENT_EXIT &&
+			    event->event_data.exit.process_pid == event->event_data.exit.process_tgid)
+				slot = find_slot(table, event->event_data.exit.process_tgid);
+			if (slot != -1 && table->state[slot] == PROC_RUNNING)
+				table->exiting[slot] = 1;
+			if (event->what == PROC_EVENT_FORK)
+				slot = find_slot(table, event->event_data.fork.parent_tgid);
+			else if (event->what == PROC_EVENT_EXEC)
+				slot = find_slot(table, event->event_data.exec.process_tgid);
+			else
+				continue;
+			if (slot != -1 && ADAPTIVE_MAX_SKIP > 0) {
+				table->sample_interval[slot] = 0;
+				table->next_sample[slot] = 0;
+			}
+		}
+	}
+}
+
+/*
+ * get_mem_usage
+ * description:
+ *     computes the memory used by the process, as selected with -m:
+ *     MEM_RSS: the resident set, field 2 of /proc/[pid]/statm in pages.
+ *     MEM_PSS: the proportional set from /proc/[pid]/smaps_rollup,
+ *              shared pages are divided between the processes sharing them.
+ *     MEM_USS: the pages only this process uses, the private clean and
+ *              private dirty lines of smaps_rollup.
+ *     MEM_HWM: the peak resident set, VmHWM in /proc/[pid]/status.
+ *     each is parsed from a single read of its file.
+ *     with -g cgroup and the memory controller enabled it is
+ *     memory.current of the cgroup instead, whatever the metric.
+ * parameters:
+ *     files: the open /proc files of the process.
+ * returns:
+ *     the memory usage, in MB, of the given process
+ *     or -1 if no such process exists.
+ */
+int get_mem_usage(struct proc_files *files)
+{
+	char buffer[MEM_BUFFER_SIZE];
+	long kb;
+
+	if (files->group != NULL && CGROUP_MEMORY == 1) {
+		char path[PATH_MAX];
+
+		snprintf(path, sizeof(path), "%s/memory.current", files->group);
+		if (read_proc_file(files, files->mem_fd, path, buffer, sizeof(buffer)) == -1)
+			return -1;
+		return strtoll(buffer, NULL, 10)/(1024*1024);
+	}
+	int len = read_proc_file(files, files->mem_fd, MEM_FILES[MEM_METRIC], buffer, sizeof(buffer));
+
+	if (len == -1 && files->dir_fd != -1 && (MEM_METRIC == MEM_PSS || MEM_METRIC == MEM_USS)) {
+		//smaps_rollup keeps the memory it was opened on, which is gone if the process exec'd since
+		if (files->mem_fd != -1)
+			close(files->mem_fd);
+		files->mem_fd = openat(files->dir_fd, MEM_FILES[MEM_METRIC], O_RDONLY | O_CLOEXEC);
+		count_proc_io(2, 1);
+		len = read_proc_file(files, files->mem_fd, MEM_FILES[MEM_METRIC], buffer, sizeof(buffer));
+	}
+	if (len == -1)
+		return -1;
+	if (MEM_METRIC == MEM_RSS) {
+		char *end;
+
+		strtol(buffer, &end, 10); //size
+		kb = strtol(end, NULL, 10)*(PAGE_SIZE/1024);
+	} else if (MEM_METRIC == MEM_PSS) {
+		kb = find_kb_field(buffer, "Pss:");
+	} else if (MEM_METRIC == MEM_USS) {
+		kb = find_kb_field(buffer, "Private_Clean:") + find_kb_field(buffer, "Private_Dirty:");
+	} else {
+		kb = find_kb_field(buffer, "VmHWM:");
+	}
+	return kb/1024;
+}
+
+/*
+ * find_kb_field
+ * description:
+ *     finds a line of the form "name value kB" as used by
+ *     /proc/[pid]/status and smaps_rollup.
+ * parameters:
+ *     buffer: the contents of the file.
+ *     name: the name at the start of the line, including the ':'.
+ * returns:
+ *     the value of the line, in KB. 0 if there is no such line.
+ */
+long find_kb_field(char *buffer, char *name)
+{
+	int len = strlen(name);
+
+	for (char *line = buffer; line != NULL && *line != '\0'; line = strchr(line, '\n')) {
+		if (*line == '\n')
+			line++;
+		if (strncmp(line, name, len) == 0)
+			return strtol(line + len, NULL, 10);
+	}
+	return 0;
+}
+
+/*
+ * parse_mem_metric
+ * description:
+ *     converts the name of a memory metric given with -m
+ *     to its MEM_* value.
+ * parameters:
+ *     name: "rss", "pss", "uss" or "hwm".
+ * returns:
+ *     the MEM_* value of name.
+ *     -1 if name is not a memory metric.
+ */
+int parse_mem_metric(char *name)
+{
+	for (int metric = MEM_RSS; metric <= MEM_HWM; metric++) {
+		if (strcmp(name, MEM_NAMES[metric]) == 0)
+			return metric;
+	}
+	return -1;
+}
+
+/*
+ * initialize_cpu_counters
+ * description:
+ *     opens the /proc files of every process in the table and
+ *     stores the cpu usage of each process as the usage from the
+ *     previous reporting cycle.
+ *     only the first CACHED_SLOTS slots keep their files open,
+ *     see init_fd_budget.
+ * parameters:
+ *     table: the process table.
+ * pre-conditions:
+ *     table is initialized.
+ */
+void initialize_cpu_counters(struct proc_table *table)
+{
+	for (int slot = 0; slot < table->len; slot++) {
+		if (table->state[slot] == PROC_RUNNING)
+			initialize_slot(table, slot);
+	}
+}
+
+/*
+ * initialize_slot
+ * description:
+ *     opens the /proc files of the process in slot and stores its
+ *     current cpu usage as the usage from the previous sample.
+ *     files it already had open are closed first. a virtual process
+ *     of --replay has no files, its trace starts now.
+ * parameters:
+ *     table: the process table.
+ *     slot: the slot of a running process.
+ */
+void initialize_slot(struct proc_table *table, int slot)
+{
+	close_proc_files(&table->files[slot]);
+	if (table->replay != NULL) {
+		table->last_ticks[slot] = 0;
+		table->last_sample[slot] = get_virtual_time();
+		return;
+	}
+	if (table->group[slot] != NULL)
+		open_group_files(&table->files[slot], table->pid[slot], table->group[slot],
+				 slot < CACHED_SLOTS);
+	else
+		open_proc_files(&table->files[slot], table->pid[slot], slot < CACHED_SLOTS);
+	//get initial cpu usage
+	table->last_ticks[slot] = get_cpu_usage(&table->files[slot]);
+	if (table->last_ticks[slot] < 0)
+		table->last_ticks[slot] = 0;
+	table->last_sample[slot] = get_monotonic_time();
+}
+
+/*
+ * init_fd_budget
+ * description:
+ *     raises the soft limit on open files to the hard limit and
+ *     sets CACHED_SLOTS to the number of slots whose /proc files
+ *     can stay open while leaving FD_RESERVE fds for everything else.
+ *     processes in the remaining slots open their files on each read.
+ */
+void init_fd_budget(void)
+{
+	struct rlimit limit;
+
+	if (getrlimit(RLIMIT_NOFILE, &limit) == -1) {
+		CACHED_SLOTS = 0;
+		return;
+	}
+	if (limit.rlim_cur < limit.rlim_max) {
+		limit.rlim_cur = limit.rlim_max;
+		if (setrlimit(RLIMIT_NOFILE, &limit) == -1)
+			getrlimit(RLIMIT_NOFILE, &limit);
+	}
+	long budget = (long)limit.rlim_cur;
+
+	if (limit.rlim_cur == RLIM_INFINITY || budget > INT_MAX)
+		budget = INT_MAX;
+	budget = (budget - FD_RESERVE - LAUNCH_BATCH)/FDS_PER_SLOT;
+	if (budget < 0)
+		budget = 0;
+	CACHED_SLOTS = budget;
+}
+
+/*
+ * terminate_program
+ * description:
+ *     terminates this process and all children processes.
+ *     It then displays the final status for all children,
+ *     once they are reaped, the summary of their history with -H
+ *     and the total runtime of the process.
+ * parameters:
+ *     table: the process table of all children.
+ *     elapsed_time: the time the program has been running for.
+ * pre-conditions:
+ *     table is initalized.
+ * post-conditions:
+ *     all processes in the table will be killed.
+ *     this program will terminate.
+ */
+void terminate_program(struct proc_table *table, double elapsed_time)
+{
+	display_header("Terminating", -1);
+	shutdown_children(table);
+	for (int slot = 0; slot < table->len; slot++)
+		display_exit_info(table, slot);
+	display_history(table);
+	free_proc_table(table);
+	display_exiting((int)(elapsed_time/1));
+	flush_report();
+	exit(0);
+}
+
+/*
+ * shutdown_children
+ * description:
+ *     stops every process in the table that is still running.
+ *     SIGTERM is sent to all of them at once, then they are reaped as
+ *     they exit until GRACE_PERIOD seconds have passed or a second
+ *     SIGINT arrives. whatever is still running then is sent SIGKILL
+ *     and reaped, so shutdown takes about GRACE_PERIOD however many
+ *     processes there are. with a GRACE_PERIOD of 0 SIGKILL is sent
+ *     right away.
+ *     with -g the groups of processes that already exited are
+ *     signalled too. pending restarts are cancelled and the control
+ *     socket is closed. the logs are drained once every process exited.
+ * parameters:
+ *     table: the process table of all children.
+ * pre-conditions:
+ *     table is initalized.
+ *     init_event_loop has been called.
+ * post-conditions:
+ *     every process in the table has been reaped, the exit info of
+ *     processes stopped here records how they were stopped.
+ */
+void shutdown_children(struct proc_table *table)
+{
+	SHUTTING_DOWN = 1;
+	close_control();
+	close_proc_events();
+	reap_children(table);
+	int running = 0;
+
+	for (int slot = 0; slot < table->len; slot++) {
+		if (table->state[slot] == PROC_RESTARTING)
+			table->state[slot] = PROC_EXITED;
+		if (table->state[slot] == PROC_RUNNING)
+			running++;
+	}
+	if (GRACE_PERIOD > 0) {
+		for (int slot = 0; slot < table->len; slot++) {
+			if (table->state[slot] == PROC_RUNNING)
+				table->exit[slot].stopped = STOPPED_TERM;
+			if (table->state[slot] == PROC_RUNNING || GROUP_MODE != GROUP_NONE)
+				signal_process(table, slot, SIGTERM);
+		}
+		int timer = create_timer(CLOCK_MONOTONIC, 0, GRACE_PERIOD, 0);
+		int event = EVENT_NONE;
+
+		watch_fd(timer, EVENT_GRACE);
+		while (running > 0 && event != EVENT_GRACE && event != EVENT_SIGNAL) {
+			event = wait_for_event();
+			if (event == EVENT_CHILD)
+				running -= reap_children(table);
+		}
+		close(timer);
+	}
+	for (int slot = 0; slot < table->len; slot++) {
+		if (table->state[slot] == PROC_RUNNING)
+			table->exit[slot].stopped = STOPPED_KILL;
+		//what the process started may have outlived it
+		if (table->state[slot] == PROC_RUNNING || GROUP_MODE != GROUP_NONE)
+			signal_process(table, slot, SIGKILL);
+	}
+	while (running > 0) {
+		if (wait_for_event() == EVENT_CHILD)
+			running -= reap_children(table);
+	}
+	flush_logs();
+}
+
+/*
+ * signal_process
+ * description:
+ *     sends sig to the process in slot and, with -g, to its whole group.
+ *     with -g pgid the process group is signalled with killpg, as long
+ *     as it has members, see group_alive.
+ *     with -g cgroup SIGKILL is sent with cgroup.kill, which also
+ *     catches processes forked while it runs, other signals are sent
+ *     to every process listed in cgroup.procs.
+ * parameters:
+ *     table: the process table.
+ *     slot: the slot of the process.
+ *     sig: the signal to send.
+ */
+void signal_process(struct proc_table *table, int slot, int sig)
+{
+	if (table->replay != NULL) {
+		replay_signal(table, slot, sig);
+		return;
+	}
+	if (GROUP_MODE == GROUP_PGID) {
+		//an adopted process that was started in another group does not lead one
+		if (group_alive(table, slot) == 1 && killpg(table->pid[slot], sig) == -1 &&
+		    errno == ESRCH && table->state[slot] == PROC_RUNNING)
+			kill(table->pid[slot], sig);
+		return;
+	}
+	if (table->state[slot] == PROC_RUNNING)
+		kill(table->pid[slot], sig);
+	char *group = table->group[slot];
+
+	if (group == NULL)
+		return;
+	if (sig == SIGKILL && write_group_file(group, "cgroup.kill", "1") == 0)
+		return;
+	char path[PATH_MAX];
+
+	snprintf(path, sizeof(path), "%s/cgroup.procs", group);
+	FILE *procs = fopen(path, "re");
+
+	if (procs == NULL)
+		return;
+	int pid;
+
+	while (fscanf(procs, "%d", &pid) == 1)
+		kill(pid, sig);
+	fclose(procs);
+}
+
+/*
+ * group_alive
+ * description:
+ *     with -g pgid, checks whether the process group of slot may still
+ *     have members. once the leader is reaped its pid, the id of the
+ *     group, is free again, so the group is only signalled until it is
+ *     found empty once. after that the id may belong to another group.
+ * parameters:
+ *     table: the process table.
+ *     slot: the slot of the group leader.
+ * returns:
+ *     1 if the group may be signalled.
+ *     0 if it is gone.
+ */
+int group_alive(struct proc_table *table, int slot)
+{
+	if (table->state[slot] == PROC_RUNNING)
+		return 1;
+	if (table->group_live[slot] == 1 && killpg(table->pid[slot], 0) == -1 && errno == ESRCH)
+		table->group_live[slot] = 0;
+	return table->group_live[slot];
+}
+
+/*
+ * parse_group_mode
+ * description:
+ *     converts the name of a group mode given with -g
+ *     to its GROUP_* value.
+ * parameters:
+ *     name: "pgid" or "cgroup".
+ * returns:
+ *     the GROUP_* value of name.
+ *     -1 if name is not a group mode.
+ */
+int parse_group_mode(char *name)
+{
+	if (strcmp(name, "pgid") == 0)
+		return GROUP_PGID;
+	if (strcmp(name, "cgroup") == 0)
+		return GROUP_CGROUP;
+	return -1;
+}
+
+/*
+ * init_groups
+ * description:
+ *     creates the cgroup the cgroups of every line are created in,
+ *     [cgroup2 mount]/[cgroup of macD]/macD.[pid], and enables the
+ *     memory controller for them if the parent cgroup allows it.
+ *     if no cgroup can be created macD falls back to process groups.
+ * pre-conditions:
+ *     GROUP_MODE is GROUP_CGROUP.
+ * post-conditions:
+ *     GROUP_ROOT is set and CGROUP_MEMORY is 1 if memory.current
+ *     can be read for each line, or GROUP_MODE is GROUP_PGID.
+ */
+void init_groups(void)
+{
+	char mount[PATH_MAX];
+	char own[PATH_MAX];
+	char line[PATH_MAX*2];
+	char path[PATH_MAX*2 + 32];
+	FILE *fptr = fopen("/proc/self/mountinfo", "re");
+
+	mount[0] = '\0';
+	while (fptr != NULL && fgets(line, sizeof(line), fptr) != NULL) {
+		char *fstype = strstr(line, " - cgroup2 ");
+
+		//the mount point is the 5th field
+		if (fstype != NULL && sscanf(line, "%*s %*s %*s %*s %4095s", mount) == 1)
+			break;
+		mount[0] = '\0';
+	}
+	if (fptr != NULL)
+		fclose(fptr);
+	own[0] = '\0';
+	fptr = fopen("/proc/self/cgroup", "re");
+	while (fptr != NULL && fgets(line, sizeof(line), fptr) != NULL) {
+		if (strncmp(line, "0::", 3) != 0)
+			continue;
+		size_t len = strcspn(line + 3, "\n");
+
+		if (len >= sizeof(own) || line[3 + len] != '\n') {
+			//creating the group under a truncated path would put it under another parent
+			fprintf(stderr, "macD: the cgroup path of macD is too long\n");
+			mount[0] = '\0';
+			break;
+		}
+		memcpy(own, line + 3, len);
+		own[len] = '\0';
+	}
+	if (fptr != NULL)
+		fclose(fptr);
+	if (mount[0] != '\0') {
+		snprintf(path, sizeof(path), "%s%s/macD.%d", mount,
+			 strcmp(own, "/") == 0 ? "" : own, getpid());
+		//upgrade_supervisor keeps the pid, and so the groups of the adopted processes
+		if (mkdir(path, 0755) == 0 || (errno == EEXIST && RESUME_EXEC == 1))
+			GROUP_ROOT = strdup(path);
+	}
+	if (GROUP_ROOT == NULL) {
+		fprintf(stderr, "macD: could not create a cgroup, using process groups\n");
+		GROUP_MODE = GROUP_PGID;
+		return;
+	}
+	write_group_file(GROUP_ROOT, "cgroup.subtree_control", "+memory");
+	snprintf(path, sizeof(path), "%s/memory.current", GROUP_ROOT);
+	CGROUP_MEMORY = access(path, R_OK) == 0;
+}
+
+/*
+ * create_group
+ * description:
+ *     creates the cgroup of a line of the process list and opens its
+ *     cgroup.procs, so the process can join it before its exec.
+ * parameters:
+ *     line_number: the line of the process list.
+ *     out_fd: set to the open cgroup.procs, or -1 on error.
+ * pre-conditions:
+ *     init_groups has been called.
+ * returns:
+ *     the path of the new cgroup, or NULL if it could not be created.
+ */
+char *create_group(int line_number, int *out_fd)
+{
+	char path[PATH_MAX];
+
+	*out_fd = -1;
+	snprintf(path, sizeof(path), "%s/%d", GROUP_ROOT, line_number);
+	if (mkdir(path, 0755) == -1 && errno != EEXIST)
+		return NULL;
+	char *group = strdup(path);
+
+	*out_fd = open_group_procs(group);
+	return group;
+}
+
+/*
+ * open_group_procs
+ * description:
+ *     opens cgroup.procs of a cgroup for a process to join it,
+ *     see join_group.
+ * parameters:
+ *     group: the path of the cgroup.
+ * returns:
+ *     the open file, or -1 on error.
+ */
+int open_group_procs(char *group)
+{
+	char path[PATH_MAX];
+
+	snprintf(path, sizeof(path), "%s/cgroup.procs", group);
+	return open(path, O_WRONLY | O_CLOEXEC);
+}
+
+/*
+ * join_group
+ * description:
+ *     called in a new process before its exec to move it into its
+ *     group: a process group of its own with -g pgid, the cgroup
+ *     of group_fd with -g cgroup.
+ *     only makes system calls, so it is safe after vfork.
+ * parameters:
+ *     group_fd: the cgroup.procs file of the cgroup, or -1.
+ */
+void join_group(int group_fd)
+{
+	if (GROUP_MODE == GROUP_PGID)
+		setpgid(0, 0);
+	if (group_fd != -1 && write(group_fd, "0", 1) == -1)
+		_exit(1);
+}
+
+/*
+ * write_group_file
+ * description:
+ *     writes value to a file of a cgroup.
+ * parameters:
+ *     group: the path of the cgroup.
+ *     name: the name of the file in the cgroup.
+ *     value: the string to write.
+ * returns:
+ *     0 on success, -1 otherwise.
+ */
+int write_group_file(char *group, char *name, char *value)
+{
+	char path[PATH_MAX];
+
+	snprintf(path, sizeof(path), "%s/%s", group, name);
+	int fd = open(path, O_WRONLY | O_CLOEXEC);
+
+	if (fd == -1)
+		return -1;
+	int result = write(fd, value, strlen(value)) == -1 ? -1 : 0;
+
+	close(fd);
+	return result;
+}
+
+/*
+ * remove_group
+ * description:
+ *     removes a cgroup created by create_group. a cgroup can only be
+ *     removed once the last process in it is gone, which takes a
+ *     moment after cgroup.kill, so an occupied cgroup is retried
+ *     until GROUP_REMOVE_TRIES are used up.
+ * parameters:
+ *     group: the path of the cgroup, may be NULL.
+ */
+void remove_group(char *group)
+{
+	if (group == NULL)
+		return;
+	while (rmdir(group) == -1 && errno == EBUSY && GROUP_REMOVE_TRIES > 0) {
+		GROUP_REMOVE_TRIES--;
+		usleep(1000);
+	}
+}
+
+/*
+ * remove_groups
+ * description:
+ *     removes the cgroups of every slot of the table and frees their
+ *     paths, then removes GROUP_ROOT once it is empty.
+ * parameters:
+ *     table: the process table.
+ */
+void remove_groups(struct proc_table *table)
+{
+	for (int slot = 0; slot < table->len; slot++) {
+		remove_group(table->group[slot]);
+		free(table->group[slot]);
+		table->group[slot] = NULL;
+	}
+	if (GROUP_ROOT != NULL && rmdir(GROUP_ROOT) == 0) {
+		free(GROUP_ROOT);
+		GROUP_ROOT = NULL;
+	}
+}
+
+/*
+ * check_timer
+ * description:
+ *     checks if the program has run longer than the TARGET_TIME
+ *     or if KILL_STATE == 1.
+ *     if either of these condtions are true returns 1.
+ * parameters:
+ *     current_time: the current real time, from the clock snapshot.
+ * returns:
+ *     1 if program has run for TARGET_TIME or KILL_STATE = 1.
+ *     0 otherwise.
+ */
+int check_timer(double current_time)
+{
+	if (current_time - START_TIME >= TARGET_TIME && TARGET_TIME != -1)
+		return 1;
+	if (KILL_STATE == 1)
+		return 1;
+	return 0;
+}
+
+/*
+ * display_proc_state
+ * description:
+ *     displays the cpu usage and mem usage of a process
+ *     from its last sample, and its effective cpus if its line
+ *     has a cpus directive.
+ * parameters:
+ *     table: the process table.
+ *     slot: the slot of the process in the process table.
+ */
+void display_proc_state(struct proc_table *table, int slot)
+{
+	char percent = '%';
+
+	int restarts = table->restart[slot].restarts;
+
+	if (OUTPUT_FORMAT == OUTPUT_TEXT) {
+		out_printf("[%d] Running, cpu usage: %d%c,", slot, table->cpu[slot], percent);
+		out_printf(" mem usage: %d MB", table->mem[slot]);
+		if (table->line[slot] != NULL && table->line[slot]->cpus != NULL)
+			out_printf(", cpus: %s", get_affinity(table->pid[slot]));
+		if (restarts > 0)
+			out_printf(" (restarts: %d)", restarts);
+		out_printf("\n");
+	} else if (OUTPUT_FORMAT == OUTPUT_JSON) {
+		out_printf("{\"type\":\"sample\",\"ts\":%.6f,\"slot\":%d,\"pid\":%d,\"line\":%d,"
+			   "\"state\":\"running\",\"cpu\":%d,\"mem_mb\":%d,\"restarts\":%d",
+			   REPORT_TIME, slot, table->pid[slot], table->line_number[slot],
+			   table->cpu[slot], table->mem[slot], restarts);
+		if (table->line[slot] != NULL && table->line[slot]->cpus != NULL)
+			out_printf(",\"cpus\":\"%s\"", get_affinity(table->pid[slot]));
+		out_printf("}\n");
+	} else {
+		write_record(RECORD_SAMPLE, table, slot, 0);
+	}
+}
+
+/*
+ * get_affinity
+ * description:
+ *     reads the cpus a process is allowed to run on, which may differ
+ *     from its cpus directive if it or the system changed it since.
+ * parameters:
+ *     pid: the process id.
+ * returns:
+ *     the effective cpu list of the process, valid until the next call.
+ *     "?" if it could not be read.
+ */
+char *get_affinity(int pid)
+{
+	static char buffer[256];
+	cpu_set_t set;
+
+	if (sched_getaffinity(pid, sizeof(set), &set) == -1)
+		return "?";
+	format_id_list(&set, buffer, sizeof(buffer));
+	return buffer;
+}
+
+/*
+ * sample_process
+ * description:
+ *     reads the cpu and memory usage of the process in slot and
+ *     computes its cpu usage since the last time it was sampled,
+ *     from the cpu ticks used over the monotonic time elapsed.
+ *     with -a the memory is only read when the cpu ticks changed.
+ *     with -C netlink the cpu ticks collected by collect_taskstats are
+ *     used if there are any, /proc otherwise. with --replay the sample
+ *     comes from the trace of the process instead, see replay_sample.
+ *     the results are stored in the cpu and mem arrays of the table,
+ *     and with -H in the history of the slot. only touches slot, so
+ *     different slots can be sampled at the same time by different
+ *     threads.
+ * parameters:
+ *     table: the process table.
+ *     slot: the slot of the process to sample.
+ */
+void sample_process(struct proc_table *table, int slot)
+{
+	if (table->replay != NULL) {
+		replay_sample(table, slot);
+		return;
+	}
+	int cpu = -1;
+
+	if (table->batch_cpu != NULL) {
+		cpu = table->batch_cpu[slot];
+		table->batch_cpu[slot] = -1;
+	}
+	if (cpu == -1)
+		cpu = get_cpu_usage(&table->files[slot]);
+	double now = NOW.monotonic;
+	double elapsed = now - table->last_sample[slot];
+	int stable = cpu == table->last_ticks[slot];
+
+	//a process that did not run since the last sample cannot have changed its memory
+	if ((ADAPTIVE_MAX_SKIP == 0 || !stable || table->sample_interval[slot] == 0) &&
+	    mem_sample_due(table, slot)) {
+		int mem = get_mem_usage(&table->files[slot]);
+
+		stable = stable && mem == table->mem[slot];
+		table->mem[slot] = mem;
+		table->mem_tick[slot] = table->tick;
+	} else {
+		__atomic_add_fetch(&SAVED_READS, 1, __ATOMIC_RELAXED);
+	}
+	if (cpu < 0 || elapsed <= 0)
+		return;
+	//scale by the time that really passed, reports can run late or early
+	table->cpu[slot] = (cpu - table->last_ticks[slot])*100/(elapsed*CLOCK_TICKS);
+	table->last_ticks[slot] = cpu;
+	table->last_sample[slot] = now;
+	if (table->history != NULL)
+		record_history(table, slot, now);
+	if (ADAPTIVE_MAX_SKIP > 0)
+		schedule_sample(table, slot, stable);
+}
+
+/*
+ * mem_sample_due
+ * description:
+ *     checks if the memory of the process in slot should be read
+ *     this tick. statm and status are cheap and read on every sample,
+ *     smaps_rollup walks every mapping of the process so with -m pss
+ *     or uss it is read only every SMAPS_INTERVAL reports.
+ * parameters:
+ *     table: the process table.
+ *     slot: the slot of the process being sampled.
+ * returns:
+ *     1 if the memory should be read, 0 to keep the last value.
+ */
+int mem_sample_due(struct proc_table *table, int slot)
+{
+	if (MEM_METRIC != MEM_PSS && MEM_METRIC != MEM_USS)
+		return 1;
+	if (table->group[slot] != NULL && CGROUP_MEMORY == 1)
+		return 1;
+	if (table->mem_tick[slot] == -1)
+		return 1;
+	return table->tick - table->mem_tick[slot] >= SMAPS_INTERVAL*SAMPLE_STRIPES;
+}
+
+/*
+ * schedule_sample
+ * description:
+ *     picks the tick the process in slot is next sampled at with -a.
+ *     every sample in a row that finds the process stable, using no
+ *     cpu and the same memory, doubles the number of ticks until its
+ *     next sample, up to ADAPTIVE_MAX_SKIP. any change brings it back
+ *     to every tick.
+ * parameters:
+ *     table: the process table.
+ *     slot: the slot of the process that was just sampled.
+ *     stable: 1 if the process did not change since its last sample.
+ */
+void schedule_sample(struct proc_table *table, int slot, int stable)
+{
+	int interval = 1;
+
+	if (stable && table->sample_interval[slot] > 0)
+		interval = table->sample_interval[slot]*2;
+	if (interval > ADAPTIVE_MAX_SKIP)
+		interval = ADAPTIVE_MAX_SKIP;
+	table->sample_interval[slot] = interval;
+	table->next_sample[slot] = table->tick + interval*SAMPLE_STRIPES;
+}
+
+/*
+ * sample_slots
+ * description:
+ *     samples every slot in slots, using the sampler pool if
+ *     one was created with -t. with -C netlink the cpu of every
+ *     slot is first collected in batches by collect_taskstats.
+ * parameters:
+ *     table: the process table.
+ *     slots: list of the slots to sample.
+ *     num_slots: the length of slots.
+ * post-conditions:
+ *     every slot in slots has been sampled.
+ */
+void sample_slots(struct proc_table *table, int *slots, int num_slots)
+{
+	if (TASKSTATS_FD != -1 && table->batch_cpu != NULL)
+		collect_taskstats(table, slots, num_slots);
+	if (SAMPLER_POOL != NULL && num_slots >= SAMPLER_POOL->threads) {
+		run_sampler_pool(SAMPLER_POOL, table, slots, num_slots);
+		return;
+	}
+	for (int i = 0; i < num_slots; i++)
+		sample_process(table, slots[i]);
+}
+
+/*
+ * create_sampler_pool
+ * description:
+ *     starts threads - 1 sampler threads, the thread calling
+ *     run_sampler_pool does the share of the last one.
+ * parameters:
+ *     threads: the number of threads to sample with.
+ * pre-conditions:
+ *     threads > 1.
+ *     register_handler has been called, so the sampler threads
+ *     are created with SIGINT and SIGCHLD blocked.
+ * returns:
+ *     the new sampler pool.
+ */
+struct sampler_pool *create_sampler_pool(int threads)
+{
+	struct sampler_pool *pool = calloc(1, sizeof(struct sampler_pool));
+
+	pool->threads = threads;
+	pool->workers = malloc(sizeof(struct sampler_worker)*threads);
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->work_ready, NULL);
+	pthread_cond_init(&pool->work_done, NULL);
+	for (int i = 0; i < threads; i++) {
+		pool->workers[i].pool = pool;
+		pool->workers[i].index = i;
+	}
+	for (int i = 1; i < threads; i++) {
+		if (pthread_create(&pool->workers[i].thread, NULL, sampler_thread,
+				   &pool->workers[i]) != 0)
+			err(1, "pthread_create error");
+	}
+	return pool;
+}
+
+/*
+ * sampler_thread
+ * description:
+ *     the body of a sampler thread. waits for run_sampler_pool to
+ *     hand out work, samples its chunk and signals when it is done.
+ * parameters:
+ *     arg: the sampler_worker of this thread.
+ * returns:
+ *     never returns.
+ */
+void *sampler_thread(void *arg)
+{
+	struct sampler_worker *worker = arg;
+	struct sampler_pool *pool = worker->pool;
+	int generation = 0;
+
+	while (1) {
+		pthread_mutex_lock(&pool->lock);
+		while (pool->generation == generation)
+			pthread_cond_wait(&pool->work_ready, &pool->lock);
+		generation = pool->generation;
+		pthread_mutex_unlock(&pool->lock);
+		sample_chunk(pool, worker->index);
+		pthread_mutex_lock(&pool->lock);
+		pool->remaining--;
+		if (pool->remaining == 0)
+			pthread_cond_signal(&pool->work_done);
+		pthread_mutex_unlock(&pool->lock);
+	}
+	return NULL;
+}
+
+/*
+ * sample_chunk
+ * description:
+ *     samples the index-th of pool->threads equal chunks of the
+ *     slots handed to the pool. chunks never overlap, so no locks
+ *     are needed while sampling.
+ * parameters:
+ *     pool: the sampler pool.
+ *     index: the index of the chunk to sample.
+ */
+void sample_chunk(struct sampler_pool *pool, int index)
+{
+	int start = (long)pool->num_slots*index/pool->threads;
+	int end = (long)pool->num_slots*(index + 1)/pool->threads;
+
+	for (int i = start; i < end; i++)
+		sample_process(pool->table, pool->slots[i]);
+}
+
+/*
+ * run_sampler_pool
+ * description:
+ *     splits slots into one chunk per thread, samples them in parallel
+ *     and waits until every chunk has been sampled, so the caller sees
+ *     one consistent set of samples.
+ * parameters:
+ *     pool: the sampler pool.
+ *     table: the process table.
+ *     slots: list of the slots to sample.
+ *     num_slots: the length of slots.
+ */
+void run_sampler_pool(struct sampler_pool *pool, struct proc_table *table, int *slots,
+		      int num_slots)
+{
+	pthread_mutex_lock(&pool->lock);
+	pool->table = table;
+	pool->slots = slots;
+	pool->num_slots = num_slots;
+	pool->remaining = pool->threads - 1;
+	pool->generation++;
+	pthread_cond_broadcast(&pool->work_ready);
+	pthread_mutex_unlock(&pool->lock);
+	sample_chunk(pool, 0);
+	pthread_mutex_lock(&pool->lock);
+	while (pool->remaining > 0)
+		pthread_cond_wait(&pool->work_done, &pool->lock);
+	pthread_mutex_unlock(&pool->lock);
+}
+
+/*
+ * display_report
+ * description:
+ *     samples and displays the processes of the table that are
+ *     reported this tick. normally that is every process, with -S
+ *     the table is split into SAMPLE_STRIPES stripes and only the
+ *     slots with slot % SAMPLE_STRIPES == tick % SAMPLE_STRIPES are
+ *     sampled, followed by a count of all processes.
+ *     with -a running processes that are not due, see schedule_sample,
+ *     are displayed with their last sample.
+ *     all processes are sampled before any is displayed.
+ * parameters:
+ *     table: the process table.
+ *     tick: the number of reports displayed before this one.
+ * returns:
+ *     the number of processes still running or waiting to restart.
+ */
+int display_report(struct proc_table *table, int tick)
+{
+	int running = 0;
+	int sampled = 0;
+	int stripe = tick % SAMPLE_STRIPES;
+
+	table->tick = tick;
+	int restarting = 0;
+
+	for (int slot = 0; slot < table->len; slot++) {
+		if (table->state[slot] == PROC_RESTARTING)
+			restarting++;
+		if (table->state[slot] != PROC_RUNNING)
+			continue;
+		running++;
+		if (slot % SAMPLE_STRIPES != stripe)
+			continue;
+		if (table->exiting != NULL && table->exiting[slot] == 1)
+			continue; //exited and not yet reaped, its /proc files are going away
+		if (ADAPTIVE_MAX_SKIP > 0 && table->next_sample[slot] > tick) {
+			SAVED_READS += 2; //neither stat nor statm
+			continue;
+		}
+		table->due[sampled] = slot;
+		sampled++;
+	}
+	sample_slots(table, table->due, sampled);
+	if (table->alert_since != NULL)
+		check_alerts(table, table->due, sampled);
+	for (int slot = stripe; slot < table->len; slot += SAMPLE_STRIPES) {
+		if (table->state[slot] == PROC_RUNNING)
+			display_proc_state(table, slot);
+		else
+			display_exit_info(table, slot);
+	}
+	if (SAMPLE_STRIPES > 1 || ADAPTIVE_MAX_SKIP > 0)
+		display_summary(running, table->len - running, sampled);
+	return running + restarting;
+}
+
+/*
+ * check_alerts
+ * description:
+ *     checks the alert rules of every process just sampled against its
+ *     new sample, and acts on the rules that fired. a rule fires when
+ *     its threshold has been crossed for at least its duration, then
+ *     waits until the threshold is no longer crossed before it can fire
+ *     again.
+ * parameters:
+ *     table: the process table.
+ *     slots: the slots sampled.
+ *     num_slots: the length of slots.
+ */
+void check_alerts(struct proc_table *table, int *slots, int num_slots)
+{
+	for (int i = 0; i < num_slots; i++) {
+		int slot = slots[i];
+		struct list_line *line = table->line[slot];
+
+		if (line == NULL || line->removed == 1 || line->num_alerts == 0 ||
+		    table->state[slot] != PROC_RUNNING)
+			continue;
+		double *since = &table->alert_since[slot*MAX_ALERTS];
+
+		for (int r = 0; r < line->num_alerts; r++) {
+			struct alert_rule *rule = &line->alerts[r];
+			int value = rule->metric == ALERT_CPU ? table->cpu[slot] : table->mem[slot];
+			int crossed = (rule->op == ALERT_GT && value > rule->threshold) ||
+				      (rule->op == ALERT_GE && value >= rule->threshold) ||
+				      (rule->op == ALERT_LT && value < rule->threshold) ||
+				      (rule->op == ALERT_LE && value <= rule->threshold);
+
+			if (value < 0)
+				continue;
+			if (crossed == 0) {
+				since[r] = 0;
+				continue;
+			}
+			if (since[r] < 0)
+				continue; //already fired
+			if (since[r] == 0)
+				since[r] = table->last_sample[slot];
+			if (table->last_sample[slot] - since[r] < rule->duration)
+				continue;
+			since[r] = -1;
+			fire_alert(table, slot, rule, value);
+		}
+	}
+}
+
+/*
+ * fire_alert
+ * description:
+ *     displays that an alert rule fired and takes its action.
+ * parameters:
+ *     table: the process table.
+ *     slot: the slot of the process.
+ *     rule: the rule that fired.
+ *     value: the sample that crossed the threshold.
+ */
+void fire_alert(struct proc_table *table, int slot, struct alert_rule *rule, int value)
+{
+	char *units[] = {"%", " MB"};
+	char action[16];
+
+	if (rule->action == ALERT_SIGNAL)
+		snprintf(action, sizeof(action), "SIG%s", sigabbrev_np(rule->sig));
+	else
+		snprintf(action, sizeof(action), "%s", rule->action == ALERT_RESTART ? "restart" : "log");
+	if (OUTPUT_FORMAT == OUTPUT_TEXT) {
+		out_printf("[%d] Alert \"%s\" (%d%s), %s\n", slot, rule->text, value,
+			   units[rule->metric], action);
+	} else if (OUTPUT_FORMAT == OUTPUT_JSON) {
+		out_printf("{\"type\":\"alert\",\"ts\":%.6f,\"slot\":%d,\"pid\":%d,\"rule\":",
+			   REPORT_TIME, slot, table->pid[slot]);
+		out_json_string(rule->text);
+		out_printf(",\"value\":%d,\"action\":\"%s\"}\n", value, action);
+	} else {
+		write_record(RECORD_ALERT, table, slot, rule->action == ALERT_SIGNAL ? rule->sig :
+			     rule->action == ALERT_RESTART ? -1 : 0);
+	}
+	if (rule->action == ALERT_RESTART) {
+		table->restart[slot].forced = 1;
+		table->exit[slot].stopped = STOPPED_TERM;
+		signal_process(table, slot, SIGTERM);
+	} else if (rule->action == ALERT_SIGNAL) {
+		if (rule->sig == SIGTERM)
+			table->exit[slot].stopped = STOPPED_TERM;
+		if (rule->sig == SIGKILL)
+			table->exit[slot].stopped = STOPPED_KILL;
+		signal_process(table, slot, rule->sig);
+	}
+}
+
+/*
+ * reset_alerts
+ * description:
+ *     clears the alert state of slot, for a new or restarted process.
+ * parameters:
+ *     table: the process table.
+ *     slot: the slot to clear.
+ */
+void reset_alerts(struct proc_table *table, int slot)
+{
+	for (int r = 0; r < MAX_ALERTS; r++)
+		table->alert_since[slot*MAX_ALERTS + r] = 0;
+}
+
+/*
+ * display_summary
+ * description:
+ *     displays the count of all processes after a report with -S,
+ *     and with -a the total number of /proc reads adaptive sampling saved.
+ * parameters:
+ *     running: the number of running processes.
+ *     exited: the number of exited processes.
+ *     sampled: the number of processes sampled this report.
+ */
+void display_summary(int running, int exited, int sampled)
+{
+	if (OUTPUT_FORMAT == OUTPUT_JSON) {
+		out_printf("{\"type\":\"summary\",\"ts\":%.6f,\"running\":%d,\"exited\":%d,"
+			   "\"sampled\":%d,\"saved_reads\":%ld}\n",
+			   REPORT_TIME, running, exited, sampled, SAVED_READS);
+		return;
+	}
+	if (OUTPUT_FORMAT != OUTPUT_TEXT)
+		return;
+	if (SAMPLE_STRIPES > 1)
+		out_printf("Processes: %d running, %d exited, %d sampled\n", running, exited, sampled);
+	if (ADAPTIVE_MAX_SKIP > 0)
+		out_printf("Adaptive sampling: %d sampled, %ld /proc reads saved\n", sampled, SAVED_READS);
+}
+
+/*
+ * periodic_reports
+ * description:
+ *     displays the status of all processes every REPORT_INTERVAL
+ *     seconds, 5 unless set with -r.
+ *     between reports the program sleeps in wait_for_event until
+ *     the next report is due, a child exits, SIGINT is received
+ *     or the time limit is reached.
+ * parameters:
+ *     table: the process table of all children.
+ * pre-conditions:
+ *     table is initialized.
+ *     register_handler has been called.
+ */
+void periodic_reports(struct proc_table *table)
+{
+	initialize_cpu_counters(table);
+	init_event_loop();
+	//children that exited during the launch are already waiting to be reaped
+	reap_children(table);
+	watch_ready_fds(table);
+	update_clock();
+	run_launches(table);
+	double lateness = 0;
+
+	for (int tick = 0; 1; tick++) {
+		double tick_start = get_monotonic_time();
+
+		display_separator();
+		display_header("Normal report", tick);
+		if (display_report(table, tick) == 0 && table->pending == 0) {
+			int total_time = (int)(NOW.realtime - START_TIME);
+
+			flush_logs();
+			display_history(table);
+			display_exiting(total_time);
+			display_separator();
+			flush_report();
+			free_proc_table(table);
+			exit(0);
+		}
+		if (SELF_OVERHEAD == 1)
+			display_overhead(get_monotonic_time() - tick_start, lateness);
+		if (AGGREGATOR_FD != -1)
+			write_record(RECORD_REPORT_END, NULL, 0, tick);
+		display_separator();
+		flush_report();
+		if (CHECKPOINT_PATH != NULL)
+			write_checkpoint(table);
+		int event = EVENT_NONE;
+
+		if (tick > 0)
+			schedule_report();
+
+		while (event != EVENT_REPORT) {
+			event = wait_for_event();
+			update_clock();
+			double current_time = NOW.realtime;
+
+			if (event == EVENT_DEADLINE)
+				terminate_program(table, TARGET_TIME);
+			if (event == EVENT_RESTART)
+				run_restarts(table);
+			if (event == EVENT_CONTROL)
+				handle_control(table);
+			if (event == EVENT_PROC)
+				handle_proc_events(table);
+			if (event == EVENT_LAUNCH || event == EVENT_READY)
+				run_launches(table);
+			if (check_timer(current_time) == 1)
+				terminate_program(table, current_time - START_TIME);
+			if (event == EVENT_CHILD && reap_children(table) > 0 && table->pending > 0)
+				run_launches(table);
+			if (event == EVENT_CHILD && all_exited(table) == 1 && table->pending == 0)
+				break; //report the final state right away
+		}
+		lateness = event == EVENT_REPORT ? get_monotonic_time() - NEXT_REPORT : 0;
+	}
+}
+
+/*
+ * init_self_usage
+ * description:
+ *     opens the /proc files of macD itself and records its usage so far,
+ *     the start of the first interval of display_overhead, which
+ *     includes launching the process list.
+ */
+void init_self_usage(void)
+{
+	struct rusage usage;
+
+	open_proc_files(&SELF_USAGE.files, getpid(), 1);
+	getrusage(RUSAGE_SELF, &usage);
+	SELF_USAGE.cpu_usec = get_rusage_usec(&usage);
+	SELF_USAGE.time = get_monotonic_time();
+	SELF_USAGE.syscalls = SAMPLER_SYSCALLS;
+	SELF_USAGE.opens = SAMPLER_OPENS;
+}
+
+/*
+ * display_overhead
+ * description:
+ *     displays what macD itself cost since the last report with -O:
+ *     the cpu ticks it used and their share of the interval, its memory,
+ *     the system calls and opens made to sample processes, how long this
+ *     report took to sample and format, and how late it started compared
+ *     with when it was due.
+ * parameters:
+ *     tick_time: the time, in seconds, this report took.
+ *     lateness: the time, in seconds, the report timer fired late.
+ * pre-conditions:
+ *     init_self_usage has been called.
+ */
+void display_overhead(double tick_time, double lateness)
+{
+	struct rusage usage;
+
+	getrusage(RUSAGE_SELF, &usage);
+	long cpu_usec = get_rusage_usec(&usage) - SELF_USAGE.cpu_usec;
+	double now = get_monotonic_time();
+	double elapsed = now - SELF_USAGE.time;
+	long syscalls = SAMPLER_SYSCALLS - SELF_USAGE.syscalls;
+	long opens = SAMPLER_OPENS - SELF_USAGE.opens;
+	long ticks = cpu_usec*CLOCK_TICKS/1000000;
+	double cpu = elapsed > 0 ? cpu_usec/(elapsed*1e4) : 0;
+
+	SELF_USAGE.cpu_usec += cpu_usec;
+	SELF_USAGE.time = now;
+	SELF_USAGE.syscalls += syscalls;
+	SELF_USAGE.opens += opens;
+	//read after the counters so macD's own read is not counted as sampling
+	int mem = get_mem_usage(&SELF_USAGE.files);
+
+	if (lateness < 0)
+		lateness = 0;
+	if (OUTPUT_FORMAT == OUTPUT_TEXT) {
+		out_printf("macD: cpu %ld ticks (%.1f%%), mem %d MB, %ld syscalls (%ld opens),"
+			   " tick %.2f ms, %.2f ms late\n", ticks, cpu, mem, syscalls, opens,
+			   tick_time*1000, lateness*1000);
+	} else if (OUTPUT_FORMAT == OUTPUT_JSON) {
+		out_printf("{\"type\":\"self\",\"ts\":%.6f,\"cpu_ticks\":%ld,\"cpu\":%.2f,"
+			   "\"mem_mb\":%d,\"syscalls\":%ld,\"opens\":%ld,\"tick_ms\":%.3f,"
+			   "\"late_ms\":%.3f}\n", REPORT_TIME, ticks, cpu, mem, syscalls, opens,
+			   tick_time*1000, lateness*1000);
+	}
+}
+
+/*
+ * get_rusage_usec
+ * description:
+ *     adds the user and system time of usage.
+ * parameters:
+ *     usage: the usage from getrusage.
+ * returns:
+ *     the total cpu time in microseconds.
+ */
+long get_rusage_usec(struct rusage *usage)
+{
+	return (usage->ru_utime.tv_sec + usage->ru_stime.tv_sec)*1000000L +
+	       usage->ru_utime.tv_usec + usage->ru_stime.tv_usec;
+}
+
+/*
+ * measure_benchmark
+ * description:
+ *     measures the cost of supervising num_processes processes.
+ *     writes a process list of num_processes "sleep" lines to a
+ *     temporary file, starts it with read_file, samples every process
+ *     BENCH_PASSES times, times every reader once more process by
+ *     process, then stops them all with shutdown_children.
+ *     the launch and report output is discarded.
+ * parameters:
+ *     num_processes: the number of processes to start.
+ *     result: where the measurements are stored.
+ * returns:
+ *     0 if the benchmark ran, -1 otherwise.
+ */
+int measure_benchmark(int num_processes, struct bench_result *result)
+{
+	char path[] = "/tmp/macD_bench_XXXXXX";
+	int fd = mkstemp(path);
+
+	if (fd == -1) {
+		fprintf(stderr, "macD: could not create the benchmark process list\n");
+		return -1;
+	}
+	FILE *fptr = fdopen(fd, "w");
+
+	for (int i = 0; i < num_processes; i++)
+		fprintf(fptr, "sleep %d\n", 3600 + i % 60);
+	fclose(fptr);
+	fflush(stdout);
+	int saved_stdout = dup(STDOUT_FILENO);
+	int null_fd = open("/dev/null", O_WRONLY | O_CLOEXEC);
+
+	dup2(null_fd, STDOUT_FILENO);
+	double t = get_monotonic_time();
+	struct proc_table *table = read_file(path);
+
+	result->launch_time = get_monotonic_time() - t;
+	unlink(path);
+	if (table == NULL || table->len == 0) {
+		dup2(saved_stdout, STDOUT_FILENO);
+		close(saved_stdout);
+		close(null_fd);
+		fprintf(stderr, "macD: no benchmark processes could be started\n");
+		if (table != NULL)
+			free_proc_table(table);
+		return -1;
+	}
+	initialize_cpu_counters(table);
+	double *ticks = malloc(sizeof(double)*BENCH_PASSES);
+	double *samples = malloc(sizeof(double)*table->len);
+
+	result->sample_time = 0;
+	result->report_time = 0;
+	for (int slot = 0; slot < table->len; slot++)
+		table->due[slot] = slot;
+	for (int pass = 0; pass < BENCH_PASSES; pass++) {
+		t = get_monotonic_time();
+		sample_slots(table, table->due, table->len);
+		ticks[pass] = get_monotonic_time() - t;
+		result->sample_time += ticks[pass];
+		t = get_monotonic_time();
+		display_report(table, pass);
+		flush_report();
+		result->report_time += get_monotonic_time() - t;
+	}
+	for (int slot = 0; slot < table->len; slot++) {
+		t = get_monotonic_time();
+		sample_process(table, slot);
+		samples[slot] = get_monotonic_time() - t;
+	}
+	result->tick_p50 = percentile(ticks, BENCH_PASSES, 50);
+	result->tick_p99 = percentile(ticks, BENCH_PASSES, 99);
+	result->sample_p50 = percentile(samples, table->len, 50);
+	result->sample_p99 = percentile(samples, table->len, 99);
+	free(ticks);
+	free(samples);
+	t = get_monotonic_time();
+	if (EPOLL_FD == -1)
+		init_event_loop();
+	shutdown_children(table);
+	result->kill_time = get_monotonic_time() - t;
+	flush_report();
+	dup2(saved_stdout, STDOUT_FILENO);
+	close(saved_stdout);
+	close(null_fd);
+	result->processes = num_processes;
+	result->started = table->len;
+	result->table_bytes = proc_table_bytes(table)/table->len;
+	free_proc_table(table);
+	return 0;
+}
+
+/*
+ * run_benchmark
+ * description:
+ *     runs measure_benchmark once and displays the results.
+ * parameters:
+ *     num_processes: the number of processes to start.
+ * returns:
+ *     0 if the benchmark ran, 1 otherwise.
+ */
+int run_benchmark(int num_processes)
+{
+	struct bench_result result;
+
+	if (measure_benchmark(num_processes, &result) == -1)
+		return 1;
+	int started = result.started;
+	int cached = started < CACHED_SLOTS ? started : CACHED_SLOTS;
+
+	printf("Benchmark, %d processes (%d started, %d with cached /proc files)\n",
+	       num_processes, started, cached);
+	printf("launch: %.1f ms (%.0f processes/s)\n", result.launch_time*1000,
+	       started/result.launch_time);
+	printf("sample all: %.2f ms per pass (%.1f us per process, %d threads)\n",
+	       result.sample_time*1000/BENCH_PASSES, result.sample_time*1e6/BENCH_PASSES/started,
+	       SAMPLER_THREADS);
+	printf("sample one: %.1f us p50, %.1f us p99\n", result.sample_p50*1e6,
+	       result.sample_p99*1e6);
+	printf("report: %.2f ms per pass (%d stripes)\n",
+	       result.report_time*1000/BENCH_PASSES, SAMPLE_STRIPES);
+	printf("shutdown: %.1f ms (%.1f s grace period)\n", result.kill_time*1000, GRACE_PERIOD);
+	printf("table: %ld bytes per process\n", result.table_bytes);
+	return 0;
+}
+
+/*
+ * run_bench_suite
+ * description:
+ *     runs measure_benchmark for every size in sizes and displays one
+ *     CSV row per size, so runs can be compared between builds, spawn
+ *     backends and sampler settings. a size that fails is skipped.
+ * parameters:
+ *     sizes: the numbers of processes separated by commas, e.g. "10,100".
+ * returns:
+ *     0 if every size ran, 1 otherwise.
+ */
+int run_bench_suite(char *sizes)
+{
+	char *backends[] = {"fork", "vfork", "spawn"};
+	char *scan = sizes;
+	int status = 0;
+
+	if (sizes[strspn(sizes, "0123456789,")] != '\0') {
+		fprintf(stderr, "macD: invalid benchmark sizes %s\n", sizes);
+		return 1;
+	}
+	printf("processes,started,backend,threads,stripes,launch_ms,launch_per_s,"
+	       "tick_p50_ms,tick_p99_ms,sample_p50_us,sample_p99_us,report_ms,shutdown_ms,"
+	       "table_bytes\n");
+	while (*scan != '\0') {
+		char *end;
+		long num_processes = strtol(scan, &end, 10);
+		struct bench_result result;
+
+		if (end == scan || num_processes < 1 || (*end != ',' && *end != '\0')) {
+			fprintf(stderr, "macD: invalid benchmark sizes %s\n", sizes);
+			return 1;
+		}
+		scan = *end == ',' ? end + 1 : end;
+		if (measure_benchmark(num_processes, &result) == -1) {
+			status = 1;
+			continue;
+		}
+		printf("%d,%d,%s,%d,%d,%.3f,%.0f,%.3f,%.3f,%.2f,%.2f,%.3f,%.3f,%ld\n",
+		       result.processes, result.started, backends[SPAWN_BACKEND], SAMPLER_THREADS,
+		       SAMPLE_STRIPES, result.launch_time*1000, result.started/result.launch_time,
+		       result.tick_p50*1000, result.tick_p99*1000, result.sample_p50*1e6,
+		       result.sample_p99*1e6, result.report_time*1000/BENCH_PASSES,
+		       result.kill_time*1000, result.table_bytes);
+		fflush(stdout);
+	}
+	return status;
+}
+
+/*
+ * percentile
+ * description:
+ *     finds the p-th percentile of values by the nearest rank.
+ *     values is sorted in place.
+ * parameters:
+ *     values: the values.
+ *     len: the number of values, at least 1.
+ *     p: the percentile, from 0 to 100.
+ * returns:
+ *     the p-th percentile.
+ */
+double percentile(double *values, int len, int p)
+{
+	qsort(values, len, sizeof(double), compare_doubles);
+	int rank = (p*len + 99)/100;
+
+	if (rank < 1)
+		rank = 1;
+	return values[rank - 1];
+}
+
+/*
+ * compare_doubles
+ * description:
+ *     orders doubles in ascending order for qsort.
+ * parameters:
+ *     a, b: pointers to the doubles to compare.
+ * returns:
+ *     a negative number, 0 or a positive number if a is smaller than,
+ *     equal to, or larger than b.
+ */
+int compare_doubles(const void *a, const void *b)
+{
+	double x = *(const double *)a;
+	double y = *(const double *)b;
+
+	return (x > y) - (x < y);
+}
+
+/*
+ * proc_table_bytes
+ * description:
+ *     computes the memory used by the process table, including the
+ *     command lines it owns.
+ * parameters:
+ *     table: the process table.
+ * returns:
+ *     the size of the table in bytes.
+ */
+long proc_table_bytes(struct proc_table *table)
+{
+	long slot_size = sizeof(int)*10 + sizeof(double) + sizeof(char *)*3 + sizeof(struct exit_info) +
+			 sizeof(struct restart_info) +
+			 sizeof(struct proc_files);
+	long bytes = sizeof(struct proc_table) + slot_size*table->capacity +
+		     sizeof(int)*table->hash_capacity + table->history_size;
+
+	for (int slot = 0; slot < table->len; slot++) {
+		bytes += strlen(table->command[slot]) + 1;
+		if (table->group[slot] != NULL)
+			bytes += strlen(table->group[slot]) + 1;
+	}
+	return bytes;
+}
+
+/*
+ * all_exited
+ * description:
+ *     checks if every process in the table has exited
+ *     and none is waiting to be restarted.
+ * parameters:
+ *     table: the process table.
+ * returns:
+ *     1 if no process in the table is still running.
+ *     0 otherwise.
+ */
+int all_exited(struct proc_table *table)
+{
+	for (int slot = 0; slot < table->len; slot++) {
+		if (table->state[slot] != PROC_EXITED)
+			return 0;
+	}
+	return 1;
+}
+
+/*
+ * reap_children
+ * description:
+ *     reaps every child that has exited with wait4 and records
+ *     its exit status, cpu time and peak memory usage in its slot.
+ *     called when SIGCHLD is received, so dead processes are
+ *     never polled.
+ *     processes with a restart policy are scheduled to restart.
+ * parameters:
+ *     table: the process table.
+ * returns:
+ *     the number of processes in the table that were reaped.
+ */
+int reap_children(struct proc_table *table)
+{
+	int reaped = 0;
+	int status;
+	struct rusage usage;
+
+	if (table->replay != NULL)
+		return reap_replay(table);
+	pid_t pid = wait4(-1, &status, WNOHANG, &usage);
+
+	while (pid > 0) {
+		int slot = find_slot(table, pid);
+
+		if (slot != -1 && (WIFEXITED(status) || WIFSIGNALED(status))) {
+			record_exit(&table->exit[slot], status, &usage);
+			table->state[slot] = PROC_EXITED;
+			if (table->group_live != NULL)
+				group_alive(table, slot); //before the pid can be reused
+			close_proc_files(&table->files[slot]);
+			close_ready_fd(table, slot);
+			schedule_restart(table, slot);
+			reaped++;
+		}
+		pid = wait4(-1, &status, WNOHANG, &usage);
+	}
+	if (ADOPTED_LEN > 0)
+		reaped += reap_adopted(table);
+	if (table->retired != NULL)
+		release_removed(table);
+	return reaped;
+}
+
+/*
+ * close_ready_fd
+ * description:
+ *     closes the read end of the ready=fd pipe of the line of slot,
+ *     kept open after the process was ready so it cannot get SIGPIPE
+ *     by writing to it again.
+ * parameters:
+ *     table: the process table.
+ *     slot: the slot of the process that exited.
+ */
+void close_ready_fd(struct proc_table *table, int slot)
+{
+	struct list_line *line = table->line[slot];
+
+	if (line == NULL || line->ready_fd == -1 || line->launch == LAUNCH_STARTING)
+		return;
+	close(line->ready_fd);
+	line->ready_fd = -1;
+}
+
+/*
+ * record_exit
+ * description:
+ *     fills in exit from the status and resource usage returned by wait4.
+ * parameters:
+ *     exit: the exit information to fill in.
+ *     status: the status returned by wait4.
+ *     usage: the resource usage returned by wait4.
+ */
+void record_exit(struct exit_info *exit, int status, struct rusage *usage)
+{
+	exit->code = -1;
+	exit->signal = -1;
+	if (WIFEXITED(status))
+		exit->code = WEXITSTATUS(status);
+	else
+		exit->signal = WTERMSIG(status);
+	exit->cpu_time = usage->ru_utime.tv_sec + usage->ru_utime.tv_usec/1e6;
+	exit->cpu_time += usage->ru_stime.tv_sec + usage->ru_stime.tv_usec/1e6;
+	exit->max_rss = usage->ru_maxrss;
+}
+
+/*
+ * schedule_restart
+ * description:
+ *     decides whether the process that just exited from slot is
+ *     restarted, following the restart directive of its line, or
+ *     because an alert asked for it.
+ *     the first restart waits RESTART_BACKOFF_MIN seconds and each one
+ *     after that twice as long as the last, up to RESTART_BACKOFF_MAX.
+ *     a process that ran for RESTART_BACKOFF_RESET seconds starts over
+ *     from the minimum. a process restarted RESTART_BURST times within
+ *     RESTART_WINDOW seconds is in a crash loop and is not restarted again.
+ * parameters:
+ *     table: the process table.
+ *     slot: the slot of the process that was just reaped.
+ * post-conditions:
+ *     the slot is PROC_RESTARTING and the restart timer is armed,
+ *     or the slot is left PROC_EXITED.
+ */
+void schedule_restart(struct proc_table *table, int slot)
+{
+	struct restart_info *restart = &table->restart[slot];
+	struct exit_info *exit = &table->exit[slot];
+	struct list_line *line = table->line[slot];
+	int policy = line == NULL || line->removed == 1 ? RESTART_NEVER : line->restart;
+	int forced = restart->forced == 1 && line != NULL && line->removed == 0;
+
+	restart->forced = 0;
+	if (SHUTTING_DOWN == 1 || (policy == RESTART_NEVER && forced == 0))
+		return;
+	if (policy == RESTART_ON_FAILURE && exit->code == 0 && forced == 0)
+		return;
+	double now = get_monotonic_time();
+
+	if (now - restart->started_at >= RESTART_BACKOFF_RESET)
+		restart->backoff = 0;
+	if (now - restart->window_start > RESTART_WINDOW) {
+		restart->window_start = now;
+		restart->recent = 0;
+	}
+	if (restart->recent >= RESTART_BURST) {
+		restart->crash_loop = 1;
+		return;
+	}
+	restart->recent++;
+	restart->backoff *= 2;
+	if (restart->backoff < RESTART_BACKOFF_MIN)
+		restart->backoff = RESTART_BACKOFF_MIN;
+	if (restart->backoff > RESTART_BACKOFF_MAX)
+		restart->backoff = RESTART_BACKOFF_MAX;
+	restart->due = now + restart->backoff;
+	table->state[slot] = PROC_RESTARTING;
+	if (RESTART_TIMER_FD != -1 && (NEXT_RESTART == 0 || restart->due < NEXT_RESTART)) {
+		NEXT_RESTART = restart->due;
+		set_timer(RESTART_TIMER_FD, TFD_TIMER_ABSTIME, NEXT_RESTART, 0);
+	}
+}
+
+/*
+ * run_restarts
+ * description:
+ *     restarts every process whose restart is due, and kills every
+ *     process removed by a reload that outlived its grace period, then
+ *     arms the restart timer for the next one.
+ *     at most RESTART_RATE processes are restarted per second across
+ *     the whole table, restarts over that are pushed back, so many
+ *     crashing lines cannot turn into a fork storm.
+ * parameters:
+ *     table: the process table.
+ */
+void run_restarts(struct proc_table *table)
+{
+	double now = get_monotonic_time();
+
+	RESTART_TOKENS += (now - LAST_RESTART_TIME)*RESTART_RATE;
+	if (RESTART_TOKENS > RESTART_RATE)
+		RESTART_TOKENS = RESTART_RATE;
+	LAST_RESTART_TIME = now;
+	NEXT_RESTART = 0;
+	REPORT_TIME = now;
+	for (int slot = 0; slot < table->len; slot++) {
+		struct restart_info *restart = &table->restart[slot];
+
+		if (table->state[slot] == PROC_RUNNING && restart->kill_due > 0) {
+			if (restart->kill_due <= now) {
+				restart->kill_due = 0;
+				table->exit[slot].stopped = STOPPED_KILL;
+				signal_process(table, slot, SIGKILL);
+			} else if (NEXT_RESTART == 0 || restart->kill_due < NEXT_RESTART) {
+				NEXT_RESTART = restart->kill_due;
+			}
+		}
+		if (table->state[slot] != PROC_RESTARTING)
+			continue;
+		if (restart->due <= now && RESTART_TOKENS >= 1) {
+			RESTART_TOKENS--;
+			restart_process(table, slot);
+		} else if (restart->due <= now) {
+			restart->due = now + 1.0/RESTART_RATE;
+		}
+		if (table->state[slot] == PROC_RESTARTING &&
+		    (NEXT_RESTART == 0 || restart->due < NEXT_RESTART))
+			NEXT_RESTART = restart->due;
+	}
+	set_timer(RESTART_TIMER_FD, TFD_TIMER_ABSTIME, NEXT_RESTART, 0);
+	flush_report();
+}
+
+/*
+ * open_control
+ * description:
+ *     creates the control socket at path, a unix stream socket served
+ *     by handle_control from the event loop. a socket left behind by
+ *     a previous macD is replaced. the socket is removed when macD exits.
+ * parameters:
+ *     path: the path of the socket.
+ * returns:
+ *     0 on success.
+ *     -1 if the socket could not be created.
+ */
+int open_control(char *path)
+{
+	struct sockaddr_un addr;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if (strlen(path) >= sizeof(addr.sun_path)) {
+		fprintf(stderr, "macD: control socket path %s is too long\n", path);
+		return -1;
+	}
+	strcpy(addr.sun_path, path);
+	CONTROL_FD = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (CONTROL_FD == -1) {
+		warn("could not create the control socket");
+		return -1;
+	}
+	unlink(path);
+	if (bind(CONTROL_FD, (struct sockaddr *)&addr, sizeof(addr)) == -1 ||
+	    listen(CONTROL_FD, 16) == -1) {
+		warn("could not listen on %s", path);
+		close(CONTROL_FD);
+		CONTROL_FD = -1;
+		return -1;
+	}
+	atexit(close_control);
+	return 0;
+}
+
+/*
+ * close_control
+ * description:
+ *     closes and removes the control socket, if there is one.
+ */
+void close_control(void)
+{
+	if (CONTROL_FD == -1)
+		return;
+	close(CONTROL_FD);
+	unlink(CONTROL_PATH);
+	CONTROL_FD = -1;
+}
+
+/*
+ * handle_control
+ * description:
+ *     accepts a client of the control socket, reads its request
+ *     and answers it. a request is one line:
+ *         status: the state of every process in the table, see control_status.
+ *         reload: reads the process list file again, see reload_process_list.
+ *         upgrade: runs macD again over the running processes, see upgrade_supervisor.
+ *     the client is closed after the answer. reads and writes time out
+ *     after CONTROL_TIMEOUT seconds so a stuck client cannot hold up
+ *     the event loop.
+ * parameters:
+ *     table: the process table.
+ */
+void handle_control(struct proc_table *table)
+{
+	char request[CONTROL_BUFFER_SIZE];
+	struct timeval timeout;
+	int len = 0;
+	int client = accept4(CONTROL_FD, NULL, NULL, SOCK_CLOEXEC);
+
+	if (client == -1)
+		return;
+	timeout.tv_sec = 0;
+	timeout.tv_usec = CONTROL_TIMEOUT*1000000;
+	setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+	setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+	while (len < (int)sizeof(request) - 1 && memchr(request, '\n', len) == NULL) {
+		ssize_t got = read(client, request + len, sizeof(request) - 1 - len);
+
+		if (got <= 0)
+			break;
+		len += got;
+	}
+	request[len] = '\0';
+	request[strcspn(request, "\r\n")] = '\0';
+	FILE *reply = fdopen(client, "w");
+
+	if (reply == NULL) {
+		close(client);
+		return;
+	}
+	if (strcmp(request, "status") == 0)
+		control_status(table, reply);
+	else if (strcmp(request, "reload") == 0)
+		reload_process_list(table, reply);
+	else if (strcmp(request, "upgrade") == 0)
+		upgrade_supervisor(table, reply);
+	else
+		fprintf(reply, "error: unknown request \"%s\", expected status, reload or upgrade\n",
+			request);
+	fclose(reply);
+}
+
+/*
+ * control_status
+ * description:
+ *     writes the state of every process in the table as of its last
+ *     sample, one line per slot, after a line counting them.
+ * parameters:
+ *     table: the process table.
+ *     reply: where the answer is written.
+ */
+void control_status(struct proc_table *table, FILE *reply)
+{
+	int running = 0;
+	int restarting = 0;
+
+	for (int slot = 0; slot < table->len; slot++) {
+		running += table->state[slot] == PROC_RUNNING;
+		restarting += table->state[slot] == PROC_RESTARTING;
+	}
+	fprintf(reply, "%d processes, %d running, %d restarting, %d exited\n", table->len, running,
+		restarting, table->len - running - restarting);
+	for (int slot = 0; slot < table->len; slot++) {
+		struct exit_info *exit = &table->exit[slot];
+
+		if (table->state[slot] == PROC_RUNNING)
+			fprintf(reply, "[%d] running, pid: %d, cpu usage: %d%%, mem usage: %d MB", slot,
+				table->pid[slot], table->cpu[slot], table->mem[slot]);
+		else if (table->state[slot] == PROC_RESTARTING)
+			fprintf(reply, "[%d] restarting in %.1fs", slot,
+				table->restart[slot].due - get_monotonic_time());
+		else if (exit->code != -1)
+			fprintf(reply, "[%d] exited, code %d", slot, exit->code);
+		else
+			fprintf(reply, "[%d] exited, signal %d", slot, exit->signal);
+		fprintf(reply, ", restarts: %d, line %d: %s\n", table->restart[slot].restarts,
+			table->line_number[slot], table->command[slot]);
+	}
+}
+
+/*
+ * reload_process_list
+ * description:
+ *     reads the process list file again and applies what changed.
+ *     each slot whose line is still in the file, with the same text, is
+ *     kept as it is and takes the new line number of its line. slots
+ *     whose line is gone are stopped with SIGTERM, and SIGKILL after
+ *     GRACE_PERIOD, and not restarted. their old line, with its log, is
+ *     kept until they are reaped. lines that are new are started in new
+ *     slots. exited slots are
+ *     matched too, so a line that already exited is not started again.
+ *     new lines are started following the launch settings of the new
+ *     list, see run_launches. the time limit is not changed.
+ * parameters:
+ *     table: the process table.
+ *     reply: where the answer is written.
+ */
+void reload_process_list(struct proc_table *table, FILE *reply)
+{
+	if (LIST_PATH == NULL) {
+		fprintf(reply, "error: no process list file to reload\n");
+		return;
+	}
+	struct process_list *list = parse_process_list(LIST_PATH);
+
+	if (list == NULL) {
+		fprintf(reply, "error: could not read %s\n", LIST_PATH);
+		return;
+	}
+	int first = read_list_header(list);
+	char *taken = calloc(list->len + 1, 1);
+	int *chain = malloc(sizeof(int)*(list->len + 1));
+	int buckets_len = 16;
+
+	while (buckets_len < list->len*2)
+		buckets_len *= 2;
+	int *buckets = malloc(sizeof(int)*buckets_len);
+
+	for (int i = 0; i < buckets_len; i++)
+		buckets[i] = -1;
+	//inserted last to first so each chain is in line order
+	for (int i = list->len - 1; i >= first; i--) {
+		int bucket = hash_text(list->lines[i].text) & (buckets_len - 1);
+
+		chain[i] = buckets[bucket];
+		buckets[bucket] = i;
+	}
+	int stopped = 0;
+	int kept = 0;
+	int old_len = table->len;
+
+	display_header("Reloading", -1);
+	for (int slot = 0; slot < table->len; slot++) {
+		if (table->line[slot] == NULL || table->line[slot]->removed == 1)
+			continue;
+		int i = buckets[hash_text(table->line[slot]->text) & (buckets_len - 1)];
+
+		while (i != -1 && (taken[i] == 1 || strcmp(list->lines[i].text, table->line[slot]->text) != 0))
+			i = chain[i];
+		if (i != -1) {
+			taken[i] = 1;
+			list->lines[i].line_number = i - first; //numbered like launch_lines numbers new lines
+			read_directives(&list->lines[i]);
+			move_launch(table->line[slot], &list->lines[i]);
+			table->line[slot] = &list->lines[i];
+			table->line_number[slot] = i - first;
+			kept++;
+			continue;
+		}
+		if (table->state[slot] == PROC_RUNNING) {
+			//the line and its log stay until the process is reaped, see release_removed
+			table->line[slot]->removed = 1;
+			table->list->users++;
+			stop_removed(table, slot);
+			stopped++;
+			continue;
+		}
+		table->line[slot] = NULL;
+		if (table->state[slot] == PROC_RESTARTING) {
+			table->state[slot] = PROC_EXITED;
+			stopped++;
+		}
+	}
+	if (table->list->users > 0) {
+		table->list->next = table->retired;
+		table->retired = table->list;
+	} else {
+		free_process_list(table->list);
+	}
+	table->list = list;
+	table->starting = realloc(table->starting, sizeof(int)*(list->len + 1));
+	table->starting_len = 0;
+	table->pending = 0;
+	for (int i = first; i < list->len; i++) {
+		if (list->lines[i].launch == LAUNCH_STARTING) {
+			table->starting[table->starting_len++] = i;
+			table->pending++;
+		}
+	}
+	launch_lines(table, list, first, taken);
+	flush_report();
+	fprintf(reply, "reloaded %s: %d started, %d stopped, %d unchanged\n", LIST_PATH,
+		table->len - old_len, stopped, kept);
+	free(taken);
+	free(chain);
+	free(buckets);
+}
+
+/*
+ * stop_removed
+ * description:
+ *     stops the process of a slot whose line was removed by a reload:
+ *     SIGTERM now, and SIGKILL from run_restarts if it still runs after
+ *     GRACE_PERIOD, like shutdown_children.
+ * parameters:
+ *     table: the process table.
+ *     slot: the slot of the running process.
+ */
+void stop_removed(struct proc_table *table, int slot)
+{
+	if (GRACE_PERIOD <= 0) {
+		table->exit[slot].stopped = STOPPED_KILL;
+		signal_process(table, slot, SIGKILL);
+		return;
+	}
+	struct restart_info *restart = &table->restart[slot];
+
+	table->exit[slot].stopped = STOPPED_TERM;
+	signal_process(table, slot, SIGTERM);
+	restart->kill_due = get_monotonic_time() + GRACE_PERIOD;
+	if (RESTART_TIMER_FD != -1 && (NEXT_RESTART == 0 || restart->kill_due < NEXT_RESTART)) {
+		NEXT_RESTART = restart->kill_due;
+		set_timer(RESTART_TIMER_FD, TFD_TIMER_ABSTIME, NEXT_RESTART, 0);
+	}
+}
+
+/*
+ * release_removed
+ * description:
+ *     lets go of the lines removed by a reload whose process was reaped,
+ *     after draining what is left in their log, and frees each retired
+ *     process list once none of its lines is in use.
+ * parameters:
+ *     table: the process table.
+ */
+void release_removed(struct proc_table *table)
+{
+	for (int slot = 0; slot < table->len; slot++) {
+		struct list_line *line = table->line[slot];
+
+		if (line == NULL || line->removed == 0 || table->state[slot] == PROC_RUNNING)
+			continue;
+		for (struct process_list *list = table->retired; list != NULL; list = list->next) {
+			if (line >= list->lines && line < list->lines + list->len) {
+				list->users--;
+				break;
+			}
+		}
+		if (line->log_read != -1)
+			drain_log(line);
+		table->restart[slot].kill_due = 0;
+		table->line[slot] = NULL;
+	}
+	struct process_list **link = &table->retired;
+
+	while (*link != NULL) {
+		struct process_list *list = *link;
+
+		if (list->users > 0) {
+			link = &list->next;
+			continue;
+		}
+		*link = list->next;
+		free_process_list(list);
+	}
+}
+
+/*
+ * move_launch
+ * description:
+ *     carries the launch state and the log of a line over to the same
+ *     line of a reloaded process list.
+ * parameters:
+ *     from: the line of the old list.
+ *     to: the line of the new list.
+ */
+void move_launch(struct list_line *from, struct list_line *to)
+{
+	to->launch = from->launch;
+	to->slot = from->slot;
+	to->launch_time = from->launch_time;
+	to->ready_fd = from->ready_fd;
+	from->ready_fd = -1;
+	to->log_read = from->log_read;
+	to->log_write = from->log_write;
+	to->log_fd = from->log_fd;
+	to->log_written = from->log_written;
+	from->log_read = -1;
+	if (to->log_read != -1)
+		LOG_LINES[to->log_read] = to;
+}
+
+/*
+ * hash_text
+ * description:
+ *     hashes a string with FNV-1a.
+ * parameters:
+ *     text: the string to hash.
+ * returns:
+ *     the hash of text.
+ */
+unsigned int hash_text(char *text)
+{
+	unsigned int hash = 2166136261u;
+
+	for (unsigned char *scan = (unsigned char *)text; *scan != '\0'; scan++)
+		hash = (hash ^ *scan)*16777619u;
+	return hash;
+}
+
+/*
+ * parse_shard
+ * description:
+ *     reads the shard given with -x as [index]/[count].
+ * parameters:
+ *     text: the shard.
+ * returns:
+ *     0 on success, SHARD_INDEX and SHARD_COUNT are set.
+ *     -1 if text is not a valid shard.
+ */
+int parse_shard(char *text)
+{
+	char *slash = strchr(text, '/');
+
+	if (slash == NULL)
+		return -1;
+	*slash = '\0';
+	int index = convert_str_to_int(text);
+	int count = convert_str_to_int(slash + 1);
+
+	*slash = '/';
+	if (index < 0 || count < 1 || index >= count)
+		return -1;
+	SHARD_INDEX = index;
+	SHARD_COUNT = count;
+	return 0;
+}
+
+/*
+ * shard_owns
+ * description:
+ *     checks if this instance runs line. a line with a host directive
+ *     runs on the instance named like it, see -n. any other line runs
+ *     on the shard its text hashes to, so every instance reading the
+ *     same process list agrees on where each line runs.
+ * parameters:
+ *     line: the line, with its directives read.
+ * returns:
+ *     1 if this instance starts line, 0 otherwise.
+ */
+int shard_owns(struct list_line *line)
+{
+	if (line->host != NULL)
+		return strcmp(line->host, SHARD_NAME) == 0;
+	return hash_text(line->text) % SHARD_COUNT == (unsigned int)SHARD_INDEX;
+}
+
+/*
+ * open_shard_socket
+ * description:
+ *     opens a tcp socket to [host:]port, connected to it or, if
+ *     passive, listening on it without blocking. without a host a
+ *     passive socket listens on every address.
+ * parameters:
+ *     address: the [host:]port.
+ *     passive: 1 to listen, 0 to connect.
+ * returns:
+ *     the socket.
+ *     -1 with a warning displayed if it could not be opened.
+ */
+int open_shard_socket(char *address, int passive)
+{
+	char host[256];
+	char *port = strrchr(address, ':');
+	struct addrinfo hints;
+	struct addrinfo *result;
+	int fd = -1;
+
+	snprintf(host, sizeof(host), "%.*s", port == NULL ? 0 : (int)(port - address), address);
+	port = port == NULL ? address : port + 1;
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_flags = passive == 1 ? AI_PASSIVE : 0;
+	int error = getaddrinfo(host[0] == '\0' ? NULL : host, port, &hints, &result);
+
+	if (error != 0) {
+		warnx("could not resolve %s: %s", address, gai_strerror(error));
+		return -1;
+	}
+	for (struct addrinfo *ai = result; ai != NULL && fd == -1; ai = ai->ai_next) {
+		int on = 1;
+
+		fd = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC | (passive == 1 ? SOCK_NONBLOCK : 0),
+			    ai->ai_protocol);
+		if (fd == -1)
+			continue;
+		if (passive == 1)
+			setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+		if (passive == 1 && bind(fd, ai->ai_addr, ai->ai_addrlen) == 0 && listen(fd, SOMAXCONN) == 0)
+			break;
+		if (passive == 0 && connect(fd, ai->ai_addr, ai->ai_addrlen) == 0)
+			break;
+		close(fd);
+		fd = -1;
+	}
+	if (fd == -1)
+		warn("could not %s %s", passive == 1 ? "listen on" : "connect to", address);
+	freeaddrinfo(result);
+	return fd;
+}
+
+/*
+ * connect_aggregator
+ * description:
+ *     connects to the aggregator at address for -A. every report is
+ *     then written to it in the binary format instead of to stdout,
+ *     starting with a RECORD_HELLO record, and each normal report ends
+ *     with a RECORD_REPORT_END record.
+ *     SIGPIPE is blocked so macD keeps supervising its processes if
+ *     the aggregator goes away, see flush_report, and the socket is
+ *     non blocking so it does not wait on a slow one, see send_aggregator.
+ * parameters:
+ *     address: the host:port of the aggregator.
+ * returns:
+ *     0 on success.
+ *     -1 if the aggregator could not be reached.
+ */
+int connect_aggregator(char *address)
+{
+	sigset_t mask;
+
+	AGGREGATOR_FD = open_shard_socket(address, 0);
+	if (AGGREGATOR_FD == -1)
+		return -1;
+	//written without waiting, see send_aggregator
+	fcntl(AGGREGATOR_FD, F_SETFL, fcntl(AGGREGATOR_FD, F_GETFL) | O_NONBLOCK);
+	sigemptyset(&mask);
+	sigaddset(&mask, SIGPIPE);
+	sigprocmask(SIG_BLOCK, &mask, NULL);
+	OUTPUT_FD = AGGREGATOR_FD;
+	OUTPUT_FORMAT = OUTPUT_BINARY;
+	REPORT_TIME = get_monotonic_time();
+	write_record(RECORD_HELLO, NULL, 0, SHARD_INDEX);
+	flush_report();
+	return 0;
+}
+
+/*
+ * run_aggregator
+ * description:
+ *     the --aggregate mode: accepts the instances started with -A and
+ *     merges their records into one fleet report per tick, see
+ *     display_fleet_report. every line of the process list has one
+ *     entry, found by its line number, which each instance reading the
+ *     same list agrees on, so merging a record is a copy into an array.
+ *     records are read AGGREGATE_BUFFER_SIZE bytes at a time and up to
+ *     AGGREGATE_EVENTS connections are handled per wake up.
+ *     stops once every instance disconnected, or on SIGINT.
+ * parameters:
+ *     address: the [host:]port to listen on.
+ * returns:
+ *     the exit code of macD.
+ */
+int run_aggregator(char *address)
+{
+	struct epoll_event events[AGGREGATE_EVENTS];
+	int listen_fd = open_shard_socket(address, 1);
+	int connected = 0;
+	int stop = 0;
+
+	if (listen_fd == -1)
+		return 1;
+	OUTPUT_FORMAT = OUTPUT_TEXT;
+	EPOLL_FD = epoll_create1(EPOLL_CLOEXEC);
+	if (EPOLL_FD == -1)
+		err(1, "epoll_create error");
+	watch_fd(SIGNAL_FD, EVENT_SIGNAL);
+	watch_fd(listen_fd, EVENT_ACCEPT);
+	while (stop == 0 && (connected == 0 || PEERS_OPEN > 0)) {
+		int ready = epoll_wait(EPOLL_FD, events, AGGREGATE_EVENTS, -1);
+
+		if (ready == -1 && errno == EINTR)
+			continue;
+		if (ready == -1)
+			err(1, "epoll_wait error");
+		for (int i = 0; i < ready; i++) {
+			int event = events[i].data.u64 >> 32;
+			int fd = (int)(uint32_t)events[i].data.u64;
+
+			if (event == EVENT_SIGNAL && read_signal() == SIGINT)
+				stop = 1;
+			if (event == EVENT_ACCEPT)
+				connected += accept_peers(listen_fd);
+			if (event == EVENT_PEER)
+				read_peer(fd);
+		}
+		if (fleet_tick() > FLEET_TICK) {
+			FLEET_TICK = fleet_tick();
+			display_fleet_report(FLEET_TICK);
+		}
+	}
+	display_fleet_report(FLEET_TICK);
+	close(listen_fd);
+	free(PEERS);
+	free(FLEET);
+	return 0;
+}
+
+/*
+ * accept_peers
+ * description:
+ *     accepts every instance waiting to connect to the aggregator.
+ * parameters:
+ *     listen_fd: the listening socket.
+ * returns:
+ *     the number of instances accepted.
+ */
+int accept_peers(int listen_fd)
+{
+	int accepted = 0;
+	int fd;
+
+	while ((fd = accept4(listen_fd, NULL, NULL, SOCK_CLOEXEC | SOCK_NONBLOCK)) != -1) {
+		if (fd >= PEERS_LEN) {
+			int len = fd*2 + 1;
+
+			PEERS = realloc(PEERS, sizeof(struct shard_peer)*len);
+			if (PEERS == NULL)
+				err(1, "aggregator allocation error");
+			for (int i = PEERS_LEN; i < len; i++)
+				PEERS[i].fd = -1;
+			PEERS_LEN = len;
+		}
+		memset(&PEERS[fd], 0, sizeof(struct shard_peer));
+		PEERS[fd].fd = fd;
+		PEERS[fd].index = -1;
+		PEERS[fd].tick = -1;
+		watch_fd(fd, EVENT_PEER);
+		PEERS_OPEN++;
+		accepted++;
+	}
+	return accepted;
+}
+
+/*
+ * read_peer
+ * description:
+ *     reads what an instance sent and merges every whole record.
+ *     a record cut by the read is kept in the peer until the rest
+ *     arrives. the instance is closed once it disconnects.
+ * parameters:
+ *     fd: the connection of the instance.
+ */
+void read_peer(int fd)
+{
+	static struct sample_record records[AGGREGATE_BUFFER_SIZE/sizeof(struct sample_record)];
+	struct shard_peer *peer = &PEERS[fd];
+	char *buffer = (char *)records;
+	ssize_t got;
+
+	while (1) {
+		memcpy(buffer, peer->buffer, peer->buffered);
+		got = read(fd, buffer + peer->buffered, sizeof(records) - peer->buffered);
+		if (got == -1 && errno == EINTR)
+			continue;
+		if (got <= 0)
+			break;
+		int len = peer->buffered + got;
+		int count = len/sizeof(struct sample_record);
+
+		for (int i = 0; i < count; i++)
+			merge_record(peer, &records[i]);
+		peer->buffered = len - count*sizeof(struct sample_record);
+		memcpy(peer->buffer, buffer + count*sizeof(struct sample_record), peer->buffered);
+	}
+	if (got == -1 && errno == EAGAIN)
+		return;
+	close(fd);
+	peer->fd = -1;
+	PEERS_OPEN--;
+}
+
+/*
+ * merge_record
+ * description:
+ *     applies a record of an instance to the fleet: a report end moves
+ *     the instance to that tick, a record about a process replaces the
+ *     entry of its line and an alert is displayed right away.
+ * parameters:
+ *     peer: the instance the record came from.
+ *     record: the record.
+ */
+void merge_record(struct shard_peer *peer, struct sample_record *record)
+{
+	if (record->type == RECORD_HELLO)
+		peer->index = record->value;
+	if (record->type == RECORD_REPORT_END)
+		peer->tick = record->value;
+	if (record->type == RECORD_EXIT) {
+		//no more ticks will come, the fleet report no longer waits for it
+		peer->tick = INT_MAX;
+	}
+	if (record->type == RECORD_ALERT && OUTPUT_FORMAT == OUTPUT_TEXT) {
+		out_printf("[%d@%d] Alert (%d%%, %d MB), ", record->line_number, peer->index,
+			   record->cpu, record->mem);
+		if (record->value > 0)
+			out_printf("SIG%s\n", sigabbrev_np(record->value));
+		else
+			out_printf("%s\n", record->value == -1 ? "restart" : "log");
+		flush_report();
+	}
+	if (record->line_number < 0 || record->line_number >= FLEET_MAX_LINES ||
+	    record->type == RECORD_REPORT || record->type == RECORD_ALERT)
+		return;
+	if (record->line_number >= FLEET_LEN) {
+		int len = record->line_number*2 + 16;
+
+		FLEET = realloc(FLEET, sizeof(struct fleet_line)*len);
+		if (FLEET == NULL)
+			err(1, "aggregator allocation error");
+		memset(FLEET + FLEET_LEN, 0, sizeof(struct fleet_line)*(len - FLEET_LEN));
+		FLEET_LEN = len;
+	}
+	FLEET[record->line_number].record = *record;
+	FLEET[record->line_number].shard = peer->index;
+}
+
+/*
+ * fleet_tick
+ * description:
+ *     finds the last tick every connected instance has fully reported.
+ * returns:
+ *     the tick, or -1 if an instance has not finished a report yet.
+ */
+int fleet_tick(void)
+{
+	int tick = INT_MAX;
+
+	for (int fd = 0; fd < PEERS_LEN; fd++) {
+		if (PEERS[fd].fd != -1 && PEERS[fd].tick < tick)
+			tick = PEERS[fd].tick;
+	}
+	return tick == INT_MAX ? FLEET_TICK : tick;
+}
+
+/*
+ * display_fleet_report
+ * description:
+ *     displays the last state of every line of every instance, each
+ *     tagged with the shard that runs it, and the totals of the fleet.
+ * parameters:
+ *     tick: the tick every instance has reported.
+ */
+void display_fleet_report(int tick)
+{
+	int running = 0;
+	int exited = 0;
+	long cpu = 0;
+	long mem = 0;
+
+	display_separator();
+	display_header("Fleet report", tick);
+	for (int i = 0; i < FLEET_LEN; i++) {
+		struct sample_record *record = &FLEET[i].record;
+
+		if (record->type == 0)
+			continue;
+		out_printf("[%d@%d] ", i, FLEET[i].shard);
+		if (record->type == RECORD_FAILED) {
+			out_printf("failed to start\n");
+			exited++;
+		} else if (record->state == PROC_RUNNING && record->cpu != -1) {
+			out_printf("Running, cpu usage: %d%%, mem usage: %d MB\n", record->cpu, record->mem);
+			running++;
+			cpu += record->cpu;
+			mem += record->mem;
+		} else if (record->state == PROC_RUNNING) {
+			out_printf("Running (pid: %d)\n", record->pid);
+			running++;
+		} else if (record->exit_signal > 0) {
+			out_printf("Terminated (signal %d, restarts: %u)\n", record->exit_signal, record->restarts);
+			exited++;
+		} else {
+			out_printf("Exited (code %d, restarts: %u)\n", record->exit_code, record->restarts);
+			exited++;
+		}
+	}
+	out_printf("Fleet, instances: %d, running: %d, exited: %d, cpu usage: %ld%%, mem usage: %ld MB\n",
+		   PEERS_OPEN, running, exited, cpu, mem);
+	display_separator();
+	flush_report();
+}
+
+/*
+ * open_replay
+ * description:
+ *     maps the sample history file written with -H and -M for --replay
+ *     and indexes the history of every slot that has samples, each the
+ *     trace of one recorded process. every duration macD waits for is
+ *     divided by REPLAY_SPEED, so the event loop runs the same reports,
+ *     alerts and restarts that many times faster than real time.
+ *     processes are never started and /proc is never read, the groups
+ *     of -g and the collector of -C do not apply.
+ * parameters:
+ *     path: the history file.
+ * returns:
+ *     0 on success.
+ *     -1 if the file is not a sample history with samples,
+ *     with an error displayed.
+ */
+int open_replay(char *path)
+{
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+	struct stat info;
+
+	if (fd == -1 || fstat(fd, &info) == -1) {
+		warn("could not open %s", path);
+		return -1;
+	}
+	REPLAY_SIZE = info.st_size;
+	REPLAY_HEADER = mmap(NULL, REPLAY_SIZE, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (REPLAY_HEADER == MAP_FAILED || REPLAY_SIZE < sizeof(struct history_header) ||
+	    memcmp(REPLAY_HEADER->magic, HISTORY_MAGIC, sizeof(REPLAY_HEADER->magic)) != 0 ||
+	    REPLAY_HEADER->version != HISTORY_VERSION ||
+	    REPLAY_HEADER->block_size != sizeof(struct history_slot) +
+					  sizeof(struct history_sample)*REPLAY_HEADER->length ||
+	    REPLAY_SIZE < sizeof(struct history_header) +
+			  (size_t)REPLAY_HEADER->block_size*REPLAY_HEADER->slots) {
+		fprintf(stderr, "macD: %s is not a sample history file\n", path);
+		return -1;
+	}
+	REPLAY_TRACES = malloc(sizeof(struct history_slot *)*(REPLAY_HEADER->slots + 1));
+	for (uint32_t i = 0; i < REPLAY_HEADER->slots; i++) {
+		struct history_slot *trace = (struct history_slot *)((char *)REPLAY_HEADER +
+			sizeof(struct history_header) + (size_t)REPLAY_HEADER->block_size*i);
+
+		if (trace->count > 0 && trace->count <= REPLAY_HEADER->length)
+			REPLAY_TRACES[REPLAY_LEN++] = trace;
+	}
+	if (REPLAY_LEN == 0) {
+		fprintf(stderr, "macD: %s has no samples\n", path);
+		return -1;
+	}
+	REPORT_INTERVAL /= REPLAY_SPEED;
+	GRACE_PERIOD /= REPLAY_SPEED;
+	RESTART_BACKOFF_MIN /= REPLAY_SPEED;
+	RESTART_BACKOFF_MAX /= REPLAY_SPEED;
+	RESTART_BACKOFF_RESET /= REPLAY_SPEED;
+	RESTART_WINDOW /= REPLAY_SPEED;
+	READY_TIMEOUT /= REPLAY_SPEED;
+	RESTART_RATE = RESTART_RATE*REPLAY_SPEED < 1 ? 1 : RESTART_RATE*REPLAY_SPEED;
+	GROUP_MODE = GROUP_NONE;
+	COLLECT_BACKEND = COLLECT_PROC;
+	REPLAY_EPOCH = get_monotonic_time();
+	return 0;
+}
+
+/*
+ * create_replay_list
+ * description:
+ *     makes the process list of --replay without -i: one line per
+ *     virtual process, each named after the pid its trace was
+ *     recorded from.
+ * parameters:
+ *     count: the number of virtual processes, 0 for one per trace.
+ * returns:
+ *     the process list.
+ */
+struct process_list *create_replay_list(int count)
+{
+	if (count == 0)
+		count = REPLAY_LEN;
+	char *buffer = malloc((size_t)count*24 + 1);
+	size_t size = 0;
+
+	for (int i = 0; i < count; i++)
+		size += sprintf(buffer + size, "replay-%d\n", REPLAY_TRACES[i % REPLAY_LEN]->pid);
+	struct process_list *list = parse_process_buffer(buffer, size);
+
+	free(buffer);
+	return list;
+}
+
+/*
+ * get_virtual_time
+ * description:
+ *     the time of --replay, REPLAY_SPEED times faster than real time.
+ * returns:
+ *     the number of virtual seconds since open_replay.
+ */
+double get_virtual_time(void)
+{
+	return (get_monotonic_time() - REPLAY_EPOCH)*REPLAY_SPEED;
+}
+
+/*
+ * start_replay
+ * description:
+ *     starts the trace of the virtual process in slot from its first
+ *     sample. the process of line number n replays trace n, cycling
+ *     through the traces when there are more lines than traces, so
+ *     a few recorded processes can stand for a much larger load.
+ * parameters:
+ *     table: the process table.
+ *     slot: the slot of a virtual process that just started.
+ */
+void start_replay(struct proc_table *table, int slot)
+{
+	struct replay_state *replay = &table->replay[slot];
+
+	replay->trace = table->line_number[slot] % REPLAY_LEN;
+	replay->next = 0;
+	replay->start = get_virtual_time();
+	replay->cpu_time = 0;
+	replay->max_mem = 0;
+	replay->status = -1;
+}
+
+/*
+ * replay_sample
+ * description:
+ *     samples a virtual process: its cpu and memory usage are those
+ *     of the last sample of its trace at or before the virtual time
+ *     it has run for. the time of the sample is virtual too, so alert
+ *     durations are in virtual seconds. once the trace is over the
+ *     process exits with code 0, reaped like a real process through a
+ *     SIGCHLD macD sends itself. only touches slot, like sample_process.
+ * parameters:
+ *     table: the process table.
+ *     slot: the slot of the virtual process.
+ */
+void replay_sample(struct proc_table *table, int slot)
+{
+	struct replay_state *replay = &table->replay[slot];
+	struct history_slot *trace = REPLAY_TRACES[replay->trace];
+	uint32_t length = REPLAY_HEADER->length;
+	uint32_t oldest = trace->count < length ? 0 : trace->next;
+	double now = get_virtual_time();
+	double elapsed = now - replay->start;
+	double first = trace->samples[oldest].time;
+
+	while (replay->next + 1 < (int)trace->count &&
+	       trace->samples[(oldest + replay->next + 1) % length].time - first <= elapsed)
+		replay->next++;
+	struct history_sample *sample = &trace->samples[(oldest + replay->next) % length];
+
+	table->cpu[slot] = sample->cpu;
+	table->mem[slot] = sample->mem;
+	replay->cpu_time += sample->cpu/100.0*(now - table->last_sample[slot]);
+	if (sample->mem > replay->max_mem)
+		replay->max_mem = sample->mem;
+	table->last_sample[slot] = now;
+	if (table->history != NULL)
+		record_history(table, slot, now);
+	double last = trace->samples[(oldest + trace->count - 1) % length].time;
+
+	if (replay->status == -1 && elapsed > last - first) {
+		replay->status = 0;
+		kill(getpid(), SIGCHLD);
+	}
+}
+
+/*
+ * replay_signal
+ * description:
+ *     delivers a signal to a virtual process. a signal that would
+ *     terminate a process by default makes it exit, reaped like a real
+ *     process through a SIGCHLD macD sends itself, any other is ignored.
+ * parameters:
+ *     table: the process table.
+ *     slot: the slot of the virtual process.
+ *     sig: the signal.
+ */
+void replay_signal(struct proc_table *table, int slot, int sig)
+{
+	struct replay_state *replay = &table->replay[slot];
+
+	if (table->state[slot] != PROC_RUNNING || replay->status != -1)
+		return;
+	if (sig == 0 || sig == SIGCHLD || sig == SIGCONT || sig == SIGURG || sig == SIGWINCH ||
+	    sig == SIGSTOP || sig == SIGTSTP || sig == SIGTTIN || sig == SIGTTOU)
+		return;
+	replay->status = sig; //the wait status of a process killed by sig
+	kill(getpid(), SIGCHLD);
+}
+
+/*
+ * reap_replay
+ * description:
+ *     reaps the virtual processes that exited, like reap_children,
+ *     with the cpu time and peak memory of what their trace replayed.
+ * parameters:
+ *     table: the process table.
+ * returns:
+ *     the number of processes that were reaped.
+ */
+int reap_replay(struct proc_table *table)
+{
+	int reaped = 0;
+
+	for (int slot = 0; slot < table->len; slot++) {
+		struct replay_state *replay = &table->replay[slot];
+
+		if (table->state[slot] != PROC_RUNNING || replay->status == -1)
+			continue;
+		struct rusage usage;
+
+		memset(&usage, 0, sizeof(usage));
+		usage.ru_utime.tv_sec = replay->cpu_time;
+		usage.ru_utime.tv_usec = (replay->cpu_time - usage.ru_utime.tv_sec)*1e6;
+		usage.ru_maxrss = replay->max_mem*1024L;
+		record_exit(&table->exit[slot], replay->status, &usage);
+		table->state[slot] = PROC_EXITED;
+		close_ready_fd(table, slot);
+		schedule_restart(table, slot);
+		reaped++;
+	}
+	return reaped;
+}
+
+/*
+ * get_start_ticks
+ * description:
+ *     reads when a process started, field 22 of /proc/[pid]/stat, which
+ *     together with its pid identifies a process even after its pid is
+ *     reused. also reads its parent, field 4.
+ * parameters:
+ *     pid: the process.
+ *     parent: set to the pid of its parent, if not NULL.
+ * returns:
+ *     the clock ticks after boot the process started at.
+ *     0 if the process does not exist.
+ */
+uint64_t get_start_ticks(int pid, int *parent)
+{
+	char path[64];
+	char buffer[PROC_BUFFER_SIZE];
+
+	snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+
+	if (fd == -1)
+		return 0;
+	ssize_t got = read(fd, buffer, sizeof(buffer) - 1);
+
+	close(fd);
+	if (got <= 0)
+		return 0;
+	buffer[got] = '\0';
+	char *scan = strrchr(buffer, ')');
+
+	if (scan == NULL)
+		return 0;
+	//skip to the state, the 3rd field, then to the parent, the 4th, and the start time, the 22nd
+	scan += 2;
+	for (int i = 0; i < 19; i++) {
+		scan = strchr(scan, ' ');
+		if (scan == NULL)
+			return 0;
+		scan++;
+		if (i == 0 && parent != NULL)
+			*parent = atoi(scan);
+	}
+	return strtoull(scan, NULL, 10);
+}
+
+/*
+ * write_checkpoint
+ * description:
+ *     writes every slot of the table to the file of --checkpoint: the
+ *     pid and start time of its process, the line it runs, with a
+ *     hash of the text of the line, its state, last sample, exit and
+ *     restarts.
+ *     the file is written next to the checkpoint and renamed over it,
+ *     so a crash of macD at any point leaves a whole checkpoint.
+ * parameters:
+ *     table: the process table.
+ */
+void write_checkpoint(struct proc_table *table)
+{
+	struct checkpoint_header header;
+	struct checkpoint_entry *entries = malloc(sizeof(struct checkpoint_entry)*(table->len + 1));
+	uint32_t count = 0;
+
+	for (int slot = 0; slot < table->len; slot++) {
+		if (table->line[slot] == NULL || table->line[slot]->removed == 1)
+			continue;
+		if (table->state[slot] == PROC_RUNNING && table->start_ticks[slot] == 0)
+			table->start_ticks[slot] = get_start_ticks(table->pid[slot], NULL);
+		struct checkpoint_entry *entry = &entries[count++];
+		struct restart_info *restart = &table->restart[slot];
+
+		memset(entry, 0, sizeof(*entry));
+		entry->pid = table->pid[slot];
+		entry->line_number = table->line_number[slot];
+		entry->text_hash = hash_text(table->line[slot]->text);
+		entry->restarts = table->restart[slot].restarts;
+		entry->start_ticks = table->start_ticks[slot];
+		entry->started_at = table->restart[slot].started_at;
+		entry->cpu = table->cpu[slot];
+		entry->mem = table->mem[slot];
+		entry->log_read = table->line[slot]->log_read;
+		entry->log_write = table->line[slot]->log_write;
+		entry->state = table->state[slot];
+		entry->stopped = table->exit[slot].stopped;
+		entry->exit_code = table->exit[slot].code;
+		entry->exit_signal = table->exit[slot].signal;
+		entry->cpu_time = table->exit[slot].cpu_time;
+		entry->max_rss = table->exit[slot].max_rss;
+		entry->recent = restart->recent;
+		entry->crash_loop = restart->crash_loop;
+		entry->forced = restart->forced;
+		entry->window_start = restart->window_start;
+		entry->backoff = restart->backoff;
+		entry->due = restart->due;
+	}
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+	header.version = CHECKPOINT_VERSION;
+	header.count = count;
+	header.entry_size = sizeof(struct checkpoint_entry);
+	header.pid = getpid();
+	header.start_time = START_TIME;
+	char path[PATH_MAX];
+	struct iovec iov[2] = {
+		{&header, sizeof(header)},
+		{entries, sizeof(struct checkpoint_entry)*count}
+	};
+
+	snprintf(path, sizeof(path), "%s.tmp", CHECKPOINT_PATH);
+	int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+
+	if (fd == -1 || write_all(fd, iov, 2) == -1 || rename(path, CHECKPOINT_PATH) == -1)
+		warn("could not write the checkpoint %s", CHECKPOINT_PATH);
+	if (fd != -1)
+		close(fd);
+	free(entries);
+}
+
+/*
+ * load_checkpoint
+ * description:
+ *     reads the file of --checkpoint for --resume. the processes it
+ *     lists are adopted as their lines are launched, see adopt_launch.
+ *     the time limit goes on from when the checkpointed macD started.
+ *     after an upgrade the log pipes it lists are still open.
+ *     a missing or invalid checkpoint is not an error, every line is
+ *     started as usual.
+ * parameters:
+ *     path: the checkpoint file.
+ */
+void load_checkpoint(char *path)
+{
+	size_t size;
+	int mapped;
+	char *data = load_file(path, &size, &mapped);
+	struct checkpoint_header *header = (struct checkpoint_header *)data;
+
+	if (data == NULL) {
+		warn("could not read the checkpoint %s", path);
+		return;
+	}
+	if (size < sizeof(*header) ||
+	    memcmp(header->magic, CHECKPOINT_MAGIC, sizeof(header->magic)) != 0 ||
+	    header->version != CHECKPOINT_VERSION ||
+	    header->entry_size != sizeof(struct checkpoint_entry) ||
+	    size < sizeof(*header) + sizeof(struct checkpoint_entry)*header->count) {
+		fprintf(stderr, "macD: %s is not a checkpoint, starting every line\n", path);
+		unload_file(data, size, mapped);
+		return;
+	}
+	RESUME_LEN = header->count;
+	RESUME_START = header->start_time;
+	//written by this process before upgrade_supervisor executed it again
+	RESUME_EXEC = header->pid == getpid();
+	RESUME_ENTRIES = malloc(sizeof(struct checkpoint_entry)*(RESUME_LEN + 1));
+	memcpy(RESUME_ENTRIES, header + 1, sizeof(struct checkpoint_entry)*RESUME_LEN);
+	unload_file(data, size, mapped);
+}
+
+/*
+ * adopt_launch
+ * description:
+ *     with --resume, adopts the checkpointed process of the line of
+ *     launch instead of starting it, if the line has the same text and
+ *     the process is still running: same pid and same start time, so a
+ *     reused pid is never adopted. a process that is a child of macD,
+ *     after an upgrade, is reaped as usual. any other only has its exit
+ *     noticed, through a pidfd, see reap_adopted. after an upgrade the
+ *     line captures the output of the process again with the log pipe
+ *     it was given before.
+ * parameters:
+ *     launch: the launch of a line about to start.
+ * returns:
+ *     1 if the process was adopted, its pid is in launch.
+ *     0 if the line has to be started.
+ */
+int adopt_launch(struct launch *launch)
+{
+	int line_number = launch->line_number;
+
+	if (RESUME_ENTRIES == NULL)
+		return 0;
+	for (int i = 0; i < RESUME_LEN; i++) {
+		struct checkpoint_entry *entry = &RESUME_ENTRIES[i];
+		int parent = -1;
+
+		if (entry->line_number != line_number)
+			continue;
+		int pid = entry->pid;
+
+		entry->line_number = -1; //adopted at most once
+		if (entry->text_hash != hash_text(launch->line->text) ||
+		    (entry->state == PROC_RUNNING && get_start_ticks(pid, &parent) != entry->start_ticks)) {
+			release_log_pipe(entry);
+			return 0;
+		}
+		if (entry->state == PROC_RUNNING && parent != getpid()) {
+			int pidfd = syscall(SYS_pidfd_open, pid, 0);
+
+			if (pidfd == -1) {
+				release_log_pipe(entry);
+				return 0;
+			}
+			ADOPTED = realloc(ADOPTED, sizeof(struct pollfd)*(ADOPTED_LEN + 1));
+			ADOPTED_PIDS = realloc(ADOPTED_PIDS, sizeof(int)*(ADOPTED_LEN + 1));
+			ADOPTED[ADOPTED_LEN].fd = pidfd;
+			ADOPTED[ADOPTED_LEN].events = POLLIN;
+			ADOPTED_PIDS[ADOPTED_LEN++] = pid;
+			//lines started late, by spawn_rate or max_starting, are adopted in the event loop
+			if (EPOLL_FD != -1)
+				watch_fd(pidfd, EVENT_CHILD);
+		}
+		if (launch->line->log_path != NULL && inherited_log_pipe(entry) == 1) {
+			fcntl(entry->log_read, F_SETFD, FD_CLOEXEC);
+			fcntl(entry->log_write, F_SETFD, FD_CLOEXEC);
+			if (open_log(launch->line, entry->log_read, entry->log_write) == -1)
+				release_log_pipe(entry);
+			entry->log_read = -1;
+			entry->log_write = -1;
+		}
+		if (GROUP_MODE == GROUP_CGROUP) {
+			int group_fd;
+
+			launch->group = create_group(line_number, &group_fd);
+			//after a crash the process is still in the group of the macD that started it
+			if (group_fd != -1 && entry->state == PROC_RUNNING && RESUME_EXEC == 0)
+				dprintf(group_fd, "%d\n", pid);
+			if (group_fd != -1)
+				close(group_fd);
+		}
+		launch->pid = pid;
+		launch->fd = -1;
+		launch->spawn_time = 0;
+		launch->resumed = entry;
+		return 1;
+	}
+	return 0;
+}
+
+/*
+ * inherited_log_pipe
+ * description:
+ *     checks whether the log pipe of a checkpoint entry was kept open
+ *     by upgrade_supervisor across the exec of this process.
+ * parameters:
+ *     entry: the checkpoint entry.
+ * returns:
+ *     1 if both ends of the pipe are open in this process.
+ *     0 otherwise.
+ */
+int inherited_log_pipe(struct checkpoint_entry *entry)
+{
+	struct stat info;
+
+	if (RESUME_EXEC == 0 || entry->log_read < 0 || entry->log_write < 0)
+		return 0;
+	if (fstat(entry->log_read, &info) == -1 || !S_ISFIFO(info.st_mode) ||
+	    fstat(entry->log_write, &info) == -1 || !S_ISFIFO(info.st_mode))
+		return 0;
+	return 1;
+}
+
+/*
+ * release_log_pipe
+ * description:
+ *     closes the log pipe of a checkpoint entry that is not adopted,
+ *     if it was kept open across an upgrade.
+ * parameters:
+ *     entry: the checkpoint entry.
+ */
+void release_log_pipe(struct checkpoint_entry *entry)
+{
+	if (inherited_log_pipe(entry) == 1) {
+		close(entry->log_read);
+		close(entry->log_write);
+	}
+	entry->log_read = -1;
+	entry->log_write = -1;
+}
+
+/*
+ * resume_slot
+ * description:
+ *     gives the slot of an adopted process the restarts and last
+ *     sample it had, and displays that it was adopted.
+ * parameters:
+ *     table: the process table.
+ *     slot: the slot of the adopted process.
+ *     entry: its checkpoint entry.
+ */
+void resume_slot(struct proc_table *table, int slot, struct checkpoint_entry *entry)
+{
+	struct list_line *line = table->line[slot];
+
+	table->restart[slot].restarts = entry->restarts;
+	table->restart[slot].started_at = entry->started_at;
+	table->cpu[slot] = entry->cpu;
+	table->mem[slot] = entry->mem;
+	table->start_ticks[slot] = entry->start_ticks;
+	if (entry->state != PROC_RUNNING) {
+		struct restart_info *restart = &table->restart[slot];
+
+		table->state[slot] = entry->state;
+		table->exit[slot].stopped = entry->stopped;
+		table->exit[slot].code = entry->exit_code;
+		table->exit[slot].signal = entry->exit_signal;
+		table->exit[slot].cpu_time = entry->cpu_time;
+		table->exit[slot].max_rss = entry->max_rss;
+		restart->recent = entry->recent;
+		restart->crash_loop = entry->crash_loop;
+		restart->forced = entry->forced;
+		restart->window_start = entry->window_start;
+		restart->backoff = entry->backoff;
+		restart->due = entry->due;
+		if (GROUP_MODE == GROUP_PGID)
+			table->group_live[slot] = 0;
+		//init_event_loop arms the restart timer with NEXT_RESTART
+		if (entry->state == PROC_RESTARTING && (NEXT_RESTART == 0 || restart->due < NEXT_RESTART)) {
+			NEXT_RESTART = restart->due;
+			if (RESTART_TIMER_FD != -1)
+				set_timer(RESTART_TIMER_FD, TFD_TIMER_ABSTIME, NEXT_RESTART, 0);
+		}
+		if (OUTPUT_FORMAT == OUTPUT_TEXT)
+			out_printf("[%d] %s, resumed %s\n", table->line_number[slot], line->argv[0],
+				   entry->state == PROC_EXITED ? "exited" : "restarting");
+		return;
+	}
+	if (OUTPUT_FORMAT == OUTPUT_TEXT)
+		out_printf("[%d] %s, adopted (pid: %d)\n", table->line_number[slot], line->argv[0],
+			   table->pid[slot]);
+	else
+		display_started(table, slot, line, 0);
+}
+
+/*
+ * reap_adopted
+ * description:
+ *     reaps the adopted processes that are not children of macD and
+ *     exited, found by polling their pidfds. their exit status is not
+ *     known, their cpu time and peak memory are those of their last
+ *     sample.
+ * parameters:
+ *     table: the process table.
+ * returns:
+ *     the number of processes that were reaped.
+ */
+int reap_adopted(struct proc_table *table)
+{
+	int reaped = 0;
+
+	if (poll(ADOPTED, ADOPTED_LEN, 0) <= 0)
+		return 0;
+	for (int i = ADOPTED_LEN - 1; i >= 0; i--) {
+		if (ADOPTED[i].revents == 0)
+			continue;
+		int slot = find_slot(table, ADOPTED_PIDS[i]);
+
+		close(ADOPTED[i].fd);
+		ADOPTED_LEN--;
+		ADOPTED[i] = ADOPTED[ADOPTED_LEN];
+		ADOPTED_PIDS[i] = ADOPTED_PIDS[ADOPTED_LEN];
+		if (slot == -1 || table->state[slot] != PROC_RUNNING)
+			continue;
+		struct exit_info *exit = &table->exit[slot];
+
+		exit->code = -1;
+		exit->signal = -1;
+		exit->cpu_time = table->last_ticks[slot]/(double)CLOCK_TICKS;
+		exit->max_rss = table->mem[slot]*1024L;
+		table->state[slot] = PROC_EXITED;
+		close_proc_files(&table->files[slot]);
+		close_ready_fd(table, slot);
+		schedule_restart(table, slot);
+		reaped++;
+	}
+	return reaped;
+}
+
+/*
+ * upgrade_supervisor
+ * description:
+ *     writes a checkpoint and executes the macD file again with the
+ *     same arguments and --resume. macD keeps its pid so its children
+ *     stay its children and are adopted by the new image, which is how
+ *     a new build of macD is put in place without restarting anything.
+ *     the log pipes are kept open across the exec, their numbers are in
+ *     the checkpoint, so the new image goes on capturing the output.
+ * parameters:
+ *     table: the process table.
+ *     reply: where the answer is written if the upgrade failed.
+ */
+void upgrade_supervisor(struct proc_table *table, FILE *reply)
+{
+	int argc = 0;
+	int resume = 0;
+
+	if (CHECKPOINT_PATH == NULL) {
+		fprintf(reply, "error: upgrade requires --checkpoint\n");
+		return;
+	}
+	while (SAVED_ARGV[argc] != NULL) {
+		if (strcmp(SAVED_ARGV[argc], "--resume") == 0)
+			resume = 1;
+		argc++;
+	}
+	char **argv = malloc(sizeof(char *)*(argc + 2));
+
+	memcpy(argv, SAVED_ARGV, sizeof(char *)*argc);
+	argv[argc] = resume == 1 ? NULL : "--resume";
+	argv[argc + 1] = NULL;
+	write_checkpoint(table);
+	flush_logs();
+	flush_report();
+	fflush(reply);
+	set_log_cloexec(table->list, 0);
+	execvp(argv[0], argv);
+	set_log_cloexec(table->list, FD_CLOEXEC);
+	fprintf(reply, "error: could not execute %s: %s\n", argv[0], strerror(errno));
+	free(argv);
+}
+
+/*
+ * set_log_cloexec
+ * description:
+ *     sets the close on exec flag of both ends of every log pipe open
+ *     in a process list.
+ * parameters:
+ *     list: the process list.
+ *     flag: FD_CLOEXEC to close them on exec, 0 to keep them open.
+ */
+void set_log_cloexec(struct process_list *list, int flag)
+{
+	for (int i = 0; i < list->len; i++) {
+		if (list->lines[i].log_read == -1)
+			continue;
+		fcntl(list->lines[i].log_read, F_SETFD, flag);
+		fcntl(list->lines[i].log_write, F_SETFD, flag);
+	}
+}
+
+/*
+ * restart_process
+ * description:
+ *     starts the line of slot again in the same slot, in the same
+ *     cgroup with -g cgroup. if it fails to start the failure counts
+ *     as an exit and is scheduled to restart again.
+ * parameters:
+ *     table: the process table.
+ *     slot: the slot to restart.
+ */
+void restart_process(struct proc_table *table, int slot)
+{
+	struct list_line *line = table->line[slot];
+	int group_fd = -1;
+	int fd;
+
+	if (table->group[slot] != NULL)
+		group_fd = open_group_procs(table->group[slot]);
+	double t = get_monotonic_time();
+	int pid = create_process(line, group_fd, &fd);
+
+	if (group_fd != -1)
+		close(group_fd);
+	if (pid != -1)
+		pid = wait_for_exec(pid, fd);
+	table->restart[slot].restarts++;
+	if (pid < 0) {
+		display_failed(table->line_number[slot], line);
+		table->state[slot] = PROC_EXITED;
+		table->exit[slot].code = 127;
+		table->exit[slot].signal = -1;
+		schedule_restart(table, slot);
+		return;
+	}
+	change_pid(table, slot, pid);
+	table->state[slot] = PROC_RUNNING;
+	table->cpu[slot] = 0;
+	table->mem[slot] = 0;
+	table->next_sample[slot] = 0;
+	table->sample_interval[slot] = 0;
+	table->mem_tick[slot] = -1;
+	if (table->alert_since != NULL)
+		reset_alerts(table, slot);
+	memset(&table->exit[slot], 0, sizeof(struct exit_info));
+	table->restart[slot].started_at = get_monotonic_time();
+	initialize_slot(table, slot);
+	display_started(table, slot, line, table->restart[slot].started_at - t);
+}
+
+/*
+ * display_exit_info
+ * description:
+ *     displays how a process exited, its total cpu time
+ *     and its peak memory usage. processes stopped by shutdown_children
+ *     are shown as Terminated, or Killed if they outlived the grace period.
+ *     processes waiting to be restarted show when they restart.
+ * parameters:
+ *     table: the process table.
+ *     slot: the slot of the process in the process table.
+ */
+void display_exit_info(struct proc_table *table, int slot)
+{
+	struct exit_info *exit = &table->exit[slot];
+	struct restart_info *restart = &table->restart[slot];
+	char *states[] = {"exited", "terminated", "killed"};
+	char *titles[] = {"Exited", "Terminated", "Killed"};
+	char *state = states[exit->stopped];
+
+	if (table->state[slot] == PROC_RESTARTING)
+		state = "restarting";
+	if (OUTPUT_FORMAT == OUTPUT_JSON) {
+		out_printf("{\"type\":\"sample\",\"ts\":%.6f,\"slot\":%d,\"pid\":%d,\"line\":%d,"
+			   "\"state\":\"%s\",\"code\":%d,\"signal\":%d,\"cpu_time\":%.3f,"
+			   "\"max_rss_kb\":%ld,\"restarts\":%d,\"crash_loop\":%s}\n",
+			   REPORT_TIME, slot, table->pid[slot], table->line_number[slot],
+			   state, exit->code, exit->signal, exit->cpu_time, exit->max_rss,
+			   restart->restarts, restart->crash_loop ? "true" : "false");
+		return;
+	}
+	if (OUTPUT_FORMAT == OUTPUT_BINARY) {
+		write_record(exit->stopped == STOPPED_NONE ? RECORD_SAMPLE : RECORD_TERMINATED,
+			     table, slot, exit->stopped);
+		return;
+	}
+	if (exit->code != -1)
+		out_printf("[%d] %s (code %d", slot, titles[exit->stopped], exit->code);
+	else if (exit->signal != -1)
+		out_printf("[%d] %s (signal %d", slot, titles[exit->stopped], exit->signal);
+	else
+		out_printf("[%d] %s (status unknown", slot, titles[exit->stopped]);
+	out_printf(", %.1fs cpu, %ld MB peak)", exit->cpu_time, exit->max_rss/1024);
+	if (table->state[slot] == PROC_RESTARTING)
+		out_printf(", restarting in %.1fs", restart->due - get_monotonic_time());
+	else if (restart->crash_loop == 1)
+		out_printf(", crash loop, not restarted");
+	if (restart->restarts > 0)
+		out_printf(" (restarts: %d)", restart->restarts);
+	out_printf("\n");
+}
+
+/*
+ * display_history
+ * description:
+ *     displays the min, average, max and 95th percentile of the cpu
+ *     and memory usage of every process over the samples kept with -H.
+ * parameters:
+ *     table: the process table.
+ */
+void display_history(struct proc_table *table)
+{
+	if (table->history == NULL || OUTPUT_FORMAT == OUTPUT_BINARY)
+		return;
+	int *cpu = malloc(sizeof(int)*HISTORY_LEN);
+	int *mem = malloc(sizeof(int)*HISTORY_LEN);
+
+	if (OUTPUT_FORMAT == OUTPUT_TEXT)
+		out_printf("History of the last %d samples:\n", HISTORY_LEN);
+	for (int slot = 0; slot < table->len; slot++) {
+		struct history_slot *history = get_history(table, slot);
+		struct history_stats cpu_stats;
+		struct history_stats mem_stats;
+		int count = history->count;
+
+		if (count == 0)
+			continue;
+		for (int i = 0; i < count; i++) {
+			cpu[i] = history->samples[i].cpu;
+			mem[i] = history->samples[i].mem;
+		}
+		summarize_samples(cpu, count, &cpu_stats);
+		summarize_samples(mem, count, &mem_stats);
+		if (OUTPUT_FORMAT == OUTPUT_JSON) {
+			out_printf("{\"type\":\"history\",\"ts\":%.6f,\"slot\":%d,\"samples\":%d,"
+				   "\"cpu\":{\"min\":%d,\"avg\":%.1f,\"max\":%d,\"p95\":%d},"
+				   "\"mem_mb\":{\"min\":%d,\"avg\":%.1f,\"max\":%d,\"p95\":%d}}\n",
+				   REPORT_TIME, slot, count, cpu_stats.min, cpu_stats.avg, cpu_stats.max,
+				   cpu_stats.p95, mem_stats.min, mem_stats.avg, mem_stats.max,
+				   mem_stats.p95);
+			continue;
+		}
+		out_printf("[%d] cpu min/avg/max/p95: %d/%.1f/%d/%d%%, mem min/avg/max/p95: "
+			   "%d/%.1f/%d/%d MB (%d samples)\n", slot, cpu_stats.min, cpu_stats.avg,
+			   cpu_stats.max, cpu_stats.p95, mem_stats.min, mem_stats.avg, mem_stats.max,
+			   mem_stats.p95, count);
+	}
+	free(cpu);
+	free(mem);
+}
+
+/*
+ * summarize_samples
+ * description:
+ *     computes the min, average, max and 95th percentile of values.
+ *     values is sorted in place.
+ * parameters:
+ *     values: the values.
+ *     len: the number of values, at least 1.
+ *     stats: where the results are stored.
+ */
+void summarize_samples(int *values, int len, struct history_stats *stats)
+{
+	long total = 0;
+
+	qsort(values, len, sizeof(int), compare_ints);
+	for (int i = 0; i < len; i++)
+		total += values[i];
+	stats->min = values[0];
+	stats->max = values[len - 1];
+	stats->avg = (double)total/len;
+	stats->p95 = values[(95*len + 99)/100 - 1];
+}
+
+/*
+ * compare_ints
+ * description:
+ *     orders ints in ascending order for qsort.
+ * parameters:
+ *     a, b: pointers to the ints to compare.
+ * returns:
+ *     a negative number, 0 or a positive number if a is smaller than,
+ *     equal to, or larger than b.
+ */
+int compare_ints(const void *a, const void *b)
+{
+	int x = *(const int *)a;
+	int y = *(const int *)b;
+
+	return (x > y) - (x < y);
+}
+
+/*
+ * create_timer
+ * description:
+ *     creates a timerfd that becomes readable after the given
+ *     number of seconds, and then every interval seconds after that.
+ * parameters:
+ *     clock: the clock the timer is measured against.
+ *     flags: 0 for a relative timer or TFD_TIMER_ABSTIME.
+ *     seconds: when the timer first expires.
+ *     interval: the period of the timer, 0 for a one shot timer.
+ * returns:
+ *     the file descriptor of the timer.
+ */
+int create_timer(int clock, int flags, double seconds, double interval)
+{
+	int fd = timerfd_create(clock, TFD_CLOEXEC | TFD_NONBLOCK);
+
+	if (fd == -1)
+		err(1, "timerfd_create error");
+	set_timer(fd, flags, seconds, interval);
+	return fd;
+}
+
+/*
+ * set_timer
+ * description:
+ *     arms a timerfd created by create_timer.
+ * parameters:
+ *     fd: the file descriptor of the timer.
+ *     flags: 0 for a relative timer or TFD_TIMER_ABSTIME.
+ *     seconds: when the timer next expires.
+ *     interval: the period of the timer, 0 for a one shot timer.
+ */
+void set_timer(int fd, int flags, double seconds, double interval)
+{
+	struct itimerspec spec;
+
+	memset(&spec, 0, sizeof(spec));
+	spec.it_value.tv_sec = (time_t)seconds;
+	spec.it_value.tv_nsec = (long)((seconds - (time_t)seconds)*1e9);
+	spec.it_interval.tv_sec = (time_t)interval;
+	spec.it_interval.tv_nsec = (long)((interval - (time_t)interval)*1e9);
+	if (timerfd_settime(fd, flags, &spec, NULL) == -1)
+		err(1, "timerfd_settime error");
+}
+
+/*
+ * schedule_report
+ * description:
+ *     arms the report timer for the next report. reports are due on
+ *     a fixed grid of absolute CLOCK_MONOTONIC times REPORT_INTERVAL
+ *     apart, so the time a report takes does not push back the next one.
+ *     if macD fell behind by more than an interval the missed reports
+ *     are skipped instead of being run back to back.
+ * pre-conditions:
+ *     init_event_loop has been called.
+ */
+void schedule_report(void)
+{
+	double now = get_monotonic_time();
+
+	NEXT_REPORT += REPORT_INTERVAL;
+	if (NEXT_REPORT <= now)
+		NEXT_REPORT += ((long)((now - NEXT_REPORT)/REPORT_INTERVAL) + 1)*REPORT_INTERVAL;
+	set_timer(REPORT_TIMER_FD, TFD_TIMER_ABSTIME, NEXT_REPORT, 0);
+}
+
+/*
+ * watch_fd
+ * description:
+ *     adds fd to the event loop so wait_for_event wakes up
+ *     when it becomes readable.
+ * parameters:
+ *     fd: the file descriptor to watch.
+ *     event: the EVENT_* value wait_for_event returns for fd.
+ * pre-conditions:
+ *     init_event_loop has been called.
+ */
+void watch_fd(int fd, int event)
+{
+	struct epoll_event ev;
+
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.u64 = ((uint64_t)event << 32) | (uint32_t)fd;
+	if (epoll_ctl(EPOLL_FD, EPOLL_CTL_ADD, fd, &ev) == -1)
+		err(1, "epoll_ctl error");
+}
+
+/*
+ * init_event_loop
+ * description:
+ *     creates the epoll instance and registers the signal fd,
+ *     the report timer, the restart timer, disarmed until a restart
+ *     is scheduled, and, if a time limit is set, the deadline timer.
+ *     the first report after the normal report at startup is due
+ *     REPORT_INTERVAL seconds from now.
+ * pre-conditions:
+ *     register_handler has been called.
+ *     START_TIME and TARGET_TIME are set.
+ */
+void init_event_loop(void)
+{
+	EPOLL_FD = epoll_create1(EPOLL_CLOEXEC);
+	if (EPOLL_FD == -1)
+		err(1, "epoll_create error");
+	watch_fd(SIGNAL_FD, EVENT_SIGNAL);
+	NEXT_REPORT = get_monotonic_time() + REPORT_INTERVAL;
+	REPORT_TIMER_FD = create_timer(CLOCK_MONOTONIC, TFD_TIMER_ABSTIME, NEXT_REPORT, 0);
+	watch_fd(REPORT_TIMER_FD, EVENT_REPORT);
+	RESTART_TIMER_FD = create_timer(CLOCK_MONOTONIC, TFD_TIMER_ABSTIME, NEXT_RESTART, 0);
+	watch_fd(RESTART_TIMER_FD, EVENT_RESTART);
+	LAST_RESTART_TIME = get_monotonic_time();
+	if (CONTROL_FD != -1)
+		watch_fd(CONTROL_FD, EVENT_CONTROL);
+	if (PROC_EVENTS_FD != -1)
+		watch_fd(PROC_EVENTS_FD, EVENT_PROC);
+	for (int fd = 0; fd < LOG_LINES_LEN; fd++) {
+		if (LOG_LINES[fd] != NULL)
+			watch_fd(fd, EVENT_LOG);
+	}
+	for (int i = 0; i < ADOPTED_LEN; i++)
+		watch_fd(ADOPTED[i].fd, EVENT_CHILD);
+	LAUNCH_TIMER_FD = create_timer(CLOCK_MONOTONIC, TFD_TIMER_ABSTIME, NEXT_LAUNCH, 0);
+	watch_fd(LAUNCH_TIMER_FD, EVENT_LAUNCH);
+	if (TARGET_TIME != -1) {
+		double remaining = START_TIME + TARGET_TIME - NOW.realtime;
+
+		if (remaining <= 0)
+			remaining = 0.001;
+		DEADLINE_TIMER_FD = create_timer(CLOCK_MONOTONIC, 0, remaining, 0);
+		watch_fd(DEADLINE_TIMER_FD, EVENT_DEADLINE);
+	}
+}
+
+/*
+ * wait_for_event
+ * description:
+ *     sleeps until one of the fds registered with the event loop
+ *     becomes readable and consumes what made it readable.
+ *     a SIGINT sets KILL_STATE to 1.
+ * pre-conditions:
+ *     init_event_loop has been called.
+ * returns:
+ *     EVENT_REPORT if the report timer expired.
+ *     EVENT_DEADLINE if the time limit was reached.
+ *     EVENT_CHILD if a child changed state, or an adopted process exited.
+ *     EVENT_SIGNAL if SIGINT was received.
+ *     EVENT_GRACE if the grace period of shutdown_children is over.
+ *     EVENT_RESTART if a restart is due.
+ *     EVENT_CONTROL if a client connected to the control socket.
+ *     EVENT_LAUNCH if run_launches has work.
+ *     EVENT_READY if a process wrote to its ready=fd pipe.
+ *     EVENT_PROC if the kernel sent process events with -C netlink.
+ *     EVENT_LOG if a process wrote to its log, which is drained here.
+ *     EVENT_NONE if the wait was interrupted.
+ */
+int wait_for_event(void)
+{
+	struct epoll_event ev;
+	int ready = epoll_wait(EPOLL_FD, &ev, 1, -1);
+
+	if (ready == -1 && errno == EINTR)
+		return EVENT_NONE;
+	if (ready == -1)
+		err(1, "epoll_wait error");
+	int event = ev.data.u64 >> 32;
+	int fd = (int)(uint32_t)ev.data.u64;
+
+	if (event == EVENT_SIGNAL) {
+		int sig = read_signal();
+
+		if (sig == SIGCHLD)
+			return EVENT_CHILD;
+		if (sig != SIGINT)
+			return EVENT_NONE;
+		if (OUTPUT_FORMAT == OUTPUT_TEXT && KILL_STATE != 1)
+			out_printf("Signal Received - ");
+		KILL_STATE = 1;
+		return EVENT_SIGNAL;
+	}
+	if (event == EVENT_CONTROL || event == EVENT_READY || event == EVENT_PROC)
+		return event; //handled by handle_control, run_launches and handle_proc_events
+	if (event == EVENT_CHILD)
+		return event; //the pidfd of an adopted process, see reap_adopted
+	if (event == EVENT_LOG) {
+		drain_log(LOG_LINES[fd]);
+		return event;
+	}
+	uint64_t expirations;
+
+	if (read(fd, &expirations, sizeof(expirations)) == -1 && errno != EAGAIN)
+		err(1, "timer read error");
+	return event;
+}
+
+/*
+ * read_signal
+ * description:
+ *     reads the next pending signal from the signal fd.
+ * pre-conditions:
+ *     register_handler has been called.
+ * returns:
+ *     the number of the signal received or 0 if none was pending.
+ */
+int read_signal(void)
+{
+	struct signalfd_siginfo info;
+
+	if (read(SIGNAL_FD, &info, sizeof(info)) != sizeof(info))
+		return 0;
+	return info.ssi_signo;
+}
+
+/*
+ * register_handler
+ * description:
+ *     blocks SIGINT and SIGCHLD and creates the signal fd they
+ *     are read from, so the event loop can react to them.
+ */
+void register_handler(void)
+{
+	sigset_t mask;
+
+	sigemptyset(&mask);
+	sigaddset(&mask, SIGINT);
+	sigaddset(&mask, SIGCHLD);
+	if (sigprocmask(SIG_BLOCK, &mask, NULL) == -1)
+		err(1, "sigprocmask error");
+	SIGNAL_FD = signalfd(-1, &mask, SFD_CLOEXEC | SFD_NONBLOCK);
+	if (SIGNAL_FD == -1)
+		err(1, "signalfd error");
+}
+
+/*
+ * reset_child_signals
+ * description:
+ *     unblocks the signals blocked by register_handler.
+ *     called in a new child before exec so the child
+ *     does not inherit the blocked signal mask.
+ */
+void reset_child_signals(void)
 {
-	struct sigaction sa;
+	sigset_t mask;
 
-	memset(&sa, 0, sizeof(sa));
-	sa.sa_flags = 0;
-	sa.sa_handler = sig_handler;
-	if (sigaction(SIGINT, &sa, NULL) == -1)
-		err(1, "sigaction error");
+	sigemptyset(&mask);
+	sigprocmask(SIG_SETMASK, &mask, NULL);
 }
@@ -1,319 +1,3478 @@
+//value of list_line.nice when the line has no nice directive
+#define NICE_UNSET INT_MIN
+
+//identifies a sample history file written with -M, see history_header
+#define HISTORY_MAGIC "macDHIST"
+#define HISTORY_VERSION 1
+//identifies a checkpoint file written with --checkpoint, see checkpoint_header
+#define CHECKPOINT_MAGIC "macDCKPT"
+#define CHECKPOINT_VERSION 2
+
+/*
+ * event types returned by wait_for_event.
+ *     EVENT_NONE: nothing that needs handling happened.
+ *     EVENT_REPORT: the next normal report is due.
+ *     EVENT_DEADLINE: the time limit has been reached.
+ *     EVENT_CHILD: a child process changed state.
+ *     EVENT_SIGNAL: SIGINT was received.
+ *     EVENT_GRACE: the grace period of the shutdown is over.
+ *     EVENT_RESTART: a process is due to be restarted.
+ *     EVENT_CONTROL: a client connected to the control socket.
+ *     EVENT_LAUNCH: run_launches has lines to start or check.
+ *     EVENT_READY: a process wrote to its ready=fd pipe.
+ *     EVENT_PROC: the kernel sent process events, see handle_proc_events.
+ *     EVENT_LOG: a process wrote to its log pipe, see drain_log.
+ *     EVENT_ACCEPT: an instance is connecting to the aggregator.
+ *     EVENT_PEER: an instance sent records to the aggregator.
+ *     the last two are only used by run_aggregator.
+ */
+enum event_type {
+	EVENT_NONE,
+	EVENT_REPORT,
+	EVENT_DEADLINE,
+	EVENT_CHILD,
+	EVENT_SIGNAL,
+	EVENT_GRACE,
+	EVENT_RESTART,
+	EVENT_CONTROL,
+	EVENT_LAUNCH,
+	EVENT_READY,
+	EVENT_PROC,
+	EVENT_LOG,
+	EVENT_ACCEPT,
+	EVENT_PEER
+};
+
+/*
+ * when a process counts as ready, set with the ready= directive.
+ *     READY_EXEC: as soon as it has started.
+ *     READY_CPU: once it has used a cpu tick.
+ *     READY_FD: once it writes to or closes the pipe it gets as fd 3.
+ */
+enum ready_mode {
+	READY_EXEC,
+	READY_CPU,
+	READY_FD
+};
+
+/*
+ * launch states of a line of the process list, see run_launches.
+ *     LAUNCH_NONE: the line is not to be started.
+ *     LAUNCH_PENDING: the line waits to be started.
+ *     LAUNCH_STARTING: the process was started and is not ready yet.
+ *     LAUNCH_DONE: the process is ready, exited or failed to start.
+ */
+enum launch_state {
+	LAUNCH_NONE,
+	LAUNCH_PENDING,
+	LAUNCH_STARTING,
+	LAUNCH_DONE
+};
+
+/*
+ * spawn backends selectable with -s.
+ *     SPAWN_FORK: fork and execvp, the exec is confirmed later.
+ *     SPAWN_VFORK: vfork and execvp, the parent waits for the exec.
+ *     SPAWN_POSIX: posix_spawnp.
+ */
+enum spawn_backend {
+	SPAWN_FORK,
+	SPAWN_VFORK,
+	SPAWN_POSIX
+};
+
+/*
+ * states of a slot in the process table.
+ *     PROC_RUNNING: the process has been started and not yet reaped.
+ *     PROC_EXITED: the process has been reaped.
+ *     PROC_RESTARTING: the process has been reaped and will be
+ *                      restarted, see schedule_restart.
+ */
+enum proc_state {
+	PROC_RUNNING,
+	PROC_EXITED,
+	PROC_RESTARTING
+};
+
+/*
+ * restart policies of the restart directive, see read_directives.
+ *     RESTART_NEVER: the process is not restarted.
+ *     RESTART_ON_FAILURE: the process is restarted if it exits with
+ *                         a code other than 0 or is killed by a signal.
+ *     RESTART_ALWAYS: the process is restarted whenever it exits.
+ */
+enum restart_policy {
+	RESTART_NEVER,
+	RESTART_ON_FAILURE,
+	RESTART_ALWAYS
+};
+
+/*
+ * output formats selectable with -o.
+ *     OUTPUT_TEXT: the human readable reports.
+ *     OUTPUT_JSON: one JSON object per line, per process per report.
+ *     OUTPUT_BINARY: a stream of sample_record structures.
+ */
+enum output_format {
+	OUTPUT_TEXT,
+	OUTPUT_JSON,
+	OUTPUT_BINARY
+};
+
+/*
+ * types of sample_record.
+ *     RECORD_REPORT: a report starts, value is the tick.
+ *     RECORD_STARTED: a process was started, value is the spawn time in us.
+ *     RECORD_FAILED: a line of the process list failed to start.
+ *     RECORD_SAMPLE: the state of a process in a normal report.
+ *     RECORD_TERMINATED: a process stopped at shutdown, value is its STOPPED_* state.
+ *     RECORD_EXIT: macD is exiting, value is the total time in seconds.
+ *     RECORD_ALERT: an alert fired, value is the signal sent,
+ *                   -1 for a restart or 0 for a log alert.
+ *     RECORD_HELLO: the first record sent to the aggregator with -A,
+ *                   value is the shard index of the instance.
+ *     RECORD_REPORT_END: a normal report sent to the aggregator is
+ *                        complete, value is the tick.
+ */
+enum record_type {
+	RECORD_REPORT = 1,
+	RECORD_STARTED,
+	RECORD_FAILED,
+	RECORD_SAMPLE,
+	RECORD_TERMINATED,
+	RECORD_EXIT,
+	RECORD_ALERT,
+	RECORD_HELLO,
+	RECORD_REPORT_END
+};
+
+/*
+ * what an alert rule compares, see compile_alert.
+ *     ALERT_CPU: the cpu usage as a percent.
+ *     ALERT_MEM: the memory usage in MB.
+ */
+enum alert_metric {
+	ALERT_CPU,
+	ALERT_MEM
+};
+
+/*
+ * how an alert rule compares the sample with its threshold.
+ */
+enum alert_op {
+	ALERT_GT,
+	ALERT_GE,
+	ALERT_LT,
+	ALERT_LE
+};
+
+/*
+ * what an alert rule does when it fires.
+ *     ALERT_SIGNAL: sends its signal to the process.
+ *     ALERT_RESTART: stops the process with SIGTERM and restarts it.
+ *     ALERT_LOG: only displays the alert.
+ */
+enum alert_action {
+	ALERT_SIGNAL,
+	ALERT_RESTART,
+	ALERT_LOG
+};
+
+/*
+ * alert_rule
+ * description:
+ *     an alert directive compiled by compile_alert.
+ *     metric: the ALERT_* metric compared.
+ *     op: the ALERT_* comparison.
+ *     action: the ALERT_* action.
+ *     sig: the signal sent by ALERT_SIGNAL.
+ *     threshold: the value compared with, in the units of metric.
+ *     duration: how long, in seconds, the threshold must be crossed.
+ *     text: the rule as written in the process list.
+ */
+struct alert_rule {
+	uint8_t metric;
+	uint8_t op;
+	uint8_t action;
+	uint8_t sig;
+	int32_t threshold;
+	float duration;
+	char *text;
+};
+
+/*
+ * sample_record
+ * description:
+ *     a record of the binary output format, 64 bytes in host byte order.
+ *     fields that do not apply to a record are -1.
+ *     timestamp_ns: CLOCK_MONOTONIC time of the report, in nanoseconds.
+ *     type: the RECORD_* type.
+ *     state: the PROC_* state of the process.
+ *     slot: the slot of the process.
+ *     pid: the process id.
+ *     line_number: the line of the process list file.
+ *     cpu: the cpu usage as a percent.
+ *     mem: the memory usage in MB.
+ *     exit_code: the exit code if the process exited.
+ *     exit_signal: the signal that killed the process.
+ *     cpu_time_ms: the total cpu time of an exited process.
+ *     max_rss: the peak memory of an exited process, in KB.
+ *     restarts: the number of times the process was restarted.
+ *     value: depends on type.
+ */
+struct sample_record {
+	uint64_t timestamp_ns;
+	uint16_t type;
+	uint16_t state;
+	int32_t slot;
+	int32_t pid;
+	int32_t line_number;
+	int32_t cpu;
+	int32_t mem;
+	int32_t exit_code;
+	int32_t exit_signal;
+	int32_t cpu_time_ms;
+	int32_t max_rss;
+	uint32_t restarts;
+	int64_t value;
+};
+
+/*
+ * clock_snapshot
+ * description:
+ *     the time read once per iteration of the event loop, see update_clock.
+ *     monotonic: the CLOCK_MONOTONIC time in seconds.
+ *     realtime: the CLOCK_REALTIME time in seconds.
+ *     date_time: the realtime date was formatted for.
+ *     date: the formatted date of the reports, see get_date.
+ */
+struct clock_snapshot {
+	double monotonic;
+	time_t realtime;
+	time_t date_time;
+	char date[64];
+};
+
+/*
+ * replay_state
+ * description:
+ *     a virtual process of --replay, see replay_sample.
+ *     trace: the index of its trace in REPLAY_TRACES.
+ *     next: the sample of the trace it is at.
+ *     start: the virtual time it started at.
+ *     cpu_time: the cpu time, in seconds, its samples add up to.
+ *     max_mem: its peak memory in MB.
+ *     status: the wait status it exited with, -1 while it runs.
+ */
+struct replay_state {
+	int trace;
+	int next;
+	double start;
+	double cpu_time;
+	int max_mem;
+	int status;
+};
+
+/*
+ * shard_peer
+ * description:
+ *     an instance connected to the aggregator, indexed by its fd.
+ *     fd: the connection, or -1 once it closed.
+ *     index: the shard index from its RECORD_HELLO, or -1.
+ *     tick: the last normal report it fully sent, or -1.
+ *     buffered: the number of bytes in buffer.
+ *     buffer: the start of a record the last read cut off.
+ */
+struct shard_peer {
+	int fd;
+	int index;
+	int tick;
+	int buffered;
+	char buffer[sizeof(struct sample_record)];
+};
+
+/*
+ * fleet_line
+ * description:
+ *     the state of a line of the process list across the fleet.
+ *     record: the last record about the line, its type is 0 if none.
+ *     shard: the shard index of the instance that sent it.
+ */
+struct fleet_line {
+	struct sample_record record;
+	int shard;
+};
+
+/*
+ * bench_result
+ * description:
+ *     the measurements of one run of measure_benchmark,
+ *     times are in seconds.
+ *     processes: the number of processes asked for.
+ *     started: the number of processes that were started.
+ *     launch_time: the time read_file took to start them all.
+ *     sample_time: the total time of the BENCH_PASSES sampling passes.
+ *     tick_p50, tick_p99: percentiles of the time of one pass.
+ *     sample_p50, sample_p99: percentiles of the time to sample
+ *                             a single process.
+ *     report_time: the total time to format and write the reports.
+ *     kill_time: the time shutdown_children took.
+ *     table_bytes: the memory of the process table per process.
+ */
+struct bench_result {
+	int processes;
+	int started;
+	double launch_time;
+	double sample_time;
+	double tick_p50;
+	double tick_p99;
+	double sample_p50;
+	double sample_p99;
+	double report_time;
+	double kill_time;
+	long table_bytes;
+};
+
+/*
+ * out_chunk
+ * description:
+ *     a block of the output buffer.
+ *     capacity: the size of data.
+ *     len: the number of bytes of data in use.
+ *     data: the buffered output.
+ */
+struct out_chunk {
+	size_t capacity;
+	size_t len;
+	char data[];
+};
+
+/*
+ * report_buffer
+ * description:
+ *     everything macD writes to stdout, collected until flush_report.
+ *     chunks: the blocks of the buffer, kept between flushes.
+ *     num_chunks: the number of allocated chunks.
+ *     used: the number of chunks holding output.
+ */
+struct report_buffer {
+	struct out_chunk **chunks;
+	int num_chunks;
+	int used;
+};
+
+/*
+ * memory metrics selectable with -m, see get_mem_usage.
+ */
+enum mem_metric {
+	MEM_RSS,
+	MEM_PSS,
+	MEM_USS,
+	MEM_HWM
+};
+
+/*
+ * collectors selectable with -C.
+ *     COLLECT_PROC: every process is sampled from its /proc files.
+ *     COLLECT_NETLINK: the cpu of every process is queried in batches
+ *                      from taskstats and the kernel reports when
+ *                      processes fork, exec and exit. needs CAP_NET_ADMIN,
+ *                      falls back to COLLECT_PROC without it.
+ */
+enum collector {
+	COLLECT_PROC,
+	COLLECT_NETLINK
+};
+
+/*
+ * group modes selectable with -g.
+ *     GROUP_NONE: only the started process is sampled and killed.
+ *     GROUP_PGID: each line runs in its own process group, which is
+ *                 killed as a whole.
+ *     GROUP_CGROUP: each line runs in its own cgroup v2, the cpu and
+ *                   memory of the cgroup are reported and it is killed
+ *                   as a whole.
+ */
+enum group_mode {
+	GROUP_NONE,
+	GROUP_PGID,
+	GROUP_CGROUP
+};
+
+/*
+ * how a process that exited was stopped.
+ *     STOPPED_NONE: it exited on its own.
+ *     STOPPED_TERM: it was sent SIGTERM at shutdown.
+ *     STOPPED_KILL: it was still running after the grace period
+ *                   and was sent SIGKILL.
+ */
+enum stop_reason {
+	STOPPED_NONE,
+	STOPPED_TERM,
+	STOPPED_KILL
+};
+
+/*
+ * list_line
+ * description:
+ *     a line of the process list file split into its arguments.
+ *     line_number: the index of the line in the file.
+ *     text: the line as it appears in the file.
+ *     argc: the number of arguments.
+ *     argv: the arguments, followed by NULL.
+ *     restart: the RESTART_* policy of the line.
+ *     limits: 1 if any of the limits below is set, see apply_limits.
+ *     cpus: the cpus directive, or NULL.
+ *     numa: the numa directive, or NULL.
+ *     nice: the nice directive, or NICE_UNSET.
+ *     rlimit_as: the rlimit_as directive in bytes, or -1.
+ *     priority: the priority directive, 0 by default.
+ *     after: the after directive, or -1.
+ *     ready: the READY_* mode of the ready directive.
+ *     invalid: 1 if the line has an invalid directive or no program.
+ *     launch: the LAUNCH_* state of the line.
+ *     slot: the slot the line was started in, or -1.
+ *     launch_time: the monotonic time the line was started at.
+ *     ready_fd: the read end of the ready=fd pipe, or -1.
+ *     notify_fd: the write end of the ready=fd pipe while it is
+ *                being started, or -1.
+ *     alerts: the compiled alert directives, or NULL.
+ *     num_alerts: the number of alerts.
+ *     log_path: the log directive, or NULL.
+ *     host: the host directive, or NULL.
+ *     log_size: the log_size directive in bytes.
+ *     log_read: the end of the log pipe macD drains, or -1 until the
+ *               log is opened.
+ *     log_write: the end of the log pipe the processes write to, or -1.
+ *     log_fd: the log file, or -1.
+ *     log_written: the size of the log file.
+ *     removed: 1 if a reload removed the line while its process ran,
+ *              see release_removed.
+ */
+struct list_line {
+	int line_number;
+	char *text;
+	int argc;
+	char **argv;
+	int restart;
+	int limits;
+	cpu_set_t *cpus;
+	cpu_set_t *numa;
+	int nice;
+	long rlimit_as;
+	int priority;
+	int after;
+	int ready;
+	int invalid;
+	int launch;
+	int slot;
+	double launch_time;
+	int ready_fd;
+	int notify_fd;
+	struct alert_rule *alerts;
+	int num_alerts;
+	char *log_path;
+	char *host;
+	long log_size;
+	int log_read;
+	int log_write;
+	int log_fd;
+	long log_written;
+	int removed;
+};
+
+/*
+ * process_list
+ * description:
+ *     every line of a process list file, see parse_process_buffer.
+ *     len: the number of lines.
+ *     lines: the parsed lines.
+ *     arena: holds the text and arguments of every line.
+ *     args: holds the argv of every line.
+ *     next: the next retired list, see release_removed.
+ *     users: the slots still using a removed line of a retired list.
+ */
+struct process_list {
+	int len;
+	struct list_line *lines;
+	char *arena;
+	char **args;
+	struct process_list *next;
+	int users;
+};
+
+/*
+ * launch
+ * description:
+ *     a line of the process list that has been started by read_file
+ *     but not yet reported.
+ *     line: the parsed line from the file.
+ *     line_number: the index of the line in the file.
+ *     pid: the pid of the created process or -1 if none was created.
+ *     fd: the pipe to pass to wait_for_exec.
+ *     group: the cgroup of the process with -g cgroup, NULL otherwise.
+ *     spawn_time: the time, in seconds, the parent spent creating the process.
+ *     slot: the slot the process was given, -1 if it failed to start.
+ *     resumed: the checkpoint entry of the process if adopt_launch
+ *              adopted it instead of starting it, NULL otherwise.
+ */
+struct launch {
+	struct list_line *line;
+	int line_number;
+	int pid;
+	int fd;
+	char *group;
+	double spawn_time;
+	int slot;
+	struct checkpoint_entry *resumed;
+};
+
+/*
+ * proc_files
+ * description:
+ *     the /proc files of a process that are kept open between reports.
+ *     pid: the process id the files belong to.
+ *     dir_fd: /proc/[pid], the other files are opened relative to it.
+ *     stat_fd: /proc/[pid]/stat.
+ *     mem_fd: the file of the memory metric, see get_mem_usage.
+ *     group: the cgroup the process is sampled from with -g cgroup,
+ *            see open_group_files, NULL otherwise.
+ *     cached: 1 if the files are kept open, 0 if they are opened
+ *             by path each time they are read.
+ *     any fd that is not open is -1.
+ */
+struct proc_files {
+	int pid;
+	char *group;
+	int cached;
+	int dir_fd;
+	int stat_fd;
+	int mem_fd;
+};
+
+/*
+ * self_usage
+ * description:
+ *     the usage of macD itself at the last report, see display_overhead.
+ *     files: the /proc files of macD.
+ *     cpu_usec: the cpu time used, in microseconds.
+ *     time: the monotonic time of the last report.
+ *     syscalls: SAMPLER_SYSCALLS at the last report.
+ *     opens: SAMPLER_OPENS at the last report.
+ */
+struct self_usage {
+	struct proc_files files;
+	long cpu_usec;
+	double time;
+	long syscalls;
+	long opens;
+};
+
+/*
+ * exit_info
+ * description:
+ *     how a child process exited, recorded when it is reaped.
+ *     code: the exit code or -1 if the process was killed by a signal.
+ *     signal: the signal that killed the process or -1.
+ *     cpu_time: the total user and system time, in seconds.
+ *     max_rss: the peak resident memory, in KB.
+ *     stopped: how shutdown_children stopped the process, see stop_reason.
+ */
+struct exit_info {
+	int code;
+	int signal;
+	double cpu_time;
+	long max_rss;
+	int stopped;
+};
+
+/*
+ * restart_info
+ * description:
+ *     the restart state of a slot, see schedule_restart.
+ *     restarts: the number of times the slot was restarted.
+ *     recent: the restarts since window_start.
+ *     crash_loop: 1 if the slot restarted too often and was given up on.
+ *     started_at: the monotonic time the process was last started.
+ *     window_start: the start of the window recent is counted over.
+ *     backoff: the delay before the last restart, in seconds.
+ *     due: the monotonic time of the next restart.
+ *     forced: 1 if the process was stopped by an alert to be restarted.
+ *     kill_due: the monotonic time a process removed by a reload is
+ *               sent SIGKILL, 0 if it is not being stopped.
+ */
+struct restart_info {
+	int restarts;
+	int recent;
+	int crash_loop;
+	double started_at;
+	double window_start;
+	double backoff;
+	double due;
+	int forced;
+	double kill_due;
+};
+
+/*
+ * history_header
+ * description:
+ *     the start of the sample history kept with -H, and of the
+ *     file written with -M. followed by slots blocks of block_size
+ *     bytes, each a history_slot. all fields are in host byte order.
+ *     magic: HISTORY_MAGIC, not NUL terminated.
+ *     version: HISTORY_VERSION.
+ *     length: the number of samples kept per slot.
+ *     slots: the number of blocks that follow.
+ *     block_size: the size of each block.
+ *     realtime_offset: added to the time of a sample gives the
+ *                      CLOCK_REALTIME time it was taken at.
+ */
+struct history_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t length;
+	uint32_t slots;
+	uint32_t block_size;
+	double realtime_offset;
+};
+
+/*
+ * checkpoint_header
+ * description:
+ *     the start of the file written with --checkpoint, followed by
+ *     count checkpoint_entry. all fields are in host byte order.
+ *     magic: CHECKPOINT_MAGIC, not NUL terminated.
+ *     version: CHECKPOINT_VERSION.
+ *     count: the number of entries that follow.
+ *     entry_size: the size of each entry.
+ *     pid: the process id of the macD that wrote it.
+ *     start_time: the CLOCK_REALTIME time macD started at.
+ */
+struct checkpoint_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t count;
+	uint32_t entry_size;
+	int32_t pid;
+	double start_time;
+};
+
+/*
+ * checkpoint_entry
+ * description:
+ *     a slot in the file written with --checkpoint.
+ *     pid: the id of its process, running or not.
+ *     line_number: the line it runs.
+ *     text_hash: hash_text of the text of the line.
+ *     restarts: the number of times the line was restarted.
+ *     start_ticks: when the process started, see get_start_ticks.
+ *     started_at: the CLOCK_MONOTONIC time it was started at.
+ *     cpu: its last cpu usage sample.
+ *     mem: its last memory usage sample.
+ *     log_read, log_write: the ends of the log pipe of its line in the
+ *                          macD that wrote it, -1 without a log.
+ *     state: the proc_state of the slot.
+ *     stopped, exit_code, exit_signal, cpu_time, max_rss: its exit_info,
+ *         once it exited.
+ *     recent, crash_loop, forced, window_start, backoff, due: its
+ *         restart_info.
+ */
+struct checkpoint_entry {
+	int32_t pid;
+	int32_t line_number;
+	uint32_t text_hash;
+	int32_t restarts;
+	uint64_t start_ticks;
+	double started_at;
+	int32_t cpu;
+	int32_t mem;
+	int32_t log_read;
+	int32_t log_write;
+	int32_t state;
+	int32_t stopped;
+	int32_t exit_code;
+	int32_t exit_signal;
+	double cpu_time;
+	int64_t max_rss;
+	int32_t recent;
+	int32_t crash_loop;
+	int32_t forced;
+	double window_start;
+	double backoff;
+	double due;
+};
+
+/*
+ * history_sample
+ * description:
+ *     a sample in the history of a process.
+ *     time: the CLOCK_MONOTONIC time of the sample, in seconds.
+ *     cpu: the cpu usage as a percent.
+ *     mem: the memory usage in MB.
+ */
+struct history_sample {
+	double time;
+	int32_t cpu;
+	int32_t mem;
+};
+
+/*
+ * history_slot
+ * description:
+ *     the history of the process in one slot, a ring of samples.
+ *     pid: the process id, the latest one if it was restarted.
+ *     line_number: the line of the process list file.
+ *     count: the number of samples in use, at most length.
+ *     next: the sample the next one is stored in, the oldest
+ *           once count is length.
+ *     samples: the ring of length samples.
+ */
+struct history_slot {
+	int32_t pid;
+	int32_t line_number;
+	uint32_t count;
+	uint32_t next;
+	struct history_sample samples[];
+};
+
+/*
+ * history_stats
+ * description:
+ *     the summary of a series of samples, see summarize_samples.
+ */
+struct history_stats {
+	int min;
+	double avg;
+	int max;
+	int p95;
+};
+
+/*
+ * proc_table
+ * description:
+ *     the table of every process started by macD, stored as one array
+ *     per field. a process keeps the same slot, its index in all of the
+ *     arrays, for as long as macD runs.
+ *     len: the number of slots in use.
+ *     capacity: the number of slots the arrays have room for.
+ *     pid: the process id in each slot.
+ *     line_number: the line of the process list file of each slot.
+ *     command: the line of the process list file of each slot.
+ *     last_ticks: the cpu ticks of each slot at the previous report.
+ *     last_sample: the monotonic time each slot was last sampled at.
+ *     next_sample: the tick each slot is next sampled at with -a.
+ *     sample_interval: the ticks between samples of each slot with -a,
+ *                      0 before its first sample.
+ *     mem_tick: the tick the memory of each slot was last read at,
+ *               -1 before the first read.
+ *     group: the path of the cgroup of each slot with -g cgroup, or NULL.
+ *     line: the line of the process list of each slot.
+ *     restart: the restart state of each slot.
+ *     cpu: the cpu usage, as a percent, of each slot at the last sample.
+ *     mem: the memory usage, in MB, of each slot at the last sample.
+ *     due: scratch list of the slots to sample in the current report.
+ *     state: the PROC_* state of each slot.
+ *     exit: how the process in each slot exited.
+ *     files: the open /proc files of each slot.
+ *     hash: open addressing hash from pid to slot, -1 marks an empty position.
+ *     hash_capacity: the number of positions in hash, a power of 2.
+ *     hash_used: the number of positions in use, see change_pid.
+ *     tick: the report being sampled, see schedule_sample.
+ *     list: the process list the table was started from.
+ *     history: the sample history with -H, or NULL, see grow_history.
+ *     history_size: the size of history in bytes.
+ *     history_fd: the file history is mapped from with -M, or -1.
+ *     launch_order: the indices of the lines of list in the order they
+ *                   start in, see launch_lines.
+ *     launch_len: the length of launch_order.
+ *     launch_next: the first entry of launch_order that may still be pending.
+ *     starting: the indices of the lines that are LAUNCH_STARTING.
+ *     starting_len: the length of starting.
+ *     pending: the number of lines that are pending or starting.
+ *     alert_since: MAX_ALERTS entries per slot, when each alert of its
+ *                  line started crossing its threshold, 0 if it is not
+ *                  and -1 once it fired. NULL if no line has an alert.
+ *     batch_cpu: with -C netlink, the cpu ticks collect_taskstats read
+ *                for each slot and sample_process has not used yet, or -1.
+ *     exiting: with -C netlink, 1 if the process of the slot exited and
+ *              is not reaped yet.
+ *     replay: with --replay, the replay_state of each slot, or NULL.
+ *     start_ticks: with --checkpoint, when each process started, see
+ *                  get_start_ticks, 0 until it is read.
+ *     group_live: with -g pgid, 0 once the process group of each slot
+ *                 was found empty after its leader exited, see group_alive.
+ *     retired: the process lists replaced by a reload that still have
+ *              slots using their removed lines, see release_removed.
+ */
+struct proc_table {
+	int len;
+	int capacity;
+	int *pid;
+	int *line_number;
+	char **command;
+	int *last_ticks;
+	double *last_sample;
+	int *next_sample;
+	int *sample_interval;
+	int *mem_tick;
+	char **group;
+	struct list_line **line;
+	struct restart_info *restart;
+	int *cpu;
+	int *mem;
+	int *due;
+	int *state;
+	struct exit_info *exit;
+	struct proc_files *files;
+	int *hash;
+	int hash_capacity;
+	int hash_used;
+	int tick;
+	struct process_list *list;
+	void *history;
+	size_t history_size;
+	int history_fd;
+	int *launch_order;
+	int launch_len;
+	int launch_next;
+	int *starting;
+	int starting_len;
+	int pending;
+	double *alert_since;
+	int *batch_cpu;
+	int *exiting;
+	struct replay_state *replay;
+	uint64_t *start_ticks;
+	int *group_live;
+	struct process_list *retired;
+};
+
+/*
+ * sampler_worker
+ * description:
+ *     a thread of the sampler pool.
+ *     pool: the pool the thread belongs to.
+ *     index: the chunk of the slots the thread samples.
+ *     thread: the id of the thread, unused for index 0 which is
+ *             the thread calling run_sampler_pool.
+ */
+struct sampler_worker {
+	struct sampler_pool *pool;
+	int index;
+	pthread_t thread;
+};
+
+/*
+ * sampler_pool
+ * description:
+ *     threads that sample chunks of the process table in parallel.
+ *     threads: the number of threads, including the calling thread.
+ *     workers: one sampler_worker per thread.
+ *     lock: protects generation and remaining.
+ *     work_ready: signalled when generation changes.
+ *     work_done: signalled when remaining reaches 0.
+ *     generation: incremented each time work is handed out.
+ *     remaining: the number of sampler threads still sampling.
+ *     table, slots, num_slots: the current work,
+ *     see run_sampler_pool.
+ */
+struct sampler_pool {
+	int threads;
+	struct sampler_worker *workers;
+	pthread_mutex_t lock;
+	pthread_cond_t work_ready;
+	pthread_cond_t work_done;
+	int generation;
+	int remaining;
+	struct proc_table *table;
+	int *slots;
+	int num_slots;
+};
+
+/*
+ * parse_spawn_backend
+ * description:
+ *     converts the name of a spawn backend given with -s
+ *     to its SPAWN_* value.
+ * parameters:
+ *     name: "fork", "vfork" or "spawn".
+ * returns:
+ *     the SPAWN_* value of name.
+ *     -1 if name is not a spawn backend.
+ */
+int parse_spawn_backend(char *name);
+
+/*
+ * load_file
+ * description:
+ *     maps the whole file into memory. if the file cannot be mapped,
+ *     for example because it is a pipe, it is read in large blocks
+ *     into a buffer instead.
+ * parameters:
+ *     file_path: string of the path to the file to load.
+ *     out_size: set to the size of the file.
+ *     out_mapped: set to 1 if the file was mapped, 0 if it was read.
+ * returns:
+ *     the contents of the file, to be released with unload_file.
+ *     NULL if the file could not be opened.
+ */
+char *load_file(char *file_path, size_t *out_size, int *out_mapped);
+
+/*
+ * unload_file
+ * description:
+ *     releases the contents of a file loaded by load_file.
+ * parameters:
+ *     data: the contents returned by load_file.
+ *     size: the size set by load_file.
+ *     mapped: the value of out_mapped set by load_file.
+ */
+void unload_file(char *data, size_t size, int mapped);
+
+/*
+ * parse_process_list
+ * description:
+ *     reads the process list file and splits every line into its
+ *     arguments, see parse_process_buffer.
+ * parameters:
+ *     file_path: string of the path to the file to read.
+ * returns:
+ *     the parsed process list, to be freed with free_process_list.
+ *     NULL if the file could not be opened.
+ */
+struct process_list *parse_process_list(char *file_path);
+
+/*
+ * parse_process_buffer
+ * description:
+ *     splits buffer into lines and every line into its arguments in a
+ *     single pass. arguments are separated by any amount of spaces or
+ *     tabs, and can be quoted with '' or "" to contain whitespace.
+ *     outside of '' a backslash makes the next character literal.
+ *     the text and the arguments of every line are copied into one
+ *     arena, so the whole list is freed at once.
+ * parameters:
+ *     buffer: the contents of a process list file.
+ *     size: the length of buffer.
+ * returns:
+ *     the parsed process list, to be freed with free_process_list.
+ */
+struct process_list *parse_process_buffer(const char *buffer, size_t size);
+
+/*
+ * copy_argument
+ * description:
+ *     copies the argument starting at text[i] to *cursor, removing
+ *     its quotes and escapes, and NUL terminates it.
+ * parameters:
+ *     text: the line the argument is in.
+ *     len: the length of text.
+ *     i: the index of the first character of the argument.
+ *     cursor: where to copy the argument to, moved past its NUL.
+ * returns:
+ *     the index in text just after the argument.
+ */
+size_t copy_argument(const char *text, size_t len, size_t i, char **cursor);
+
+/*
+ * free_process_list
+ * description:
+ *     frees a process list created by parse_process_buffer.
+ * parameters:
+ *     list: the process list to free.
+ */
+void free_process_list(struct process_list *list);
+
+/*
+ * create_process
+ * description:
+ *     creates a new process running args using the SPAWN_BACKEND
+ *     selected on the command line.
+ *     for the fork and vfork backends the child is given the write end
+ *     of a close-on-exec pipe, it writes errno to the pipe only if the
+ *     exec fails. the fork backend does not wait for the exec,
+ *     see wait_for_exec.
+ *     the spawn backend reports a failed exec directly. posix_spawnp
+ *     cannot apply the limits of a line, see apply_limits, or pass
+ *     the pipes of ready=fd and log=, so such lines use the vfork
+ *     backend instead.
+ *     with a log directive the output of the process goes to the log
+ *     pipe of its line, opened by open_log the first time it starts.
+ *     with --replay nothing is created, the process is virtual.
+ * parameters:
+ *     line: the line of the process list to run.
+ *     group_fd: the cgroup.procs file of the cgroup of the process, or -1.
+ *     out_fd: set to the read end of the pipe for wait_for_exec
+ *             or -1 if there is nothing to wait for.
+ * pre-conditions:
+ *     line is initialized.
+ * returns:
+ *     the pid of the new process.
+ *     -1 if the process could not be created or its log not opened.
+ */
+int create_process(struct list_line *line, int group_fd, int *out_fd);
+
+/*
+ * pass_notify_fd
+ * description:
+ *     gives a new process the write end of its ready=fd pipe as fd
+ *     READY_NOTIFY_FD, kept open across its exec. called before exec.
+ * parameters:
+ *     fd: the write end of the pipe.
+ */
+void pass_notify_fd(int fd);
+
+/*
+ * apply_limits
+ * description:
+ *     applies the cpus, nice, rlimit_as and numa directives of line
+ *     to the calling process. called in a new process before its exec,
+ *     only makes system calls so it is safe after vfork.
+ * parameters:
+ *     line: the line of the process list being started.
+ * returns:
+ *     0 on success.
+ *     -1 if a limit could not be applied, with errno set.
+ */
+int apply_limits(struct list_line *line);
+
+/*
+ * open_log
+ * description:
+ *     opens the log of a line with a log directive: the file at its
+ *     path, appended to if it exists, and a pipe the processes of the
+ *     line write their stdout and stderr to. macD keeps both ends of
+ *     the pipe, so restarts of the line share it and an exited process
+ *     never closes it, and drains it with drain_log when it is readable.
+ *     a process adopted after an upgrade brings the pipe macD had before.
+ * parameters:
+ *     line: the line to open the log of.
+ *     read_fd, write_fd: the ends of the pipe to use, -1 to create one.
+ * returns:
+ *     0 on success.
+ *     -1 if the log could not be opened, with a warning displayed.
+ */
+int open_log(struct list_line *line, int read_fd, int write_fd);
+
+/*
+ * drain_log
+ * description:
+ *     moves everything waiting in the log pipe of line to its log file
+ *     with splice, so the output never passes through macD's memory.
+ *     once the file reaches the log_size of the line it is rotated:
+ *     renamed to [path].1, replacing the previous one, and a new file
+ *     is started.
+ * parameters:
+ *     line: the line to drain the log of.
+ */
+void drain_log(struct list_line *line);
+
+/*
+ * rotate_log
+ * description:
+ *     renames the log file of line to [path].1 and opens a new one.
+ *     if the new file cannot be opened the log continues in the
+ *     renamed one.
+ * parameters:
+ *     line: the line to rotate the log of.
+ */
+void rotate_log(struct list_line *line);
+
+/*
+ * close_log
+ * description:
+ *     drains what is left in the log pipe of line and closes its log.
+ * parameters:
+ *     line: the line to close the log of.
+ */
+void close_log(struct list_line *line);
+
+/*
+ * flush_logs
+ * description:
+ *     drains the log pipe of every line, called before macD exits so
+ *     the last output of the processes reaches their logs.
+ */
+void flush_logs(void);
+
+/*
+ * spawn_posix
+ * description:
+ *     creates a new process running args with posix_spawnp.
+ *     the signal mask of the new process is cleared.
+ *     posix_spawnp has no way to join a cgroup before the exec, so with
+ *     -g cgroup the process is moved into its cgroup right after it.
+ * parameters:
+ *     args: NULL terminated list of the program and its arguments.
+ *     group_fd: the cgroup.procs file of the cgroup of the process, or -1.
+ * pre-conditions:
+ *     args is initialized and args[0] is not NULL.
+ * returns:
+ *     the pid of the new process.
+ *     -1 if the process could not be created or failed to exec.
+ */
+int spawn_posix(char **args, int group_fd);
+
+/*
+ * wait_for_exec
+ * description:
+ *     waits until the process created by create_process has either
+ *     exec'd, which closes the pipe, or failed to exec, in which case
+ *     the child wrote its errno to the pipe.
+ *     failed processes are reaped.
+ * parameters:
+ *     pid: the pid returned by create_process.
+ *     fd: the pipe returned by create_process, closed by this function.
+ *         if fd is -1 the process has already exec'd.
+ * returns:
+ *     pid if the process was started successfully.
+ *     -1 otherwise.
+ */
+int wait_for_exec(int pid, int fd);
+
+/*
+ * convert_str_to_int
+ * description:
+ *     converts the given string to its integer form
+ * parameters:
+ *     str: the string to convert to an integer.
+ * pre-condition:
+ *     str is initialized.
+ * returns:
+ *     integer form of str if str is numeric.
+ *     -1 otherwise.
+ */
+int convert_str_to_int(char *str);
+
+/*
+ * read_timer
+ * description:
+ *     checks if the given line indicates a timer.
+ *     if the line is in the form "timelimit [integer]" then
+ *     [integer] is returned.
+ * parameters:
+ *     line: line to check if its a timer.
+ * returns:
+ *     the value of the time limit if the given line is a timer.
+ *     -1 otherwise.
+ */
+int read_timer(struct list_line *line);
+
+/*
+ * read_directives
+ * description:
+ *     removes the directives at the start of a line of the process list
+ *     and stores them in the line. a directive is an argument of the
+ *     form "[name]=[value]" placed before the program, for example
+ *     "restart=on-failure ./server -p 80".
+ *     directives:
+ *         restart=always|on-failure|never: restart the process when it
+ *         exits, see schedule_restart. defaults to never.
+ *         cpus=[list]: the cpus the process may run on, e.g. 0-3,8.
+ *         nice=[n]: the nice value of the process.
+ *         rlimit_as=[size]: the limit on the address space of the
+ *         process in bytes, or with a K, M or G suffix.
+ *         numa=[list]: the NUMA nodes the process allocates memory from.
+ *         priority=[n]: the tier the line starts in, see run_launches.
+ *         after=[line]: the line number the line waits for to be ready.
+ *         ready=exec|cpu|fd: when the process counts as ready, see
+ *         update_starting. defaults to exec.
+ *         alert=[rule]: an action taken when the usage of the process
+ *         crosses a threshold, see compile_alert. up to MAX_ALERTS.
+ *         log=[path]: the file the stdout and stderr of the process
+ *         are written to instead of macD's stdout, see open_log.
+ *         log_size=[size]: the size the log is rotated at, in bytes or
+ *         with a K, M or G suffix. defaults to LOG_SIZE.
+ *         host=[name]: the instance the line runs on, see shard_owns.
+ *     an argument that does not start with the name of a directive
+ *     is the program and ends the directives.
+ * parameters:
+ *     line: the line to read the directives of.
+ * returns:
+ *     0 if every directive was valid.
+ *     -1 otherwise, the line should not be started.
+ */
+int read_directives(struct list_line *line);
+
+/*
+ * read_launch_settings
+ * description:
+ *     checks if a line at the top of the process list sets how lines
+ *     are started, and if so applies it. such a line holds nothing but
+ *     settings of the form "[name]=[value]":
+ *         max_starting=[n]: at most n processes start at the same time,
+ *         a process is starting until it is ready. 0, the default, is
+ *         no limit.
+ *         spawn_rate=[n]: at most n processes are started per second.
+ *         0, the default, is no limit.
+ *         ready_timeout=[s]: a process that is not ready after s seconds
+ *         counts as ready anyway. defaults to 30.
+ * parameters:
+ *     line: the line to check.
+ * returns:
+ *     1 if the line is a settings line, even if a value is invalid.
+ *     0 if it is a line to start.
+ */
+int read_launch_settings(struct list_line *line);
+
+/*
+ * read_list_header
+ * description:
+ *     finds the first line of the process list to start, skipping the
+ *     time limit, see read_timer, and the settings lines after it,
+ *     see read_launch_settings, which are applied.
+ * parameters:
+ *     list: the process list.
+ * returns:
+ *     the index of the first line to start.
+ */
+int read_list_header(struct process_list *list);
+
+/*
+ * parse_id_list
+ * description:
+ *     parses a list of cpu or node numbers and ranges separated by
+ *     commas, for example "0-3,8,10-11".
+ * parameters:
+ *     str: the list to parse.
+ * returns:
+ *     a new set of the numbers in the list.
+ *     NULL if the list is not valid.
+ */
+cpu_set_t *parse_id_list(char *str);
+
+/*
+ * parse_size
+ * description:
+ *     parses a size in bytes with an optional K, M or G suffix.
+ * parameters:
+ *     str: the size to parse, e.g. "512M".
+ * returns:
+ *     the size in bytes.
+ *     -1 if str is not a valid size.
+ */
+long parse_size(char *str);
+
+/*
+ * format_id_list
+ * description:
+ *     formats a set of cpus as a list of numbers and ranges,
+ *     the inverse of parse_id_list.
+ * parameters:
+ *     set: the set to format.
+ *     buffer: where the list is written, NUL terminated.
+ *     size: the size of buffer.
+ */
+void format_id_list(cpu_set_t *set, char *buffer, int size);
+
+/*
+ * compile_alert
+ * description:
+ *     parses the rule of an alert directive, of the form
+ *     "[metric][op][threshold] for [duration] -> [action]", for example
+ *     "cpu>90% for 30s -> SIGTERM" or "mem>=2GB -> restart".
+ *         metric: cpu, as a percent, or mem, in MB, which may also be
+ *         named after the metric of -m, e.g. rss.
+ *         op: >, >=, < or <=.
+ *         threshold: a number, for mem with an optional K, M or G
+ *         suffix, optionally followed by B.
+ *         duration: optional, how long the threshold must be crossed in
+ *         every sample before acting, with a ms, s or m suffix.
+ *         action: a signal such as SIGTERM or TERM, restart to stop the
+ *         process and restart it whatever its restart policy, or log to
+ *         only display the alert.
+ *     the rule is compiled once here so check_alerts only compares numbers.
+ * parameters:
+ *     text: the rule.
+ *     rule: where the compiled rule is stored.
+ * returns:
+ *     0 on success.
+ *     -1 if the rule is not valid.
+ */
+int compile_alert(char *text, struct alert_rule *rule);
+
+/*
+ * directive_error
+ * description:
+ *     displays an invalid directive on stderr.
+ * parameters:
+ *     line: the line the directive is on.
+ *     directive: the invalid directive.
+ * returns:
+ *     -1, for read_directives to return.
+ */
+int directive_error(struct list_line *line, char *directive);
+
+/*
+ * display_date
+ * description:
+ *     displays the time of the clock snapshot in the following format:
+ *     [day_of_week], [month] [day], [year] [hour]:[min]:[sec] [AM/PM]
+ */
+void display_date(void);
+
+/*
+ * update_clock
+ * description:
+ *     takes a snapshot of the monotonic and real time in NOW, shared by
+ *     everything that needs the time in this iteration of the event
+ *     loop instead of each reading it again.
+ */
+void update_clock(void);
+
+/*
+ * get_date
+ * description:
+ *     formats the real time of the clock snapshot for the reports as
+ *     [day_of_week], [month] [day], [year] [hour]:[min]:[sec] [AM/PM]
+ *     the text is kept, and only formatted again once the snapshot is
+ *     in another second, so reports in the same second share it.
+ *     the time zone is read once by tzset in main.
+ * returns:
+ *     the date, valid until the next call.
+ */
+char *get_date(void);
+
+/*
+ * parse_output_format
+ * description:
+ *     converts the name of an output format given with -o
+ *     to its OUTPUT_* value.
+ * parameters:
+ *     name: "text", "json" or "binary".
+ * returns:
+ *     the OUTPUT_* value of name.
+ *     -1 if name is not an output format.
+ */
+int parse_output_format(char *name);
+
+/*
+ * out_reserve
+ * description:
+ *     makes sure the output buffer has room for size more bytes
+ *     in its current chunk, moving on to the next chunk if needed.
+ *     chunks are kept between flushes, so after the first few reports
+ *     nothing is allocated.
+ * parameters:
+ *     size: the number of bytes about to be written.
+ * returns:
+ *     the chunk to write to.
+ */
+struct out_chunk *out_reserve(size_t size);
+
+/*
+ * out_printf
+ * description:
+ *     appends formatted text to the output buffer, see flush_report.
+ * parameters:
+ *     format: printf format string.
+ *     ...: the values for format.
+ */
+void out_printf(const char *format, ...);
+
+/*
+ * out_write
+ * description:
+ *     appends raw bytes to the output buffer, see flush_report.
+ * parameters:
+ *     data: the bytes to append.
+ *     size: the number of bytes.
+ */
+void out_write(const void *data, size_t size);
+
+/*
+ * out_json_string
+ * description:
+ *     appends str to the output buffer as a quoted JSON string.
+ * parameters:
+ *     str: the string to append.
+ */
+void out_json_string(const char *str);
+
+/*
+ * flush_report
+ * description:
+ *     writes everything in the output buffer to stdout with writev,
+ *     one iovec per chunk, and empties the buffer.
+ *     called once per report so a report costs a single write
+ *     however many processes it covers.
+ */
+void flush_report(void);
+
+/*
+ * write_all
+ * description:
+ *     writes every byte of iov to fd, retrying after partial writes.
+ * parameters:
+ *     fd: the file descriptor to write to.
+ *     iov: the buffers to write, modified by this function.
+ *     count: the number of buffers in iov.
+ * returns:
+ *     0 if everything was written, -1 on error.
+ */
+int write_all(int fd, struct iovec *iov, int count);
+
+/*
+ * send_aggregator
+ * description:
+ *     writes records to the non blocking aggregator socket without ever
+ *     waiting on it, so a slow aggregator cannot hold up the event loop.
+ *     what the socket did not take is kept and sent first next time,
+ *     so records are never cut. while some is still kept, new records
+ *     are dropped, the aggregator only misses those ticks.
+ * parameters:
+ *     iov: the records to write.
+ *     count: the number of entries in iov.
+ * returns:
+ *     0 if the records were written, kept or dropped.
+ *     -1 if the aggregator is gone.
+ */
+int send_aggregator(struct iovec *iov, int count);
+
+/*
+ * write_record
+ * description:
+ *     appends a binary record to the output buffer.
+ *     fields that do not apply to the record type are -1.
+ * parameters:
+ *     type: the RECORD_* type of the record.
+ *     table: the process table, or NULL for records about macD itself.
+ *     slot: the slot the record is about.
+ *     value: for RECORD_REPORT the tick, for RECORD_EXIT the total time.
+ */
+void write_record(int type, struct proc_table *table, int slot, int value);
+
+/*
+ * display_header
+ * description:
+ *     starts a report. in text mode displays the title and the date,
+ *     in json mode writes a report object and in binary mode a
+ *     RECORD_REPORT record.
+ *     the clock snapshot taken here is the timestamp of every record
+ *     of the report and the date displayed.
+ * parameters:
+ *     title: "Starting report", "Normal report" or "Terminating".
+ *     tick: the number of normal reports before this one.
+ */
+void display_header(char *title, int tick);
+
+/*
+ * display_separator
+ * description:
+ *     displays the "..." line around normal reports in text mode.
+ */
+void display_separator(void);
+
+/*
+ * display_exiting
+ * description:
+ *     displays the total time macD ran for, just before it exits.
+ * parameters:
+ *     total_time: the time macD ran for, in seconds.
+ */
+void display_exiting(int total_time);
+
+/*
+ * read_file
+ * description:
+ *     reads all lines in the given file.
+ *     creates a process for each line in the file where the line
+ *     indicates what process to create, see launch_lines.
+ *     the process list is owned by the returned table.
+ * parameters:
+ *     file_path: string of the path to the file to read.
+ * pre-conditions:
+ *     file_path is initialized.
+ * returns:
+ *     process table holding a slot for each started process.
+ *     NULL if the file could not be opened.
+ */
+struct proc_table *read_file(char *file_path);
+
+/*
+ * start_list
+ * description:
+ *     reads the time limit and launch settings of a process list and
+ *     starts its lines, see launch_lines. with --replay the time limit
+ *     is in virtual seconds.
+ * parameters:
+ *     list: the process list, owned by the returned table.
+ * returns:
+ *     process table holding a slot for each started process.
+ */
+struct proc_table *start_list(struct process_list *list);
+
+/*
+ * launch_lines
+ * description:
+ *     queues the lines of list from first on to be started by
+ *     run_launches, ordered by their priority then line number,
+ *     and starts as many as the launch settings allow right away.
+ *     lines of another shard, see shard_owns, are not started and
+ *     count as done for the lines that wait for them.
+ * pre-conditions:
+ *     list is the process list of table.
+ * parameters:
+ *     table: the process table to add the processes to.
+ *     list: the process list.
+ *     first: the first line to start, see read_list_header.
+ *     skip: lines with a non zero entry are not started, or NULL.
+ */
+void launch_lines(struct proc_table *table, struct process_list *list, int first, char *skip);
+
+/*
+ * compare_launch_order
+ * description:
+ *     orders line indices by the priority of their line, then by
+ *     their line number, for qsort_r.
+ * parameters:
+ *     a, b: pointers to the indices to compare.
+ *     arg: the process list.
+ * returns:
+ *     a negative number if a starts first, a positive number otherwise.
+ */
+int compare_launch_order(const void *a, const void *b, void *arg);
+
+/*
+ * run_launches
+ * description:
+ *     starts the queued lines that are allowed to start now, then arms
+ *     the launch timer for when the next one may. a line starts once:
+ *         every line of a lower priority is ready, so tiers start in turn.
+ *         its after= line is ready, or failed, or exited.
+ *         fewer than max_starting processes are starting.
+ *         the spawn_rate allows another spawn.
+ *     processes are started LAUNCH_BATCH at a time without waiting in
+ *     between, then each batch is reported in line order. after= lines
+ *     that wait on each other in a cycle are started anyway, with a warning.
+ * parameters:
+ *     table: the process table.
+ * pre-conditions:
+ *     the table has a process list.
+ */
+void run_launches(struct proc_table *table);
+
+/*
+ * start_lines
+ * description:
+ *     one pass of run_launches, starts the pending lines that may
+ *     start now in the order of launch_order.
+ * parameters:
+ *     table: the process table.
+ *     now: the current monotonic time.
+ *     waiting: set to 1 if the spawn rate stopped the pass, the time
+ *              of the next spawn is then in NEXT_LAUNCH.
+ * returns:
+ *     the number of lines started, including lines that failed to start.
+ */
+int start_lines(struct proc_table *table, double now, int *waiting);
+
+/*
+ * finish_launches
+ * description:
+ *     reports a batch started by run_launches and moves each of its
+ *     lines on: processes that failed to start, or are ready as soon
+ *     as they exec, are done, others are starting until they are ready.
+ * parameters:
+ *     table: the process table.
+ *     batch: the launches started by run_launches.
+ *     batch_len: the number of launches in batch.
+ */
+void finish_launches(struct proc_table *table, struct launch *batch, int batch_len);
+
+/*
+ * update_starting
+ * description:
+ *     checks whether the starting processes have become ready.
+ *     with ready=cpu a process is ready once it has used a cpu tick,
+ *     with ready=fd once it writes to or closes fd READY_NOTIFY_FD.
+ *     a process that exited, or is not ready after READY_TIMEOUT
+ *     seconds, is done starting too.
+ * parameters:
+ *     table: the process table.
+ *     now: the current monotonic time.
+ */
+void update_starting(struct proc_table *table, double now);
+
+/*
+ * line_done
+ * description:
+ *     marks a line as done starting. with -l the time it took every
+ *     line to be ready is displayed once the last one is, if that is
+ *     after the event loop started.
+ * parameters:
+ *     table: the process table.
+ *     line: the line that is done.
+ */
+void line_done(struct proc_table *table, struct list_line *line);
+
+/*
+ * line_ready
+ * description:
+ *     checks if the line an after= directive refers to is done.
+ *     a line number past the end of the list counts as done.
+ * parameters:
+ *     list: the process list.
+ *     index: the index of the line in list.
+ * returns:
+ *     1 if the line is done starting or is not started at all.
+ *     0 if it has yet to be ready.
+ */
+int line_ready(struct process_list *list, int index);
+
+/*
+ * arm_launch_timer
+ * description:
+ *     arms the launch timer for the next time run_launches has work:
+ *     the next spawn the spawn rate allows, the next poll of processes
+ *     waiting for ready=cpu, or the next READY_TIMEOUT.
+ * parameters:
+ *     table: the process table.
+ *     now: the current monotonic time.
+ */
+void arm_launch_timer(struct proc_table *table, double now);
+
+/*
+ * watch_ready_fds
+ * description:
+ *     adds the ready=fd pipes of the processes started before the event
+ *     loop was created to it.
+ * parameters:
+ *     table: the process table.
+ * pre-conditions:
+ *     init_event_loop has been called.
+ */
+void watch_ready_fds(struct proc_table *table);
+
+/*
+ * display_ready
+ * description:
+ *     displays that a process with a ready= directive is ready.
+ * parameters:
+ *     line: the line of the process.
+ *     timed_out: 1 if the process was not ready within READY_TIMEOUT.
+ */
+void display_ready(struct list_line *line, int timed_out);
+
+/*
+ * start_launch
+ * description:
+ *     creates the process of the line of launch,
+ *     recording how long the spawn took. it reads the clock itself
+ *     instead of NOW, the snapshot is older than the spawn it times.
+ * parameters:
+ *     launch: the launch to start.
+ * pre-conditions:
+ *     launch->line has at least one argument.
+ * post-conditions:
+ *     launch->pid and launch->fd are set as returned by create_process.
+ *     with -g cgroup launch->group is the cgroup of the process.
+ *     with ready=fd the line holds both ends of its readiness pipe.
+ */
+void start_launch(struct launch *launch);
+
+/*
+ * get_monotonic_time
+ * description:
+ *     reads CLOCK_MONOTONIC.
+ * returns:
+ *     the current monotonic time in seconds.
+ */
+double get_monotonic_time(void);
+
+/*
+ * report_launch_batch
+ * description:
+ *     waits for the exec of every process in the batch and displays
+ *     whether it started, in line order.
+ *     every started process is given a slot in table along with
+ *     a copy of its line, the slot is stored in its launch.
+ *     a process adopted by adopt_launch has no exec to wait for.
+ * parameters:
+ *     batch: list of launches created by read_file.
+ *     batch_len: the number of launches in batch.
+ *     table: the process table to add the started processes to.
+ * pre-conditions:
+ *     table is initialized.
+ */
+void report_launch_batch(struct launch *batch, int batch_len, struct proc_table *table);
+
+/*
+ * display_started
+ * description:
+ *     displays that the process of line was started, or restarted.
+ * parameters:
+ *     table: the process table.
+ *     slot: the slot the process was given.
+ *     line: the line of the process list the process came from.
+ *     spawn_time: the time, in seconds, the spawn took.
+ */
+void display_started(struct proc_table *table, int slot, struct list_line *line, double spawn_time);
+
+/*
+ * display_failed
+ * description:
+ *     displays that the process of line failed to start.
+ * parameters:
+ *     line_number: the line number of the process.
+ *     line: the line of the process list.
+ */
+void display_failed(int line_number, struct list_line *line);
+
+/*
+ * create_proc_table
+ * description:
+ *     creates an empty process table with room for MAX_PROCESSES slots.
+ *     with -H the sample history is created with it, see grow_history.
+ * returns:
+ *     the new process table.
+ */
+struct proc_table *create_proc_table(void);
+
+/*
+ * grow_proc_table
+ * description:
+ *     resizes every array of the table to hold capacity slots
+ *     and rebuilds the pid hash so it stays at most half full.
+ * parameters:
+ *     table: the process table to grow.
+ *     capacity: the new number of slots.
+ * pre-conditions:
+ *     capacity >= table->len.
+ */
+void grow_proc_table(struct proc_table *table, int capacity);
+
+/*
+ * grow_history
+ * description:
+ *     makes room in the sample history of the table for capacity slots.
+ *     the history is a header followed by one block per slot, each a
+ *     history_slot and its ring of HISTORY_LEN samples, so a slot's
+ *     samples are contiguous and adding slots only appends blocks.
+ *     it is mapped from HISTORY_PATH if set with -M, so the samples
+ *     survive macD crashing, or from anonymous memory otherwise.
+ *     all memory is allocated here, recording a sample never allocates.
+ * parameters:
+ *     table: the process table.
+ *     capacity: the new number of slots.
+ */
+void grow_history(struct proc_table *table, int capacity);
+
+/*
+ * get_history
+ * description:
+ *     finds the block of a slot in the sample history.
+ * parameters:
+ *     table: the process table.
+ *     slot: the slot of the process.
+ * pre-conditions:
+ *     the table has a history, HISTORY_LEN > 0.
+ * returns:
+ *     the history_slot of slot, followed by its samples.
+ */
+struct history_slot *get_history(struct proc_table *table, int slot);
+
+/*
+ * record_history
+ * description:
+ *     adds a sample of the process in slot to its ring in the history,
+ *     replacing the oldest once the ring is full. only touches slot, so
+ *     it is safe from the sampler threads.
+ * parameters:
+ *     table: the process table.
+ *     slot: the slot of the process that was just sampled.
+ *     time: the monotonic time of the sample.
+ */
+void record_history(struct proc_table *table, int slot, double time);
+
+/*
+ * rebuild_hash
+ * description:
+ *     replaces the pid hash with an empty one of hash_capacity
+ *     positions and adds the current pid of every slot to it.
+ * parameters:
+ *     table: the process table.
+ *     hash_capacity: the number of positions, a power of 2.
+ */
+void rebuild_hash(struct proc_table *table, int hash_capacity);
+
+/*
+ * add_process
+ * description:
+ *     adds a started process to the next free slot of the table.
+ *     the table doubles in size when it is full.
+ *     slots are never reused or moved, so the slot of a process
+ *     stays its index in every report.
+ * parameters:
+ *     table: the process table to add to.
+ *     pid: the process id of the started process.
+ *     line_number: the line of the process list file it came from.
+ *     command: the line of the file, owned by the table from now on.
+ * pre-conditions:
+ *     table is initialized.
+ * returns:
+ *     the slot of the process.
+ */
+int add_process(struct proc_table *table, int pid, int line_number, char *command);
+
+/*
+ * hash_pid
+ * description:
+ *     computes the position of pid in the pid hash of the table.
+ * parameters:
+ *     table: the process table.
+ *     pid: the process id to hash.
+ * returns:
+ *     the first position of the hash to probe for pid.
+ */
+int hash_pid(struct proc_table *table, int pid);
+
+/*
+ * hash_insert
+ * description:
+ *     adds the pid of slot to the pid hash of the table.
+ * parameters:
+ *     table: the process table.
+ *     slot: the slot to add.
+ * pre-conditions:
+ *     the hash has at least one empty position.
+ */
+void hash_insert(struct proc_table *table, int slot);
+
+/*
+ * change_pid
+ * description:
+ *     gives slot the pid of its restarted process. the entry of the old
+ *     pid is left in the hash, find_slot skips it as the pid of the slot
+ *     no longer matches, and the hash is rebuilt without such entries
+ *     once it is half full.
+ * parameters:
+ *     table: the process table.
+ *     slot: the slot of the restarted process.
+ *     pid: the process id of the restarted process.
+ */
+void change_pid(struct proc_table *table, int slot, int pid);
+
+/*
+ * find_slot
+ * description:
+ *     finds the slot of the process with the given pid.
+ * parameters:
+ *     table: the process table.
+ *     pid: the process id to find.
+ * returns:
+ *     the slot of pid.
+ *     -1 if pid is not in the table.
+ */
+int find_slot(struct proc_table *table, int pid);
+
+/*
+ * free_proc_table
+ * description:
+ *     frees the process table and everything it owns.
+ * parameters:
+ *     table: the process table to free.
+ */
+void free_proc_table(struct proc_table *table);
+
+/*
+ * open_proc_files
+ * description:
+ *     opens /proc/[pid] and, relative to it, the stat file and the
+ *     memory file of MEM_METRIC, see get_mem_usage, so they can be read
+ *     again on every report without opening them by path.
+ *     if cache is 0 nothing is opened and the files are opened by
+ *     path each time they are read instead.
+ * parameters:
+ *     files: the proc_files to open.
+ *     pid: the process id to open the files of.
+ *     cache: 1 to keep the files open, 0 otherwise.
+ * post-conditions:
+ *     any file that could not be opened is set to -1.
+ */
+void open_proc_files(struct proc_files *files, int pid, int cache);
+
+/*
+ * close_proc_files
+ * description:
+ *     closes the files opened by open_proc_files.
+ * parameters:
+ *     files: the proc_files to close.
+ */
+void close_proc_files(struct proc_files *files);
+
+/*
+ * open_group_files
+ * description:
+ *     opens the files of a process started with -g cgroup.
+ *     the process is sampled from its cgroup instead of /proc/[pid]:
+ *     the cpu of the whole tree from cpu.stat and, if the memory
+ *     controller is enabled, its memory from memory.current.
+ *     otherwise the memory is that of the process alone.
+ * parameters:
+ *     files: the proc_files to open.
+ *     pid: the process id of the process.
+ *     group: the path of the cgroup of the process.
+ *     cache: 1 to keep the files open, 0 otherwise.
+ */
+void open_group_files(struct proc_files *files, int pid, char *group, int cache);
+
+/*
+ * read_proc_file
+ * description:
+ *     reads the whole of a /proc file of the process from the beginning
+ *     in a single pread.
+ *     if the files are not cached the file is opened by path,
+ *     read and closed again. the system calls are counted for -O.
+ * parameters:
+ *     files: the /proc files of the process.
+ *     fd: the open file, one of the fds of files.
+ *     name: the name of the file in /proc/[pid], or an absolute path.
+ *     buffer: where the contents are stored, NUL terminated.
+ *     size: the size of buffer.
+ * returns:
+ *     the number of bytes read.
+ *     -1 if the file could not be read, meaning the process is gone.
+ */
+int read_proc_file(struct proc_files *files, int fd, char *name, char *buffer, int size);
+
+/*
+ * count_proc_io
+ * description:
+ *     adds to the number of system calls and opens made to sample
+ *     processes, displayed by display_overhead. safe to call from
+ *     the sampler threads.
+ * parameters:
+ *     syscalls: the number of system calls made.
+ *     opens: how many of them opened a file.
+ */
+void count_proc_io(int syscalls, int opens);
+
+/*
+ * get_cpu_usage
+ * description:
+ *     computes the total amount of time the process has spent
+ *     on the cpu, measured in clock ticks by
+ *     reading /proc/[pid]/stat to find the user time and kernal time.
+ *     the fields are counted from the last ')' so a process name
+ *     containing spaces or brackets is skipped correctly.
+ * parameters:
+ *     files: the open /proc files of the process.
+ * returns:
+ *     the number of ticks the process has been on the cpu for
+ *     or -1 if no such process exists.
+ */
+int get_cpu_usage(struct proc_files *files);
+
+/*
+ * get_group_cpu_usage
+ * description:
+ *     computes the total amount of time every process in the cgroup
+ *     of files has spent on the cpu, from usage_usec in cpu.stat.
+ *     includes processes of the group that already exited.
+ * parameters:
+ *     files: the open files of the process, see open_group_files.
+ * returns:
+ *     the cpu time in clock ticks, like get_cpu_usage.
+ *     -1 if the cgroup could not be read.
+ */
+int get_group_cpu_usage(struct proc_files *files);
+
+/*
+ * parse_collector
+ * description:
+ *     converts the name of a collector given with -C
+ *     to its COLLECT_* value.
+ * parameters:
+ *     name: "proc" or "netlink".
+ * returns:
+ *     the COLLECT_* value of name.
+ *     -1 if name is not a collector.
+ */
+int parse_collector(char *name);
+
+/*
+ * init_netlink_collector
+ * description:
+ *     sets up -C netlink: a generic netlink socket to query the
+ *     taskstats of many processes with a few system calls, and a
+ *     connector socket the kernel sends process events to, see
+ *     handle_proc_events. both need CAP_NET_ADMIN.
+ *     the taskstats of macD itself are queried once to check they
+ *     can be read. if they cannot, /proc is used instead.
+ * returns:
+ *     0 on success.
+ *     -1 if the netlink sockets could not be set up.
+ */
+int init_netlink_collector(void);
+
+/*
+ * put_attr
+ * description:
+ *     appends a netlink attribute to a message being built.
+ * parameters:
+ *     attr: where the attribute is written.
+ *     type: the type of the attribute.
+ *     data: the payload of the attribute.
+ *     len: the length of data.
+ * returns:
+ *     the number of bytes written, padding included.
+ */
+int put_attr(struct nlattr *attr, int type, void *data, int len);
+
+/*
+ * find_attr
+ * description:
+ *     finds an attribute in a list of netlink attributes.
+ * parameters:
+ *     attr: the first attribute.
+ *     len: the length of the list in bytes.
+ *     type: the type of the attribute to find.
+ * returns:
+ *     the attribute, its payload follows NLA_HDRLEN bytes after it.
+ *     NULL if there is no such attribute.
+ */
+struct nlattr *find_attr(struct nlattr *attr, int len, int type);
+
+/*
+ * get_taskstats_family
+ * description:
+ *     asks the generic netlink controller for the id of the
+ *     taskstats family, which is assigned when the kernel boots.
+ * parameters:
+ *     fd: a NETLINK_GENERIC socket.
+ * returns:
+ *     the family id.
+ *     -1 if the kernel has no taskstats.
+ */
+int get_taskstats_family(int fd);
+
+/*
+ * query_taskstats
+ * description:
+ *     reads the cpu time of up to TASKSTATS_BATCH processes from
+ *     taskstats in two system calls: every request is packed into one
+ *     message sent with a single send, the kernel answers them all
+ *     before send returns, and the answers are read with one recvmmsg.
+ *     the answers are matched by sequence number, so an answer that
+ *     was dropped or left over from an earlier batch is never used.
+ *     the system calls are counted for -O.
+ * parameters:
+ *     pids: the process ids to query, as thread group ids.
+ *     ticks: set to the cpu time of each process in clock ticks,
+ *            like get_cpu_usage, or -1 if it could not be read.
+ *     count: the length of pids and ticks, at most TASKSTATS_BATCH.
+ * returns:
+ *     the number of processes whose cpu time was read.
+ *     errno is set to the error of the last process that was not.
+ */
+int query_taskstats(int *pids, int *ticks, int count);
+
+/*
+ * collect_taskstats
+ * description:
+ *     collects the cpu time of every process in slots from taskstats,
+ *     TASKSTATS_BATCH processes per query, for sample_process to use
+ *     instead of reading /proc/[pid]/stat. processes in a cgroup are
+ *     skipped, their cpu is that of the whole cgroup. taskstats has
+ *     no current memory usage, so the memory is still read from /proc.
+ * parameters:
+ *     table: the process table.
+ *     slots: the slots about to be sampled.
+ *     num_slots: the length of slots.
+ * post-conditions:
+ *     the batch_cpu of every slot in slots is its cpu time in clock
+ *     ticks, or -1 if it was not collected.
+ */
+void collect_taskstats(struct proc_table *table, int *slots, int num_slots);
+
+/*
+ * open_proc_events
+ * description:
+ *     subscribes to the process events of the netlink connector:
+ *     the kernel then sends every fork, exec and exit in the system
+ *     to PROC_EVENTS_FD, see handle_proc_events.
+ * returns:
+ *     0 on success.
+ *     -1 if the events could not be subscribed to.
+ */
+int open_proc_events(void);
+
+/*
+ * close_proc_events
+ * description:
+ *     stops receiving process events, once macD is shutting down
+ *     they are no longer needed.
+ */
+void close_proc_events(void);
+
+/*
+ * handle_proc_events
+ * description:
+ *     reads every pending process event and keeps those of processes
+ *     in the table:
+ *         exit: the process is no longer sampled until it is reaped,
+ *         which SIGCHLD still does once it is a zombie.
+ *         fork and exec: with -a the process is no longer stable and
+ *         is sampled on its next report.
+ *     the events of every other process in the system are skipped
+ *     with a lookup in the pid hash.
+ * parameters:
+ *     table: the process table.
+ */
+void handle_proc_events(struct proc_table *table);
+
+/*
+ * get_mem_usage
+ * description:
+ *     computes the memory used by the process, as selected with -m:
+ *     MEM_RSS: the resident set, field 2 of /proc/[pid]/statm in pages.
+ *     MEM_PSS: the proportional set from /proc/[pid]/smaps_rollup,
+ *              shared pages are divided between the processes sharing them.
+ *     MEM_USS: the pages only this process uses, the private clean and
+ *              private dirty lines of smaps_rollup.
+ *     MEM_HWM: the peak resident set, VmHWM in /proc/[pid]/status.
+ *     each is parsed from a single read of its file.
+ *     with -g cgroup and the memory controller enabled it is
+ *     memory.current of the cgroup instead, whatever the metric.
+ * parameters:
+ *     files: the open /proc files of the process.
+ * returns:
+ *     the memory usage, in MB, of the given process
+ *     or -1 if no such process exists.
+ */
+int get_mem_usage(struct proc_files *files);
+
+/*
+ * find_kb_field
+ * description:
+ *     finds a line of the form "name value kB" as used by
+ *     /proc/[pid]/status and smaps_rollup.
+ * parameters:
+ *     buffer: the contents of the file.
+ *     name: the name at the start of the line, including the ':'.
+ * returns:
+ *     the value of the line, in KB. 0 if there is no such line.
+ */
+long find_kb_field(char *buffer, char *name);
+
+/*
+ * parse_mem_metric
+ * description:
+ *     converts the name of a memory metric given with -m
+ *     to its MEM_* value.
+ * parameters:
+ *     name: "rss", "pss", "uss" or "hwm".
+ * returns:
+ *     the MEM_* value of name.
+ *     -1 if name is not a memory metric.
+ */
+int parse_mem_metric(char *name);
+
+/*
+ * initialize_cpu_counters
+ * description:
+ *     opens the /proc files of every process in the table and
+ *     stores the cpu usage of each process as the usage from the
+ *     previous reporting cycle.
+ *     only the first CACHED_SLOTS slots keep their files open,
+ *     see init_fd_budget.
+ * parameters:
+ *     table: the process table.
+ * pre-conditions:
+ *     table is initialized.
+ */
+void initialize_cpu_counters(struct proc_table *table);
+
+/*
+ * initialize_slot
+ * description:
+ *     opens the /proc files of the process in slot and stores its
+ *     current cpu usage as the usage from the previous sample.
+ *     files it already had open are closed first. a virtual process
+ *     of --replay has no files, its trace starts now.
+ * parameters:
+ *     table: the process table.
+ *     slot: the slot of a running process.
+ */
+void initialize_slot(struct proc_table *table, int slot);
+
+/*
+ * init_fd_budget
+ * description:
+ *     raises the soft limit on open files to the hard limit and
+ *     sets CACHED_SLOTS to the number of slots whose /proc files
+ *     can stay open while leaving FD_RESERVE fds for everything else.
+ *     processes in the remaining slots open their files on each read.
+ */
+void init_fd_budget(void);
+
+/*
+ * terminate_program
+ * description:
+ *     terminates this process and all children processes.
+ *     It then displays the final status for all children,
+ *     once they are reaped, the summary of their history with -H
+ *     and the total runtime of the process.
+ * parameters:
+ *     table: the process table of all children.
+ *     elapsed_time: the time the program has been running for.
+ * pre-conditions:
+ *     table is initalized.
+ * post-conditions:
+ *     all processes in the table will be killed.
+ *     this program will terminate.
+ */
+void terminate_program(struct proc_table *table, double elapsed_time);
+
+/*
+ * shutdown_children
+ * description:
+ *     stops every process in the table that is still running.
+ *     SIGTERM is sent to all of them at once, then they are reaped as
+ *     they exit until GRACE_PERIOD seconds have passed or a second
+ *     SIGINT arrives. whatever is still running then is sent SIGKILL
+ *     and reaped, so shutdown takes about GRACE_PERIOD however many
+ *     processes there are. with a GRACE_PERIOD of 0 SIGKILL is sent
+ *     right away.
+ *     with -g the groups of processes that already exited are
+ *     signalled too. pending restarts are cancelled and the control
+ *     socket is closed. the logs are drained once every process exited.
+ * parameters:
+ *     table: the process table of all children.
+ * pre-conditions:
+ *     table is initalized.
+ *     init_event_loop has been called.
+ * post-conditions:
+ *     every process in the table has been reaped, the exit info of
+ *     processes stopped here records how they were stopped.
+ */
+void shutdown_children(struct proc_table *table);
+
+/*
+ * signal_process
+ * description:
+ *     sends sig to the process in slot and, with -g, to its whole group.
+ *     with -g pgid the process group is signalled with killpg, as long
+ *     as it has members, see group_alive.
+ *     with -g cgroup SIGKILL is sent with cgroup.kill, which also
+ *     catches processes forked while it runs, other signals are sent
+ *     to every process listed in cgroup.procs.
+ * parameters:
+ *     table: the process table.
+ *     slot: the slot of the process.
+ *     sig: the signal to send.
+ */
+void signal_process(struct proc_table *table, int slot, int sig);
+
+/*
+ * group_alive
+ * description:
+ *     with -g pgid, checks whether the process group of slot may still
+ *     have members. once the leader is reaped its pid, the id of the
+ *     group, is free again, so the group is only signalled until it is
+ *     found empty once. after that the id may belong to another group.
+ * parameters:
+ *     table: the process table.
+ *     slot: the slot of the group leader.
+ * returns:
+ *     1 if the group may be signalled.
+ *     0 if it is gone.
+ */
+int group_alive(struct proc_table *table, int slot);
+
+/*
+ * parse_group_mode
+ * description:
+ *     converts the name of a group mode given with -g
+ *     to its GROUP_* value.
+ * parameters:
+ *     name: "pgid" or "cgroup".
+ * returns:
+ *     the GROUP_* value of name.
+ *     -1 if name is not a group mode.
+ */
+int parse_group_mode(char *name);
+
+/*
+ * init_groups
+ * description:
+ *     creates the cgroup the cgroups of every line are created in,
+ *     [cgroup2 mount]/[cgroup of macD]/macD.[pid], and enables the
+ *     memory controller for them if the parent cgroup allows it.
+ *     if no cgroup can be created macD falls back to process groups.
+ * pre-conditions:
+ *     GROUP_MODE is GROUP_CGROUP.
+ * post-conditions:
+ *     GROUP_ROOT is set and CGROUP_MEMORY is 1 if memory.current
+ *     can be read for each line, or GROUP_MODE is GROUP_PGID.
+ */
+void init_groups(void);
+
+/*
+ * create_group
+ * description:
+ *     creates the cgroup of a line of the process list and opens its
+ *     cgroup.procs, so the process can join it before its exec.
+ * parameters:
+ *     line_number: the line of the process list.
+ *     out_fd: set to the open cgroup.procs, or -1 on error.
+ * pre-conditions:
+ *     init_groups has been called.
+ * returns:
+ *     the path of the new cgroup, or NULL if it could not be created.
+ */
+char *create_group(int line_number, int *out_fd);
+
+/*
+ * open_group_procs
+ * description:
+ *     opens cgroup.procs of a cgroup for a process to join it,
+ *     see join_group.
+ * parameters:
+ *     group: the path of the cgroup.
+ * returns:
+ *     the open file, or -1 on error.
+ */
+int open_group_procs(char *group);
+
+/*
+ * join_group
+ * description:
+ *     called in a new process before its exec to move it into its
+ *     group: a process group of its own with -g pgid, the cgroup
+ *     of group_fd with -g cgroup.
+ *     only makes system calls, so it is safe after vfork.
+ * parameters:
+ *     group_fd: the cgroup.procs file of the cgroup, or -1.
+ */
+void join_group(int group_fd);
+
+/*
+ * write_group_file
+ * description:
+ *     writes value to a file of a cgroup.
+ * parameters:
+ *     group: the path of the cgroup.
+ *     name: the name of the file in the cgroup.
+ *     value: the string to write.
+ * returns:
+ *     0 on success, -1 otherwise.
+ */
+int write_group_file(char *group, char *name, char *value);
+
+/*
+ * remove_group
+ * description:
+ *     removes a cgroup created by create_group. a cgroup can only be
+ *     removed once the last process in it is gone, which takes a
+ *     moment after cgroup.kill, so an occupied cgroup is retried
+ *     until GROUP_REMOVE_TRIES are used up.
+ * parameters:
+ *     group: the path of the cgroup, may be NULL.
+ */
+void remove_group(char *group);
+
+/*
+ * remove_groups
+ * description:
+ *     removes the cgroups of every slot of the table and frees their
+ *     paths, then removes GROUP_ROOT once it is empty.
+ * parameters:
+ *     table: the process table.
+ */
+void remove_groups(struct proc_table *table);
+
+/*
+ * check_timer
+ * description:
+ *     checks if the program has run longer than the TARGET_TIME
+ *     or if KILL_STATE == 1.
+ *     if either of these condtions are true returns 1.
+ * parameters:
+ *     current_time: the current real time, from the clock snapshot.
+ * returns:
+ *     1 if program has run for TARGET_TIME or KILL_STATE = 1.
+ *     0 otherwise.
+ */
+int check_timer(double current_time);
+
+/*
+ * display_proc_state
+ * description:
+ *     displays the cpu usage and mem usage of a process
+ *     from its last sample, and its effective cpus if its line
+ *     has a cpus directive.
+ * parameters:
+ *     table: the process table.
+ *     slot: the slot of the process in the process table.
+ */
+void display_proc_state(struct proc_table *table, int slot);
+
+/*
+ * get_affinity
+ * description:
+ *     reads the cpus a process is allowed to run on, which may differ
+ *     from its cpus directive if it or the system changed it since.
+ * parameters:
+ *     pid: the process id.
+ * returns:
+ *     the effective cpu list of the process, valid until the next call.
+ *     "?" if it could not be read.
+ */
+char *get_affinity(int pid);
+
+/*
+ * sample_process
+ * description:
+ *     reads the cpu and memory usage of the process in slot and
+ *     computes its cpu usage since the last time it was sampled,
+ *     from the cpu ticks used over the monotonic time elapsed.
+ *     with -a the memory is only read when the cpu ticks changed.
+ *     with -C netlink the cpu ticks collected by collect_taskstats are
+ *     used if there are any, /proc otherwise. with --replay the sample
+ *     comes from the trace of the process instead, see replay_sample.
+ *     the results are stored in the cpu and mem arrays of the table,
+ *     and with -H in the history of the slot. only touches slot, so
+ *     different slots can be sampled at the same time by different
+ *     threads.
+ * parameters:
+ *     table: the process table.
+ *     slot: the slot of the process to sample.
+ */
+void sample_process(struct proc_table *table, int slot);
+
+/*
+ * mem_sample_due
+ * description:
+ *     checks if the memory of the process in slot should be read
+ *     this tick. statm and status are cheap and read on every sample,
+ *     smaps_rollup walks every mapping of the process so with -m pss
+ *     or uss it is read only every SMAPS_INTERVAL reports.
+ * parameters:
+ *     table: the process table.
+ *     slot: the slot of the process being sampled.
+ * returns:
+ *     1 if the memory should be read, 0 to keep the last value.
+ */
+int mem_sample_due(struct proc_table *table, int slot);
+
+/*
+ * schedule_sample
+ * description:
+ *     picks the tick the process in slot is next sampled at with -a.
+ *     every sample in a row that finds the process stable, using no
+ *     cpu and the same memory, doubles the number of ticks until its
+ *     next sample, up to ADAPTIVE_MAX_SKIP. any change brings it back
+ *     to every tick.
+ * parameters:
+ *     table: the process table.
+ *     slot: the slot of the process that was just sampled.
+ *     stable: 1 if the process did not change since its last sample.
+ */
+void schedule_sample(struct proc_table *table, int slot, int stable);
+
+/*
+ * sample_slots
+ * description:
+ *     samples every slot in slots, using the sampler pool if
+ *     one was created with -t. with -C netlink the cpu of every
+ *     slot is first collected in batches by collect_taskstats.
+ * parameters:
+ *     table: the process table.
+ *     slots: list of the slots to sample.
+ *     num_slots: the length of slots.
+ * post-conditions:
+ *     every slot in slots has been sampled.
+ */
+void sample_slots(struct proc_table *table, int *slots, int num_slots);
+
+/*
+ * create_sampler_pool
+ * description:
+ *     starts threads - 1 sampler threads, the thread calling
+ *     run_sampler_pool does the share of the last one.
+ * parameters:
+ *     threads: the number of threads to sample with.
+ * pre-conditions:
+ *     threads > 1.
+ *     register_handler has been called, so the sampler threads
+ *     are created with SIGINT and SIGCHLD blocked.
+ * returns:
+ *     the new sampler pool.
+ */
+struct sampler_pool *create_sampler_pool(int threads);
+
+/*
+ * sampler_thread
+ * description:
+ *     the body of a sampler thread. waits for run_sampler_pool to
+ *     hand out work, samples its chunk and signals when it is done.
+ * parameters:
+ *     arg: the sampler_worker of this thread.
+ * returns:
+ *     never returns.
+ */
+void *sampler_thread(void *arg);
+
+/*
+ * sample_chunk
+ * description:
+ *     samples the index-th of pool->threads equal chunks of the
+ *     slots handed to the pool. chunks never overlap, so no locks
+ *     are needed while sampling.
+ * parameters:
+ *     pool: the sampler pool.
+ *     index: the index of the chunk to sample.
+ */
+void sample_chunk(struct sampler_pool *pool, int index);
+
+/*
+ * run_sampler_pool
+ * description:
+ *     splits slots into one chunk per thread, samples them in parallel
+ *     and waits until every chunk has been sampled, so the caller sees
+ *     one consistent set of samples.
+ * parameters:
+ *     pool: the sampler pool.
+ *     table: the process table.
+ *     slots: list of the slots to sample.
+ *     num_slots: the length of slots.
+ */
+void run_sampler_pool(struct sampler_pool *pool, struct proc_table *table, int *slots,
+		      int num_slots);
+
+/*
+ * display_report
+ * description:
+ *     samples and displays the processes of the table that are
+ *     reported this tick. normally that is every process, with -S
+ *     the table is split into SAMPLE_STRIPES stripes and only the
+ *     slots with slot % SAMPLE_STRIPES == tick % SAMPLE_STRIPES are
+ *     sampled, followed by a count of all processes.
+ *     with -a running processes that are not due, see schedule_sample,
+ *     are displayed with their last sample.
+ *     all processes are sampled before any is displayed.
+ * parameters:
+ *     table: the process table.
+ *     tick: the number of reports displayed before this one.
+ * returns:
+ *     the number of processes still running or waiting to restart.
+ */
+int display_report(struct proc_table *table, int tick);
+
+/*
+ * check_alerts
+ * description:
+ *     checks the alert rules of every process just sampled against its
+ *     new sample, and acts on the rules that fired. a rule fires when
+ *     its threshold has been crossed for at least its duration, then
+ *     waits until the threshold is no longer crossed before it can fire
+ *     again.
+ * parameters:
+ *     table: the process table.
+ *     slots: the slots sampled.
+ *     num_slots: the length of slots.
+ */
+void check_alerts(struct proc_table *table, int *slots, int num_slots);
+
+/*
+ * fire_alert
+ * description:
+ *     displays that an alert rule fired and takes its action.
+ * parameters:
+ *     table: the process table.
+ *     slot: the slot of the process.
+ *     rule: the rule that fired.
+ *     value: the sample that crossed the threshold.
+ */
+void fire_alert(struct proc_table *table, int slot, struct alert_rule *rule, int value);
+
+/*
+ * reset_alerts
+ * description:
+ *     clears the alert state of slot, for a new or restarted process.
+ * parameters:
+ *     table: the process table.
+ *     slot: the slot to clear.
+ */
+void reset_alerts(struct proc_table *table, int slot);
+
+/*
+ * display_summary
+ * description:
+ *     displays the count of all processes after a report with -S,
+ *     and with -a the total number of /proc reads adaptive sampling saved.
+ * parameters:
+ *     running: the number of running processes.
+ *     exited: the number of exited processes.
+ *     sampled: the number of processes sampled this report.
+ */
+void display_summary(int running, int exited, int sampled);
+
+/*
+ * periodic_reports
+ * description:
+ *     displays the status of all processes every REPORT_INTERVAL
+ *     seconds, 5 unless set with -r.
+ *     between reports the program sleeps in wait_for_event until
+ *     the next report is due, a child exits, SIGINT is received
+ *     or the time limit is reached.
+ * parameters:
+ *     table: the process table of all children.
+ * pre-conditions:
+ *     table is initialized.
+ *     register_handler has been called.
+ */
+void periodic_reports(struct proc_table *table);
+
+/*
+ * init_self_usage
+ * description:
+ *     opens the /proc files of macD itself and records its usage so far,
+ *     the start of the first interval of display_overhead, which
+ *     includes launching the process list.
+ */
+void init_self_usage(void);
+
+/*
+ * display_overhead
+ * description:
+ *     displays what macD itself cost since the last report with -O:
+ *     the cpu ticks it used and their share of the interval, its memory,
+ *     the system calls and opens made to sample processes, how long this
+ *     report took to sample and format, and how late it started compared
+ *     with when it was due.
+ * parameters:
+ *     tick_time: the time, in seconds, this report took.
+ *     lateness: the time, in seconds, the report timer fired late.
+ * pre-conditions:
+ *     init_self_usage has been called.
+ */
+void display_overhead(double tick_time, double lateness);
+
+/*
+ * get_rusage_usec
+ * description:
+ *     adds the user and system time of usage.
+ * parameters:
+ *     usage: the usage from getrusage.
+ * returns:
+ *     the total cpu time in microseconds.
+ */
+long get_rusage_usec(struct rusage *usage);
+
+/*
+ * measure_benchmark
+ * description:
+ *     measures the cost of supervising num_processes processes.
+ *     writes a process list of num_processes "sleep" lines to a
+ *     temporary file, starts it with read_file, samples every process
+ *     BENCH_PASSES times, times every reader once more process by
+ *     process, then stops them all with shutdown_children.
+ *     the launch and report output is discarded.
+ * parameters:
+ *     num_processes: the number of processes to start.
+ *     result: where the measurements are stored.
+ * returns:
+ *     0 if the benchmark ran, -1 otherwise.
+ */
+int measure_benchmark(int num_processes, struct bench_result *result);
+
 /*
- * get_num_args
+ * run_benchmark
  * description:
- *     counts the number of arguments in a given line of text
- *     assuming this line is from the process list file.
- *     counts the number of spaces in the line and uses this
- *     to determin the number of args.
+ *     runs measure_benchmark once and displays the results.
  * parameters:
- *     line: a string of the command to count the args of
- * pre-condition:
- *    line is initialized.
+ *     num_processes: the number of processes to start.
  * returns:
- *     number of args in line.
+ *     0 if the benchmark ran, 1 otherwise.
  */
-int get_num_args(char *line);
+int run_benchmark(int num_processes);
 
 /*
- * get_args
+ * run_bench_suite
  * description:
- *     creates a list of strings containing the arguments
- *     of the given line, which represents a process from the process list file.
+ *     runs measure_benchmark for every size in sizes and displays one
+ *     CSV row per size, so runs can be compared between builds, spawn
+ *     backends and sampler settings. a size that fails is skipped.
  * parameters:
- *     line: a string of the command to get the args of
- * pre-condition:
- *     line is initialized.
+ *     sizes: the numbers of processes separated by commas, e.g. "10,100".
  * returns:
- *     list of strings each element is an argument.
+ *     0 if every size ran, 1 otherwise.
  */
-char **get_args(char *line);
+int run_bench_suite(char *sizes);
 
 /*
- * create_process
+ * percentile
  * description:
- *     creates a new process using the fork function.
- *     changes the process to the process indicated by process_path.
- *     terminates any failed forks.
+ *     finds the p-th percentile of values by the nearest rank.
+ *     values is sorted in place.
  * parameters:
- *     process_path: string containing path to the process to create.
- * pre-conditions:
- *     process_path is initialized.
+ *     values: the values.
+ *     len: the number of values, at least 1.
+ *     p: the percentile, from 0 to 100.
+ * returns:
+ *     the p-th percentile.
  */
-void create_process(char *process_line, int *out_pid);
+double percentile(double *values, int len, int p);
 
 /*
- * read_next_line
+ * compare_doubles
  * description:
- *     reads the next line in the given file object
+ *     orders doubles in ascending order for qsort.
  * parameters:
- *     fptr: pointer to the FILE object to read from.
- * pre-conditions:
- *     fptr is initialized and is a valid FILE object
+ *     a, b: pointers to the doubles to compare.
  * returns:
- *     char array, string, containing the next line of the file.
+ *     a negative number, 0 or a positive number if a is smaller than,
+ *     equal to, or larger than b.
  */
-char *read_next_line(FILE *fptr);
+int compare_doubles(const void *a, const void *b);
 
 /*
- * convert_str_to_int
+ * proc_table_bytes
  * description:
- *     converts the given string to its integer form
+ *     computes the memory used by the process table, including the
+ *     command lines it owns.
  * parameters:
- *     str: the string to convert to an integer.
- * pre-condition:
- *     str is initialized.
+ *     table: the process table.
  * returns:
- *     integer form of str if str is numeric.
- *     -1 otherwise.
+ *     the size of the table in bytes.
  */
-int convert_str_to_int(char *str);
+long proc_table_bytes(struct proc_table *table);
 
 /*
- * read_timer
+ * all_exited
  * description:
- *     checks if the given line indicates a timer.
- *     if the line is in the form "timelimit [integer]" then
- *     [integer] is returned.
+ *     checks if every process in the table has exited
+ *     and none is waiting to be restarted.
  * parameters:
- *     line: line to check if its a timer.
+ *     table: the process table.
  * returns:
- *     the value of the time limit if the given line is a timer.
- *     -1 otherwise.
+ *     1 if no process in the table is still running.
+ *     0 otherwise.
  */
-int read_timer(char *line);
+int all_exited(struct proc_table *table);
 
 /*
- * get_month
+ * reap_children
  * description:
- *     converts the month in current time to
- *     its string representation.
+ *     reaps every child that has exited with wait4 and records
+ *     its exit status, cpu time and peak memory usage in its slot.
+ *     called when SIGCHLD is received, so dead processes are
+ *     never polled.
+ *     processes with a restart policy are scheduled to restart.
  * parameters:
- *     current_time: tm structure containing the current time.
+ *     table: the process table.
  * returns:
- *     string representation of the month.
+ *     the number of processes in the table that were reaped.
+ */
+int reap_children(struct proc_table *table);
+
+/*
+ * close_ready_fd
+ * description:
+ *     closes the read end of the ready=fd pipe of the line of slot,
+ *     kept open after the process was ready so it cannot get SIGPIPE
+ *     by writing to it again.
+ * parameters:
+ *     table: the process table.
+ *     slot: the slot of the process that exited.
+ */
+void close_ready_fd(struct proc_table *table, int slot);
+
+/*
+ * record_exit
+ * description:
+ *     fills in exit from the status and resource usage returned by wait4.
+ * parameters:
+ *     exit: the exit information to fill in.
+ *     status: the status returned by wait4.
+ *     usage: the resource usage returned by wait4.
+ */
+void record_exit(struct exit_info *exit, int status, struct rusage *usage);
+
+/*
+ * schedule_restart
+ * description:
+ *     decides whether the process that just exited from slot is
+ *     restarted, following the restart directive of its line, or
+ *     because an alert asked for it.
+ *     the first restart waits RESTART_BACKOFF_MIN seconds and each one
+ *     after that twice as long as the last, up to RESTART_BACKOFF_MAX.
+ *     a process that ran for RESTART_BACKOFF_RESET seconds starts over
+ *     from the minimum. a process restarted RESTART_BURST times within
+ *     RESTART_WINDOW seconds is in a crash loop and is not restarted again.
+ * parameters:
+ *     table: the process table.
+ *     slot: the slot of the process that was just reaped.
+ * post-conditions:
+ *     the slot is PROC_RESTARTING and the restart timer is armed,
+ *     or the slot is left PROC_EXITED.
+ */
+void schedule_restart(struct proc_table *table, int slot);
+
+/*
+ * run_restarts
+ * description:
+ *     restarts every process whose restart is due, and kills every
+ *     process removed by a reload that outlived its grace period, then
+ *     arms the restart timer for the next one.
+ *     at most RESTART_RATE processes are restarted per second across
+ *     the whole table, restarts over that are pushed back, so many
+ *     crashing lines cannot turn into a fork storm.
+ * parameters:
+ *     table: the process table.
  */
-char *get_month(struct tm current_time);
+void run_restarts(struct proc_table *table);
 
 /*
- * get_day_of_week
+ * open_control
  * description:
- *     converts the day in current time to
- *     its string representaion.
+ *     creates the control socket at path, a unix stream socket served
+ *     by handle_control from the event loop. a socket left behind by
+ *     a previous macD is replaced. the socket is removed when macD exits.
  * parameters:
- *     current_time: tm structure containing the current time.
+ *     path: the path of the socket.
  * returns:
- *     string representation of the day.
+ *     0 on success.
+ *     -1 if the socket could not be created.
  */
-char *get_day_of_week(struct tm current_time);
+int open_control(char *path);
 
 /*
- * display_date
+ * close_control
  * description:
- *     displays the current time in the following format:
- *     [day_of_week], [month] [day], [year] [hour]:[min]:[sec] [AM/PM]
+ *     closes and removes the control socket, if there is one.
  */
-void display_date(void);
+void close_control(void);
 
 /*
- * read_file
+ * handle_control
  * description:
- *     reads all lines in the given file.
- *     creates a process for each line in the file where the line
- *     indicates what process to create.
+ *     accepts a client of the control socket, reads its request
+ *     and answers it. a request is one line:
+ *         status: the state of every process in the table, see control_status.
+ *         reload: reads the process list file again, see reload_process_list.
+ *         upgrade: runs macD again over the running processes, see upgrade_supervisor.
+ *     the client is closed after the answer. reads and writes time out
+ *     after CONTROL_TIMEOUT seconds so a stuck client cannot hold up
+ *     the event loop.
  * parameters:
- *     file_path: string of the path to the file to read.
- * pre-conditions:
- *     file_path is initialized.
+ *     table: the process table.
+ */
+void handle_control(struct proc_table *table);
+
+/*
+ * control_status
+ * description:
+ *     writes the state of every process in the table as of its last
+ *     sample, one line per slot, after a line counting them.
+ * parameters:
+ *     table: the process table.
+ *     reply: where the answer is written.
+ */
+void control_status(struct proc_table *table, FILE *reply);
+
+/*
+ * reload_process_list
+ * description:
+ *     reads the process list file again and applies what changed.
+ *     each slot whose line is still in the file, with the same text, is
+ *     kept as it is and takes the new line number of its line. slots
+ *     whose line is gone are stopped with SIGTERM, and SIGKILL after
+ *     GRACE_PERIOD, and not restarted. their old line, with its log, is
+ *     kept until they are reaped. lines that are new are started in new
+ *     slots. exited slots are
+ *     matched too, so a line that already exited is not started again.
+ *     new lines are started following the launch settings of the new
+ *     list, see run_launches. the time limit is not changed.
+ * parameters:
+ *     table: the process table.
+ *     reply: where the answer is written.
+ */
+void reload_process_list(struct proc_table *table, FILE *reply);
+
+/*
+ * stop_removed
+ * description:
+ *     stops the process of a slot whose line was removed by a reload:
+ *     SIGTERM now, and SIGKILL from run_restarts if it still runs after
+ *     GRACE_PERIOD, like shutdown_children.
+ * parameters:
+ *     table: the process table.
+ *     slot: the slot of the running process.
+ */
+void stop_removed(struct proc_table *table, int slot);
+
+/*
+ * release_removed
+ * description:
+ *     lets go of the lines removed by a reload whose process was reaped,
+ *     after draining what is left in their log, and frees each retired
+ *     process list once none of its lines is in use.
+ * parameters:
+ *     table: the process table.
+ */
+void release_removed(struct proc_table *table);
+
+/*
+ * move_launch
+ * description:
+ *     carries the launch state and the log of a line over to the same
+ *     line of a reloaded process list.
+ * parameters:
+ *     from: the line of the old list.
+ *     to: the line of the new list.
  */
-int *read_file(char *file_path);
+void move_launch(struct list_line *from, struct list_line *to);
 
 /*
- * get_num_digits
+ * hash_text
  * description:
- *     counts the number of digits in i.
+ *     hashes a string with FNV-1a.
  * parameters:
- *    i: integer to count the digits of.
+ *     text: the string to hash.
  * returns:
- *     the number of digits in i.
+ *     the hash of text.
  */
-int get_num_digits(int i);
+unsigned int hash_text(char *text);
 
 /*
- * convert_int_to_string
+ * parse_shard
  * description:
- *     converts the given integer to a string.
+ *     reads the shard given with -x as [index]/[count].
  * parameters:
- *     i: integer to convert to string.
- * pre-condition:
- *     i>=0
+ *     text: the shard.
  * returns:
- *     string representaion of i.
+ *     0 on success, SHARD_INDEX and SHARD_COUNT are set.
+ *     -1 if text is not a valid shard.
  */
-char *convert_int_to_string(int i);
+int parse_shard(char *text);
 
 /*
- * read_until_space
+ * shard_owns
  * description:
- *     reads through the given file until it reaches a space
- *     or the end of a file.
+ *     checks if this instance runs line. a line with a host directive
+ *     runs on the instance named like it, see -n. any other line runs
+ *     on the shard its text hashes to, so every instance reading the
+ *     same process list agrees on where each line runs.
  * parameters:
- *     fptr: FILE pointer to be read through.
- * pre-condition:
- *     fptr is initalized.
- * post-condition:
- *     the read from point in fptr is moved such that the next character read
- *     will be the character immediately after the space, or EOF if no space was found.
+ *     line: the line, with its directives read.
  * returns:
- *     1 if a space was found, meaning fptr not at EOF.
- *     0 if no space was found, meaning fptr is at EOF.
+ *     1 if this instance starts line, 0 otherwise.
  */
-int read_until_space(FILE *fptr);
+int shard_owns(struct list_line *line);
 
 /*
- * get_next_segment
+ * open_shard_socket
  * description:
- *     reads fptr until the next space character or EOF.
- *     returns all characters between read before finding a space.
+ *     opens a tcp socket to [host:]port, connected to it or, if
+ *     passive, listening on it without blocking. without a host a
+ *     passive socket listens on every address.
  * parameters:
- *     fptr: FILE pointer to be read through.
- * pre-condition:
- *     fptr is initalized.
- * post-condition:
- *     the read from point in fptr is moved such that the next character read
- *     will be the character immediately after the space, or EOF if no space was found.
+ *     address: the [host:]port.
+ *     passive: 1 to listen, 0 to connect.
  * returns:
- *     char array of all characters read before finding a space or EOF.
+ *     the socket.
+ *     -1 with a warning displayed if it could not be opened.
  */
-char *get_next_segment(FILE *fptr);
+int open_shard_socket(char *address, int passive);
 
 /*
- * get_cpu_usage
+ * connect_aggregator
  * description:
- *     computes the total amount of time the process has spent
- *     on the cpu, measured in clock ticks by
- *     reading /proc/[pid]/stat to find the user time and kernal time.
+ *     connects to the aggregator at address for -A. every report is
+ *     then written to it in the binary format instead of to stdout,
+ *     starting with a RECORD_HELLO record, and each normal report ends
+ *     with a RECORD_REPORT_END record.
+ *     SIGPIPE is blocked so macD keeps supervising its processes if
+ *     the aggregator goes away, see flush_report, and the socket is
+ *     non blocking so it does not wait on a slow one, see send_aggregator.
  * parameters:
- *     pid: the process id of the process to compute the cpu usage for.
+ *     address: the host:port of the aggregator.
  * returns:
- *     the number of ticks the process has been on the cpu for
- *     or -1 if no such process with pid exists.
+ *     0 on success.
+ *     -1 if the aggregator could not be reached.
  */
-int get_cpu_usage(int pid);
+int connect_aggregator(char *address);
 
 /*
- * get_mem_usage
+ * run_aggregator
  * description:
- *     computes the amount of memory used by the process
+ *     the --aggregate mode: accepts the instances started with -A and
+ *     merges their records into one fleet report per tick, see
+ *     display_fleet_report. every line of the process list has one
+ *     entry, found by its line number, which each instance reading the
+ *     same list agrees on, so merging a record is a copy into an array.
+ *     records are read AGGREGATE_BUFFER_SIZE bytes at a time and up to
+ *     AGGREGATE_EVENTS connections are handled per wake up.
+ *     stops once every instance disconnected, or on SIGINT.
  * parameters:
- *     pid: id of the process to compute memory usage of.
+ *     address: the [host:]port to listen on.
  * returns:
- *     the memory usage, in MB, of the given process
- *     or -1 if no such process exists.
+ *     the exit code of macD.
  */
-int get_mem_usage(int pid);
+int run_aggregator(char *address);
 
 /*
- * initialize_cpu_counters
+ * accept_peers
  * description:
- *     creates an array with a size equal to the amount of processes.
- *     this array will contain the cpu usage of each process from the
- *     previous reporting cycle.
+ *     accepts every instance waiting to connect to the aggregator.
  * parameters:
- *     pids: list of process ids
- *     num_processes: the length of pids, the number of processes.
- * pre-conditions:
- *     pids is initialized.
- *     num_processes is the length of pids.
+ *     listen_fd: the listening socket.
  * returns:
- *     list of integers containing the number of ticks each process
- *     has run on the cpu for. This list is in the same order as pids.
- *     so the processes at pids[i] will have run for counters[i] ticks.
+ *     the number of instances accepted.
  */
-int *initialize_cpu_counters(int *pids, int num_processes);
+int accept_peers(int listen_fd);
 
 /*
- * len_pids
+ * read_peer
  * description:
- *     counts the number of elements in the pids list.
- *     this is calculated by searching the list until -1 is found.
+ *     reads what an instance sent and merges every whole record.
+ *     a record cut by the read is kept in the peer until the rest
+ *     arrives. the instance is closed once it disconnects.
  * parameters:
- *     pids: list of pids to calculate length of.
- * pre-conditions:
- *     pids is initialized.
- *     pids is terminated by a -1 element.
+ *     fd: the connection of the instance.
+ */
+void read_peer(int fd);
+
+/*
+ * merge_record
+ * description:
+ *     applies a record of an instance to the fleet: a report end moves
+ *     the instance to that tick, a record about a process replaces the
+ *     entry of its line and an alert is displayed right away.
+ * parameters:
+ *     peer: the instance the record came from.
+ *     record: the record.
+ */
+void merge_record(struct shard_peer *peer, struct sample_record *record);
+
+/*
+ * fleet_tick
+ * description:
+ *     finds the last tick every connected instance has fully reported.
  * returns:
- *     the length of pids.
+ *     the tick, or -1 if an instance has not finished a report yet.
  */
-int len_pids(int *pids);
+int fleet_tick(void);
 
 /*
- * terminate_program
+ * display_fleet_report
  * description:
- *     terminates this process and all children processes.
- *     It then displays the final status for all children
- *     and the total runtime of the process.
+ *     displays the last state of every line of every instance, each
+ *     tagged with the shard that runs it, and the totals of the fleet.
  * parameters:
- *     pids: list of all children process ids
- *     elapsed_time: the time the program has been running for.
- * pre-conditions:
- *     pids is initalized.
- * post-conditions:
- *     all processes with pid in pids list will be killed.
- *     this program will terminate.
+ *     tick: the tick every instance has reported.
  */
-void terminate_program(int *pids, double elapsed_time);
+void display_fleet_report(int tick);
 
 /*
- * check_timer
+ * open_replay
  * description:
- *     checks if the program has run longer than the TARGET_TIME
- *     or if KILL_STATE == 1.
- *     if either of these condtions are true returns 1.
+ *     maps the sample history file written with -H and -M for --replay
+ *     and indexes the history of every slot that has samples, each the
+ *     trace of one recorded process. every duration macD waits for is
+ *     divided by REPLAY_SPEED, so the event loop runs the same reports,
+ *     alerts and restarts that many times faster than real time.
+ *     processes are never started and /proc is never read, the groups
+ *     of -g and the collector of -C do not apply.
  * parameters:
- *     current_time: the current time. Created by calling time(NULL)
+ *     path: the history file.
  * returns:
- *     1 if program has run for TARGET_TIME or KILL_STATE = 1.
+ *     0 on success.
+ *     -1 if the file is not a sample history with samples,
+ *     with an error displayed.
+ */
+int open_replay(char *path);
+
+/*
+ * create_replay_list
+ * description:
+ *     makes the process list of --replay without -i: one line per
+ *     virtual process, each named after the pid its trace was
+ *     recorded from.
+ * parameters:
+ *     count: the number of virtual processes, 0 for one per trace.
+ * returns:
+ *     the process list.
+ */
+struct process_list *create_replay_list(int count);
+
+/*
+ * get_virtual_time
+ * description:
+ *     the time of --replay, REPLAY_SPEED times faster than real time.
+ * returns:
+ *     the number of virtual seconds since open_replay.
+ */
+double get_virtual_time(void);
+
+/*
+ * start_replay
+ * description:
+ *     starts the trace of the virtual process in slot from its first
+ *     sample. the process of line number n replays trace n, cycling
+ *     through the traces when there are more lines than traces, so
+ *     a few recorded processes can stand for a much larger load.
+ * parameters:
+ *     table: the process table.
+ *     slot: the slot of a virtual process that just started.
+ */
+void start_replay(struct proc_table *table, int slot);
+
+/*
+ * replay_sample
+ * description:
+ *     samples a virtual process: its cpu and memory usage are those
+ *     of the last sample of its trace at or before the virtual time
+ *     it has run for. the time of the sample is virtual too, so alert
+ *     durations are in virtual seconds. once the trace is over the
+ *     process exits with code 0, reaped like a real process through a
+ *     SIGCHLD macD sends itself. only touches slot, like sample_process.
+ * parameters:
+ *     table: the process table.
+ *     slot: the slot of the virtual process.
+ */
+void replay_sample(struct proc_table *table, int slot);
+
+/*
+ * replay_signal
+ * description:
+ *     delivers a signal to a virtual process. a signal that would
+ *     terminate a process by default makes it exit, reaped like a real
+ *     process through a SIGCHLD macD sends itself, any other is ignored.
+ * parameters:
+ *     table: the process table.
+ *     slot: the slot of the virtual process.
+ *     sig: the signal.
+ */
+void replay_signal(struct proc_table *table, int slot, int sig);
+
+/*
+ * reap_replay
+ * description:
+ *     reaps the virtual processes that exited, like reap_children,
+ *     with the cpu time and peak memory of what their trace replayed.
+ * parameters:
+ *     table: the process table.
+ * returns:
+ *     the number of processes that were reaped.
+ */
+int reap_replay(struct proc_table *table);
+
+/*
+ * get_start_ticks
+ * description:
+ *     reads when a process started, field 22 of /proc/[pid]/stat, which
+ *     together with its pid identifies a process even after its pid is
+ *     reused. also reads its parent, field 4.
+ * parameters:
+ *     pid: the process.
+ *     parent: set to the pid of its parent, if not NULL.
+ * returns:
+ *     the clock ticks after boot the process started at.
+ *     0 if the process does not exist.
+ */
+uint64_t get_start_ticks(int pid, int *parent);
+
+/*
+ * write_checkpoint
+ * description:
+ *     writes every slot of the table to the file of --checkpoint: the
+ *     pid and start time of its process, the line it runs, with a
+ *     hash of the text of the line, its state, last sample, exit and
+ *     restarts.
+ *     the file is written next to the checkpoint and renamed over it,
+ *     so a crash of macD at any point leaves a whole checkpoint.
+ * parameters:
+ *     table: the process table.
+ */
+void write_checkpoint(struct proc_table *table);
+
+/*
+ * load_checkpoint
+ * description:
+ *     reads the file of --checkpoint for --resume. the processes it
+ *     lists are adopted as their lines are launched, see adopt_launch.
+ *     the time limit goes on from when the checkpointed macD started.
+ *     after an upgrade the log pipes it lists are still open.
+ *     a missing or invalid checkpoint is not an error, every line is
+ *     started as usual.
+ * parameters:
+ *     path: the checkpoint file.
+ */
+void load_checkpoint(char *path);
+
+/*
+ * adopt_launch
+ * description:
+ *     with --resume, adopts the checkpointed process of the line of
+ *     launch instead of starting it, if the line has the same text and
+ *     the process is still running: same pid and same start time, so a
+ *     reused pid is never adopted. a process that is a child of macD,
+ *     after an upgrade, is reaped as usual. any other only has its exit
+ *     noticed, through a pidfd, see reap_adopted. after an upgrade the
+ *     line captures the output of the process again with the log pipe
+ *     it was given before.
+ * parameters:
+ *     launch: the launch of a line about to start.
+ * returns:
+ *     1 if the process was adopted, its pid is in launch.
+ *     0 if the line has to be started.
+ */
+int adopt_launch(struct launch *launch);
+
+/*
+ * inherited_log_pipe
+ * description:
+ *     checks whether the log pipe of a checkpoint entry was kept open
+ *     by upgrade_supervisor across the exec of this process.
+ * parameters:
+ *     entry: the checkpoint entry.
+ * returns:
+ *     1 if both ends of the pipe are open in this process.
  *     0 otherwise.
  */
-int check_timer(double current_time);
+int inherited_log_pipe(struct checkpoint_entry *entry);
 
 /*
- * display_proc_state
+ * release_log_pipe
  * description:
- *     displays the cpu usage and mem usage of a process.
+ *     closes the log pipe of a checkpoint entry that is not adopted,
+ *     if it was kept open across an upgrade.
  * parameters:
- *     index: the index of the process in the pids array.
- *     cpu: the percentage of time this process has spent on the cpu.
- *     mem: the amount of memory, in MB, used by the process.
+ *     entry: the checkpoint entry.
  */
-void display_proc_state(int index, int cpu, int mem);
+void release_log_pipe(struct checkpoint_entry *entry);
 
 /*
- * periodic_reports
+ * resume_slot
+ * description:
+ *     gives the slot of an adopted process the restarts and last
+ *     sample it had, and displays that it was adopted.
+ * parameters:
+ *     table: the process table.
+ *     slot: the slot of the adopted process.
+ *     entry: its checkpoint entry.
+ */
+void resume_slot(struct proc_table *table, int slot, struct checkpoint_entry *entry);
+
+/*
+ * reap_adopted
+ * description:
+ *     reaps the adopted processes that are not children of macD and
+ *     exited, found by polling their pidfds. their exit status is not
+ *     known, their cpu time and peak memory are those of their last
+ *     sample.
+ * parameters:
+ *     table: the process table.
+ * returns:
+ *     the number of processes that were reaped.
+ */
+int reap_adopted(struct proc_table *table);
+
+/*
+ * upgrade_supervisor
+ * description:
+ *     writes a checkpoint and executes the macD file again with the
+ *     same arguments and --resume. macD keeps its pid so its children
+ *     stay its children and are adopted by the new image, which is how
+ *     a new build of macD is put in place without restarting anything.
+ *     the log pipes are kept open across the exec, their numbers are in
+ *     the checkpoint, so the new image goes on capturing the output.
+ * parameters:
+ *     table: the process table.
+ *     reply: where the answer is written if the upgrade failed.
+ */
+void upgrade_supervisor(struct proc_table *table, FILE *reply);
+
+/*
+ * set_log_cloexec
+ * description:
+ *     sets the close on exec flag of both ends of every log pipe open
+ *     in a process list.
+ * parameters:
+ *     list: the process list.
+ *     flag: FD_CLOEXEC to close them on exec, 0 to keep them open.
+ */
+void set_log_cloexec(struct process_list *list, int flag);
+
+/*
+ * restart_process
+ * description:
+ *     starts the line of slot again in the same slot, in the same
+ *     cgroup with -g cgroup. if it fails to start the failure counts
+ *     as an exit and is scheduled to restart again.
+ * parameters:
+ *     table: the process table.
+ *     slot: the slot to restart.
+ */
+void restart_process(struct proc_table *table, int slot);
+
+/*
+ * display_exit_info
+ * description:
+ *     displays how a process exited, its total cpu time
+ *     and its peak memory usage. processes stopped by shutdown_children
+ *     are shown as Terminated, or Killed if they outlived the grace period.
+ *     processes waiting to be restarted show when they restart.
+ * parameters:
+ *     table: the process table.
+ *     slot: the slot of the process in the process table.
+ */
+void display_exit_info(struct proc_table *table, int slot);
+
+/*
+ * display_history
+ * description:
+ *     displays the min, average, max and 95th percentile of the cpu
+ *     and memory usage of every process over the samples kept with -H.
+ * parameters:
+ *     table: the process table.
+ */
+void display_history(struct proc_table *table);
+
+/*
+ * summarize_samples
+ * description:
+ *     computes the min, average, max and 95th percentile of values.
+ *     values is sorted in place.
+ * parameters:
+ *     values: the values.
+ *     len: the number of values, at least 1.
+ *     stats: where the results are stored.
+ */
+void summarize_samples(int *values, int len, struct history_stats *stats);
+
+/*
+ * compare_ints
+ * description:
+ *     orders ints in ascending order for qsort.
+ * parameters:
+ *     a, b: pointers to the ints to compare.
+ * returns:
+ *     a negative number, 0 or a positive number if a is smaller than,
+ *     equal to, or larger than b.
+ */
+int compare_ints(const void *a, const void *b);
+
+/*
+ * create_timer
  * description:
- *     displays the status of all processes every 5 seconds.
+ *     creates a timerfd that becomes readable after the given
+ *     number of seconds, and then every interval seconds after that.
  * parameters:
- *     pids: list of process ids
+ *     clock: the clock the timer is measured against.
+ *     flags: 0 for a relative timer or TFD_TIMER_ABSTIME.
+ *     seconds: when the timer first expires.
+ *     interval: the period of the timer, 0 for a one shot timer.
+ * returns:
+ *     the file descriptor of the timer.
+ */
+int create_timer(int clock, int flags, double seconds, double interval);
+
+/*
+ * set_timer
+ * description:
+ *     arms a timerfd created by create_timer.
+ * parameters:
+ *     fd: the file descriptor of the timer.
+ *     flags: 0 for a relative timer or TFD_TIMER_ABSTIME.
+ *     seconds: when the timer next expires.
+ *     interval: the period of the timer, 0 for a one shot timer.
+ */
+void set_timer(int fd, int flags, double seconds, double interval);
+
+/*
+ * schedule_report
+ * description:
+ *     arms the report timer for the next report. reports are due on
+ *     a fixed grid of absolute CLOCK_MONOTONIC times REPORT_INTERVAL
+ *     apart, so the time a report takes does not push back the next one.
+ *     if macD fell behind by more than an interval the missed reports
+ *     are skipped instead of being run back to back.
  * pre-conditions:
- *     pids is initialized.
- *     pids is terminated by a -1 element.
+ *     init_event_loop has been called.
  */
-void periodic_reports(int *pids);
+void schedule_report(void);
 
 /*
- * sig_handler
+ * watch_fd
  * description:
- *     called when SIGINT is passed to the process
- *     sets KILL_STATE to 1 which tells the process to terminate
- *     itself and its children.
+ *     adds fd to the event loop so wait_for_event wakes up
+ *     when it becomes readable.
  * parameters:
- *     sig: the id of the signal passed to the process
+ *     fd: the file descriptor to watch.
+ *     event: the EVENT_* value wait_for_event returns for fd.
+ * pre-conditions:
+ *     init_event_loop has been called.
+ */
+void watch_fd(int fd, int event);
+
+/*
+ * init_event_loop
+ * description:
+ *     creates the epoll instance and registers the signal fd,
+ *     the report timer, the restart timer, disarmed until a restart
+ *     is scheduled, and, if a time limit is set, the deadline timer.
+ *     the first report after the normal report at startup is due
+ *     REPORT_INTERVAL seconds from now.
+ * pre-conditions:
+ *     register_handler has been called.
+ *     START_TIME and TARGET_TIME are set.
  */
-void sig_handler(int sig);
+void init_event_loop(void);
+
+/*
+ * wait_for_event
+ * description:
+ *     sleeps until one of the fds registered with the event loop
+ *     becomes readable and consumes what made it readable.
+ *     a SIGINT sets KILL_STATE to 1.
+ * pre-conditions:
+ *     init_event_loop has been called.
+ * returns:
+ *     EVENT_REPORT if the report timer expired.
+ *     EVENT_DEADLINE if the time limit was reached.
+ *     EVENT_CHILD if a child changed state, or an adopted process exited.
+ *     EVENT_SIGNAL if SIGINT was received.
+ *     EVENT_GRACE if the grace period of shutdown_children is over.
+ *     EVENT_RESTART if a restart is due.
+ *     EVENT_CONTROL if a client connected to the control socket.
+ *     EVENT_LAUNCH if run_launches has work.
+ *     EVENT_READY if a process wrote to its ready=fd pipe.
+ *     EVENT_PROC if the kernel sent process events with -C netlink.
+ *     EVENT_LOG if a process wrote to its log, which is drained here.
+ *     EVENT_NONE if the wait was interrupted.
+ */
+int wait_for_event(void);
+
+/*
+ * read_signal
+ * description:
+ *     reads the next pending signal from the signal fd.
+ * pre-conditions:
+ *     register_handler has been called.
+ * returns:
+ *     the number of the signal received or 0 if none was pending.
+ */
+int read_signal(void);
 
 /*
  * register_handler
  * description:
- *     registers this program to react to the SIGINT signal
+ *     blocks SIGINT and SIGCHLD and creates the signal fd they
+ *     are read from, so the event loop can react to them.
  */
 void register_handler(void);
+
+/*
+ * reset_child_signals
+ * description:
+ *     unblocks the signals blocked by register_handler.
+ *     called in a new child before exec so the child
+ *     does not inherit the blocked signal mask.
+ */
+void reset_child_signals(void);